@@ -30,6 +30,9 @@ public:
         RestartApp,
         GetLogBuffer,
         Web,
+        AppStatus,
+        SetForeground,
+        AppResources,
     };
     
     static DevkitAction getActionFromStr(const char *str);
@@ -39,6 +39,9 @@ public:
     void removeNFSExport(JsonWriter &writer, const std::string &address);
     void reboot(JsonWriter &writer);
     void restartApp(JsonWriter &writer, const std::string &appName);
+    void appStatus(JsonWriter &writer, const std::string &appName);
+    void setForeground(JsonWriter &writer, const std::string &appName);
+    void appResources(JsonWriter &writer, const std::string &appName);
     
     void connectionEnded(struct MHD_Connection *connection, void **con_cls, enum MHD_RequestTerminationCode code);
     
@@ -25,6 +25,12 @@ Devkit::DevkitAction Devkit::getActionFromStr(const char *str)
         return GetLogBuffer;
     else if(strcmp(str, "Web") == 0)
         return Web;
+    else if(strcmp(str, "AppStatus") == 0)
+        return AppStatus;
+    else if(strcmp(str, "SetForeground") == 0)
+        return SetForeground;
+    else if(strcmp(str, "AppResources") == 0)
+        return AppResources;
     return Unknown;
 }
     
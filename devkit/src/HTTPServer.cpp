@@ -17,6 +17,8 @@
 
 #include <sstream>
 #include <algorithm>
+#include <future>
+#include <chrono>
 
 namespace xpr = boost::xpressive;
 
@@ -102,6 +104,12 @@ std::string HTTPServer::parseRequest(const std::string &req, std::string *conten
             "/devkit/" >> (+_w)[xpr::ref(token) = _, xpr::ref(action) = Devkit::RestartApp] >> "/restartApp/" >> (+_w)[xpr::ref(params)[0] = _]
         |  
             "/devkit/" >> (+_w)[xpr::ref(token) = _, xpr::ref(action) = Devkit::GetLogBuffer] >> "/log/"
+        |
+            "/devkit/" >> (+_w)[xpr::ref(token) = _, xpr::ref(action) = Devkit::AppStatus] >> "/appStatus/" >> (+_w)[xpr::ref(params)[0] = _]
+        |
+            "/devkit/" >> (+_w)[xpr::ref(token) = _, xpr::ref(action) = Devkit::SetForeground] >> "/foreground/" >> (+_w)[xpr::ref(params)[0] = _]
+        |
+            "/devkit/" >> (+_w)[xpr::ref(token) = _, xpr::ref(action) = Devkit::AppResources] >> "/appResources/" >> (+_w)[xpr::ref(params)[0] = _]
         |  
             "/web/"    >> (+_w)[xpr::ref(token) = _, xpr::ref(action) = Devkit::Web] >> "/" >> *(*(+_w) | *(set='.',':','/','-'))
         ;
@@ -144,6 +152,15 @@ std::string HTTPServer::parseRequest(const std::string &req, std::string *conten
             case Devkit::RestartApp:
                 restartApp(writer, params[0]);
                 break;
+            case Devkit::AppStatus:
+                appStatus(writer, params[0]);
+                break;
+            case Devkit::SetForeground:
+                setForeground(writer, params[0]);
+                break;
+            case Devkit::AppResources:
+                appResources(writer, params[0]);
+                break;
             case Devkit::Web:
                 // The right parameter is everything after the / of the token.
                 params[0] = req.substr(req.find_first_of("/", req.find_first_of("/", 6)) + 1); 
@@ -287,11 +304,72 @@ void HTTPServer::restartApp(JsonWriter &writer, const std::string &app)
         (*m_devkit->m_appManager)[app];
         
     if(appPtr) {
-        if(appPtr->isRunning()) {
-            appPtr->stop();
-        }
-        appPtr->reload();
-        appPtr->start();
+        // Apps are managed on the io_service of the daemon. The restart happens
+        // after the app exited, this request does not wait for it.
+        m_devkit->m_ioService->post([appPtr]() {
+            appPtr->stop([appPtr]() {
+                appPtr->reload();
+                appPtr->start();
+            });
+        });
+        
+        writer.Key("status");
+        writer.Bool(true);
+    } 
+    else {
+        writer.Key("status");
+        writer.Bool(false);
+        writer.Key("error");
+        writer.String(("The app \"" + app + "\" was not found in the app manager.").c_str());
+    }
+}
+void HTTPServer::appStatus(JsonWriter &writer, const std::string &app)
+{
+    std::shared_ptr<::piga::daemon::sdk::App> appPtr = 
+        (*m_devkit->m_appManager)[app];
+        
+    if(!appPtr) {
+        writer.Key("status");
+        writer.Bool(false);
+        writer.Key("error");
+        writer.String(("The app \"" + app + "\" was not found in the app manager.").c_str());
+        return;
+    }
+
+    // The status is collected on the io_service of the daemon, this connection has its own thread.
+    auto promise = std::make_shared<std::promise<::piga::daemon::sdk::App::Status>>();
+    std::future<::piga::daemon::sdk::App::Status> future = promise->get_future();
+    m_devkit->m_ioService->post([appPtr, promise]() {
+        promise->set_value(appPtr->getStatus());
+    });
+    if(future.wait_for(std::chrono::seconds(2)) != std::future_status::ready) {
+        writer.Key("status");
+        writer.Bool(false);
+        writer.Key("error");
+        writer.String("The daemon did not answer in time.");
+        return;
+    }
+
+    writer.Key("status");
+    writer.Bool(true);
+    writer.Key("app");
+    writer.StartObject();
+    for(const auto &entry : future.get()) {
+        writer.Key(entry.first.c_str());
+        writer.String(entry.second.c_str());
+    }
+    writer.EndObject();
+}
+void HTTPServer::setForeground(JsonWriter &writer, const std::string &app)
+{
+    std::shared_ptr<::piga::daemon::sdk::App> appPtr = 
+        (*m_devkit->m_appManager)[app];
+        
+    if(appPtr) {
+        std::shared_ptr<::piga::daemon::sdk::AppManager> appManager = m_devkit->m_appManager;
+        m_devkit->m_ioService->post([appManager, app]() {
+            appManager->setForegroundApp(app);
+        });
         
         writer.Key("status");
         writer.Bool(true);
@@ -303,6 +381,61 @@ void HTTPServer::restartApp(JsonWriter &writer, const std::string &app)
         writer.String(("The app \"" + app + "\" was not found in the app manager.").c_str());
     }
 }
+void HTTPServer::appResources(JsonWriter &writer, const std::string &app)
+{
+    typedef std::vector<::piga::daemon::sdk::App::ResourceSample> History;
+
+    std::shared_ptr<::piga::daemon::sdk::App> appPtr = 
+        (*m_devkit->m_appManager)[app];
+        
+    if(!appPtr) {
+        writer.Key("status");
+        writer.Bool(false);
+        writer.Key("error");
+        writer.String(("The app \"" + app + "\" was not found in the app manager.").c_str());
+        return;
+    }
+
+    // The history is copied on the io_service of the daemon, this connection has its own thread.
+    auto promise = std::make_shared<std::promise<History>>();
+    std::future<History> future = promise->get_future();
+    m_devkit->m_ioService->post([appPtr, promise]() {
+        promise->set_value(appPtr->getResourceHistory());
+    });
+    if(future.wait_for(std::chrono::seconds(2)) != std::future_status::ready) {
+        writer.Key("status");
+        writer.Bool(false);
+        writer.Key("error");
+        writer.String("The daemon did not answer in time.");
+        return;
+    }
+
+    writer.Key("status");
+    writer.Bool(true);
+    writer.Key("samples");
+    writer.StartArray();
+    for(const auto &sample : future.get()) {
+        writer.StartObject();
+        writer.Key("time");
+        writer.Uint64(sample.time);
+        writer.Key("cpu");
+        writer.Double(sample.cpu);
+        writer.Key("memory");
+        writer.Uint64(sample.memory);
+        writer.Key("read_rate");
+        writer.Double(sample.readRate);
+        writer.Key("write_rate");
+        writer.Double(sample.writeRate);
+        writer.Key("voluntary_switches");
+        writer.Double(sample.voluntarySwitches);
+        writer.Key("involuntary_switches");
+        writer.Double(sample.involuntarySwitches);
+        writer.Key("run_delay");
+        writer.Double(sample.runDelay);
+        writer.EndObject();
+    }
+    writer.EndArray();
+}
 
 #if MHD_VERSION < 0x00095102
 int // These defines are needed because of version discrepancies in MHD between debian and arch.
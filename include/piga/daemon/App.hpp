@@ -4,9 +4,31 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <boost/asio/steady_timer.hpp>
 
 #include <piga/daemon/sdk/App.hpp>
 #include <piga/daemon/LogManager.hpp>
+#include <piga/daemon/ChildReaper.hpp>
+#include <piga/daemon/LaunchPlan.hpp>
+#include <piga/daemon/Zygote.hpp>
+#include <piga/daemon/CgroupManager.hpp>
+#include <piga/daemon/ResourceSampler.hpp>
+#include <piga/daemon/Prefetcher.hpp>
+#include <piga/daemon/LaunchTracer.hpp>
+#include <piga/daemon/AppCatalog.hpp>
+
+namespace boost
+{
+namespace archive
+{
+class binary_iarchive;
+class binary_oarchive;
+}
+}
 
 namespace piga
 {
@@ -15,7 +37,12 @@ namespace daemon
 class App : public sdk::App
 {
 public:
-    App(const std::string &defaultAppPath = "/usr/lib/piga/apps/", uid_t defaultUID = 1010, char **envp = nullptr);
+    /**
+     * @param reaper Reports the exit of the started process. Without it, update() polls with waitpid.
+     * @param zygote Used to start apps which have a zygote_library.
+     * @param cgroups If active, the app is started in its own cgroup with the limits of its config.
+     */
+    App(const std::string &defaultAppPath = "/usr/lib/piga/apps/", uid_t defaultUID = 1010, char **envp = nullptr, std::shared_ptr<ChildReaper> reaper = nullptr, std::shared_ptr<Zygote> zygote = nullptr, std::shared_ptr<CgroupManager> cgroups = nullptr);
     ~App();
 
     virtual void loadFromName(const std::string &name) override;
@@ -26,7 +53,7 @@ public:
     virtual void executeAutostart() override;
 
     virtual void start(bool restartIfRunning = false) override;
-    virtual void stop() override;
+    virtual void stop(StopHandler handler = StopHandler()) override;
 
     virtual bool isRunning() const override;
     virtual bool isInstalled() const override;
@@ -41,7 +68,186 @@ public:
     virtual const std::string& getWorkingDir() const override;
     virtual const std::string& getExecutable() const override;
     virtual bool isAutostart() const override;
+    virtual Status getStatus() const override;
+    virtual std::vector<ResourceSample> getResourceHistory() const override;
+
+    /**
+     * @brief Apps which have to be ready before this app is started, if they are started as well.
+     */
+    const std::vector<std::string>& getAfter() const;
+    /**
+     * @brief Like getAfter(), but the apps are started in any case and this app is not
+     * started if one of them could not be started.
+     */
+    const std::vector<std::string>& getRequires() const;
+    /**
+     * @brief True if the app is running and finished its startup.
+     *
+     * Apps with notify report this with "READY=1" on the notify socket, apps with
+     * wait_for_signal are ready after the daemon received SIGUSR1. All other apps
+     * are ready as soon as they were started.
+     */
+    bool isReady() const;
+    void setReady();
+    /**
+     * @brief Handles a message of the main process of the app on the notify socket.
+     */
+    void handleNotification(const std::string &message);
+
+    /**
+     * @brief Files to read into the page cache before the app is started.
+     *
+     * Empty if the config has no prefetch list and there is no usable trace. Otherwise,
+     * the executable and the zygote library are included as well.
+     */
+    std::vector<Prefetcher::Range> getPrefetchRanges() const;
+    /**
+     * @brief Absolute path of the prefetch trace, empty if there is none or it was recorded for another version.
+     */
+    std::string getPrefetchTrace() const;
+    /**
+     * @brief Records a prefetch trace on the next start if the current one is missing or outdated.
+     *
+     * Traces without a version, like hand written ones, are never replaced.
+     *
+     * @param tracer nullptr disables the recording.
+     */
+    void setLaunchTracer(std::shared_ptr<LaunchTracer> tracer, std::chrono::milliseconds duration);
+
+    /**
+     * @brief Configs are restored from the catalog if it is up to date and stored in it otherwise.
+     */
+    void setCatalog(std::shared_ptr<AppCatalog> catalog);
+    /**
+     * @brief Writes everything loadConfigFile() reads, used by the AppCatalog.
+     */
+    void saveConfig(boost::archive::binary_oarchive &archive) const;
+    void loadConfig(boost::archive::binary_iarchive &archive);
+
+    /**
+     * @brief Adds a sample to the resource history, if the app is running.
+     */
+    void sampleResources();
+    void setResourceHistoryLength(std::size_t length);
+
+    /**
+     * @brief Time App::start() needed until the process existed.
+     */
+    struct LaunchStatistics {
+        uint64_t launches = 0;
+        std::chrono::nanoseconds time = std::chrono::nanoseconds(0);
+        std::chrono::nanoseconds maxTime = std::chrono::nanoseconds(0);
+    };
+    const LaunchStatistics& getLaunchStatistics(bool zygote) const;
+
+    /**
+     * @brief Called after the app was started or could not be started and after it exited on its own.
+     */
+    typedef std::function<void(App &app)> StateHandler;
+    void setStateHandler(StateHandler handler);
+
+    bool isFreezable() const;
+    bool takesForeground() const;
+    bool isFrozen() const;
+    bool isStopping() const;
+    /**
+     * @brief True while the zygote starts the app, it is not running yet.
+     */
+    bool isStarting() const;
+    bool isInBackground() const;
+    /**
+     * @brief Thaws the app and restores its configured priority.
+     */
+    void moveToForeground();
+    /**
+     * @brief Freezes the app if it is freezable, otherwise its priority is lowered.
+     *
+     * @param nice Nice value of all threads of the app.
+     * @param cpuWeight cpu.weight of the cgroup of the app, if it has one.
+     */
+    void moveToBackground(int nice, int cpuWeight);
+    /**
+     * @brief Memory used by the app in bytes, 0 if it is not running.
+     *
+     * Uses the cgroup of the app if it has one, which also covers its children and
+     * page cache. Otherwise, the resident set of the app process is used.
+     */
+    uint64_t getMemoryUsage() const;
+    /**
+     * @brief Apps with a lower memory priority give up their memory first under pressure.
+     */
+    int getMemoryPriority() const;
+    /**
+     * @brief Freezes or thaws the app regardless of being freezable.
+     */
+    void setFrozen(bool frozen);
+    /**
+     * @brief True if the app exited too often within the restart window.
+     *
+     * It is not restarted automatically anymore until it is started explicitly.
+     */
+    bool isRestartTripped() const;
+
+    /**
+     * @brief Limits the automatic restarts of an app which keeps exiting.
+     */
+    struct RestartPolicy {
+        /// Delay of the first restart in milliseconds, doubled (by the multiplier) on every consecutive one.
+        int initialDelay = 500;
+        int maxDelay = 30000;
+        double multiplier = 2.0;
+        /// Every delay is randomly varied by up to this fraction.
+        double jitter = 0.2;
+        /// Restarts within the window after which no more restarts are done, 0 for no limit.
+        int maxRestarts = 5;
+        int window = 60000;
+        /// An app which ran this long in milliseconds starts over with the initial delay.
+        int stableTime = 10000;
+
+        /**
+         * @brief The delay of a restart in milliseconds.
+         *
+         * @param attempts Restarts since the app last ran for the stable time.
+         * @param random Picks the jitter, from 0 (shortest) to 1 (longest delay).
+         */
+        double getDelay(int attempts, double random) const;
+    };
 private:
+
+    void handleWaitStatus(int status);
+    /**
+     * @brief Schedules a restart if the config asks for one after this kind of exit.
+     */
+    void handleExit(bool crashed);
+    void scheduleRestart();
+    void cancelRestart();
+    /**
+     * @brief Serializes the fields of the config, AppCatalog::FormatVersion has to be increased when they change.
+     */
+    template<class Archive>
+    void serializeConfig(Archive &archive);
+    /**
+     * @brief Identifies the installed version of the app by its executable and zygote library.
+     */
+    std::string getVersionStamp() const;
+    /**
+     * @brief Prepares argv, envp and everything else needed to start the app.
+     */
+    void buildLaunchPlan();
+    /**
+     * @brief Completes start() once the process exists, or reports that it could not be started.
+     */
+    void finishStart(pid_t pid, bool zygote, int error, bool recording, std::chrono::steady_clock::time_point launchBegin);
+    /**
+     * @brief Kills the app and waits for it. Only used if the app cannot be stopped asynchronously.
+     */
+    void killNow();
+    void finishStop();
+    /**
+     * @brief Sets the nice value of every thread of the app, setpriority() only changes one thread.
+     */
+    void setNice(int nice);
+
     std::string m_appPath;
     std::string m_name = "Undefined App Name";
     std::string m_path;
@@ -59,11 +265,69 @@ private:
     bool m_waitForSignal = false;
     bool m_restartOnCrash = false;
     bool m_restartOnExit = false;
+    bool m_freezable = false;
+    bool m_takesForeground = true;
+    int m_memoryPriority = 0;
+    ResourceSampler m_resources;
+    std::vector<std::string> m_after;
+    std::vector<std::string> m_requires;
+    std::vector<std::string> m_prefetch;
+    /// Relative to the app directory, recorded traces are written here as well.
+    std::string m_prefetchTrace = "prefetch.trace";
+    std::shared_ptr<LaunchTracer> m_launchTracer;
+    std::shared_ptr<AppCatalog> m_catalog;
+    std::chrono::milliseconds m_launchTraceDuration = std::chrono::milliseconds(10000);
+    bool m_notify = false;
+    bool m_ready = false;
+    /// Milliseconds until an app which did not report its readiness is treated as ready, 0 waits forever.
+    int m_readyTimeout = 30000;
+    std::unique_ptr<boost::asio::steady_timer> m_readyTimer;
+    /// The last STATUS= message of the app.
+    std::string m_notifyStatus;
+    bool m_frozen = false;
+    bool m_background = false;
+    StateHandler m_stateHandler;
 
     pid_t m_pid = 0;
     uid_t m_uid = 1010;
     char **m_envp;
     int m_waitpid_counter = 0;
+    std::shared_ptr<ChildReaper> m_reaper;
+    LaunchPlan m_launchPlan;
+    std::shared_ptr<Zygote> m_zygote;
+    bool m_starting = false;
+    /// stop() was called while the zygote started the app.
+    bool m_stopAfterStart = false;
+    std::string m_zygoteLibrary;
+    std::string m_zygoteEntry = PIGA_DAEMON_ZYGOTE_DEFAULT_ENTRY;
+    LaunchStatistics m_directLaunchStatistics;
+    LaunchStatistics m_zygoteLaunchStatistics;
+    std::shared_ptr<CgroupManager> m_cgroups;
+    CgroupManager::Limits m_limits;
+    std::string m_cgroupProcs;
+    LaunchPlan::Scheduling m_scheduling;
+    /// errno of the scheduling settings which could not be applied at the last start.
+    int m_schedulingError = 0;
+
+    /// Grace period in milliseconds between SIGTERM and SIGKILL.
+    int m_stopTimeout = 3000;
+    bool m_stopping = false;
+    std::vector<StopHandler> m_stopHandlers;
+    std::unique_ptr<boost::asio::steady_timer> m_stopTimer;
+
+    RestartPolicy m_restartPolicy;
+    std::chrono::steady_clock::time_point m_startTime;
+    /// Restarts since the app last ran for the stable time.
+    int m_restartAttempts = 0;
+    /// Times of the restarts within the window.
+    std::deque<std::chrono::steady_clock::time_point> m_restartTimes;
+    bool m_restartPending = false;
+    bool m_restartTripped = false;
+    /// Set while a scheduled restart starts the app, so it does not reset the policy.
+    bool m_automaticRestart = false;
+    std::chrono::steady_clock::time_point m_restartDue;
+    std::unique_ptr<boost::asio::steady_timer> m_restartTimer;
+    std::minstd_rand m_random;
     
     SeverityChannelLogger m_log;
     SeverityChannelLogger m_appLog;
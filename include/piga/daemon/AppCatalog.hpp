@@ -0,0 +1,91 @@
+#ifndef PIGA_DAEMON_APPCATALOG_HPP_INCLUDED
+#define PIGA_DAEMON_APPCATALOG_HPP_INCLUDED
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <sys/types.h>
+
+#include <piga/daemon/LogManager.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+class App;
+
+/**
+ * @brief The AppCatalog class caches the parsed app configs in a binary file.
+ *
+ * Every entry is keyed by the app directory and remembers the device, inode, size
+ * and modification time of its app_config.cfg. As long as they match, the app is
+ * restored from the cache with boost serialization instead of parsing the config.
+ * The cache file is mapped once by load() and rewritten by save() if it changed.
+ *
+ * restore() and store() may be called concurrently while loading the apps.
+ */
+class AppCatalog
+{
+public:
+    /**
+     * @brief Increased whenever the serialized fields of App change, older caches are dropped.
+     */
+    static const uint32_t FormatVersion = 2;
+
+    AppCatalog(const std::string &cacheFile);
+    ~AppCatalog();
+
+    /**
+     * @param defaultUID The cache is only valid for the default values it was parsed with.
+     * @return False if there is no usable cache, all apps are parsed then.
+     */
+    bool load(uid_t defaultUID);
+    /**
+     * @brief Writes the entries which were restored or stored since load(), if anything changed.
+     */
+    bool save();
+
+    /**
+     * @brief Restores the config of the app in the directory, if the cached one is up to date.
+     */
+    bool restore(App &app, const std::string &path);
+    void store(const App &app, const std::string &path);
+
+    const std::string& getCacheFile() const;
+private:
+    struct Entry {
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        /// The serialized App.
+        std::string data;
+
+        template<class Archive>
+        void serialize(Archive &archive, const unsigned int)
+        {
+            archive & device & inode & size & mtime & data;
+        }
+    };
+
+    /**
+     * @brief Reads the key of the app_config.cfg in the directory into the entry.
+     */
+    static bool stat(const std::string &path, Entry &entry);
+
+    std::string m_cacheFile;
+    uid_t m_defaultUID = 0;
+    std::map<std::string, Entry> m_entries;
+    // Entries which are still installed, only these are saved.
+    std::set<std::string> m_used;
+    bool m_dirty = false;
+    std::mutex m_mutex;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
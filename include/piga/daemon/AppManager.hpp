@@ -4,6 +4,10 @@
 #include <unordered_map>
 #include <memory>
 #include <string>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <cstdint>
 #include <piga/daemon/App.hpp>
 
 #include <piga/daemon/sdk/AppManager.hpp>
@@ -12,25 +16,203 @@ namespace piga
 {
 namespace daemon
 {
+class WorkerPool;
+
 class AppManager : public sdk::AppManager
 {
 public:
-    AppManager(const std::string &directory = "/usr/lib/piga/apps/", uid_t defaultUID = 1010, char **envp = nullptr);
+    AppManager(const std::string &directory = "/usr/lib/piga/apps/", uid_t defaultUID = 1010, char **envp = nullptr, std::shared_ptr<ChildReaper> reaper = nullptr, std::shared_ptr<CgroupManager> cgroups = nullptr);
     ~AppManager();
 
     void reload(const std::string &directory = "/usr/lib/piga/apps/");
+    /**
+     * @brief Loads the apps in the directory without starting them, like reload() does.
+     *
+     * @param pool If given, the app configs are parsed concurrently on the pool.
+     */
+    void loadApps(const std::string &directory, WorkerPool *pool = nullptr);
+
+    /**
+     * @brief Starts the zygote, which is used by all apps loaded afterwards.
+     *
+     * Needs the reaper, which collects the apps started by the zygote.
+     */
+    void startZygote(const std::vector<std::string> &preload);
+
+    /**
+     * @brief Logs how long direct and zygote launches of all apps took.
+     */
+    void logLaunchStatistics();
+
+    /**
+     * @brief Configures how apps outside of the foreground are treated.
+     *
+     * If active, the most recently started app which takes the foreground becomes the
+     * foreground app. All other running apps are frozen if they are freezable, or run
+     * with a lower priority otherwise. When the foreground app exits, the previous one
+     * takes its place again.
+     */
+    void setForegroundScheduling(bool active, int backgroundNice, int backgroundCpuWeight);
+    virtual void setForegroundApp(const std::string &name) override;
+    const std::string& getForegroundApp() const;
+
+    /**
+     * @brief Limits the warm cache, which keeps frozen apps for instant switching.
+     *
+     * Freezable apps in the background stay in memory until they are evicted. The least
+     * recently used ones are stopped as soon as more than maxApps are cached or their
+     * memory usage exceeds memoryBudget bytes. Needs the foreground scheduling.
+     *
+     * @param maxApps 0 does not limit the number of cached apps.
+     * @param memoryBudget 0 does not limit the memory of cached apps.
+     */
+    void setWarmCache(std::size_t maxApps, uint64_t memoryBudget);
+    /**
+     * @brief Used to read the files of apps into the page cache before they are started.
+     */
+    void setPrefetcher(std::shared_ptr<Prefetcher> prefetcher);
+    /**
+     * @brief Queues the prefetch list of the app, if it is not running.
+     *
+     * Clients hint at apps they are about to start (hovered or selected in a menu) with
+     * this or with "PREFETCH=<name>" on the notify socket.
+     */
+    virtual void prefetchApp(const std::string &name) override;
+    /**
+     * @brief Shows the app, either by resuming it from the warm cache or by (re)starting it.
+     */
+    void switchToApp(const std::string &name);
+    /**
+     * @brief Stops the least recently used cached apps until at most maxApps remain.
+     *
+     * @return The number of evicted apps.
+     */
+    std::size_t trimWarmCache(std::size_t maxApps);
+
+    /**
+     * @brief Frees memory for the foreground app, one step per call.
+     *
+     * The steps escalate while the pressure lasts: the warm cache is trimmed first,
+     * then background apps are frozen and finally stopped. Background apps are chosen
+     * by their memory priority, the lowest one first. The foreground app is never touched.
+     *
+     * @return False if there was nothing left to do.
+     */
+    bool relieveMemoryPressure();
+    /**
+     * @brief Thaws the apps which were only frozen because of memory pressure.
+     */
+    void memoryPressureEased();
+
+    /**
+     * @brief Samples the resource usage of all running apps.
+     */
+    void sampleResources();
+    /**
+     * @brief Number of samples kept per app.
+     */
+    void setResourceHistoryLength(std::size_t length);
+    /**
+     * @brief Caches the parsed app configs, so only changed ones are parsed by loadApps().
+     */
+    void setCatalog(std::shared_ptr<AppCatalog> catalog);
+    /**
+     * @brief Records the launches of apps without an up to date prefetch trace.
+     *
+     * @param tracer nullptr disables the recording.
+     * @param duration How long after the start the opened files are recorded.
+     */
+    void setLaunchTracer(std::shared_ptr<LaunchTracer> tracer, std::chrono::milliseconds duration);
+
     void update();
+    /**
+     * @brief Starts all autostart apps and the apps they require.
+     *
+     * The apps are started as a graph: an app is started once all apps it is ordered
+     * after or requires are ready, independent apps are started concurrently. At most
+     * the concurrency limit of apps may be started but not ready at a time.
+     */
     void processApps();
+    /**
+     * @param limit 0 does not limit the number of concurrently starting apps.
+     */
+    void setAutostartConcurrency(std::size_t limit);
+    /**
+     * @brief Forwards a message on the notify socket to the app with the pid.
+     */
+    void handleNotification(pid_t pid, const std::string &message);
+    /**
+     * @brief Marks all running apps with wait_for_signal as ready, done on SIGUSR1.
+     */
+    void readySignalReceived();
     
     virtual AppPtr operator[](const std::string &name) override;
     virtual AppPtr getApp(const std::string &name) override;
 private:
+    void appStateChanged(App &app);
+    /**
+     * @brief Moves the foreground app to the foreground and all other running apps to the background.
+     */
+    void applyForeground();
+    /**
+     * @brief Frozen background apps, the least recently used one first.
+     */
+    std::vector<std::shared_ptr<App>> getWarmApps();
+    void enforceWarmCache();
+    /**
+     * @brief Running apps outside of the foreground, the lowest memory priority first.
+     */
+    std::vector<std::shared_ptr<App>> getBackgroundAppsByMemoryPriority();
+
+    enum DependencyState {
+        DependenciesReady,
+        DependenciesPending,
+        DependenciesFailed,
+    };
+    DependencyState getDependencyState(const App &app) const;
+    /**
+     * @brief Starts all pending apps whose dependencies are ready, as far as the limit allows.
+     */
+    void launchReadyApps();
+    void bootStateChanged(App &app);
+
     AppMap m_apps;
-    AppMap::iterator m_currentPos;
-    bool m_continueAfterWait = false;
     std::string m_directory;
     uid_t m_defaultUID;
     char **m_envp;
+    std::shared_ptr<ChildReaper> m_reaper;
+    std::shared_ptr<Zygote> m_zygote;
+    std::shared_ptr<CgroupManager> m_cgroups;
+    std::shared_ptr<Prefetcher> m_prefetcher;
+
+    bool m_foregroundScheduling = false;
+    int m_backgroundNice = 10;
+    int m_backgroundCpuWeight = 10;
+    std::string m_foreground;
+    // Apps which were in the foreground, the most recent one last.
+    std::vector<std::string> m_foregroundHistory;
+
+    std::size_t m_warmCacheSize = 0;
+    uint64_t m_warmCacheMemory = 0;
+
+    // Apps which were frozen to relieve memory pressure.
+    std::vector<std::string> m_pressureFrozen;
+
+    std::size_t m_resourceHistoryLength = 120;
+    std::shared_ptr<LaunchTracer> m_launchTracer;
+    std::shared_ptr<AppCatalog> m_catalog;
+    std::chrono::milliseconds m_launchTraceDuration = std::chrono::milliseconds(10000);
+
+    // Apps of the current processApps() run, sorted by name for a stable start order.
+    std::set<std::string> m_bootPending;
+    std::set<std::string> m_bootStarting;
+    std::set<std::string> m_bootFailed;
+    std::size_t m_autostartConcurrency = 0;
+    bool m_booting = false;
+    bool m_launching = false;
+    std::chrono::steady_clock::time_point m_bootBegin;
+
+    SeverityChannelLogger m_log;
 };
 }
 }
@@ -0,0 +1,90 @@
+#ifndef PIGA_DAEMON_CGROUPMANAGER_HPP_INCLUDED
+#define PIGA_DAEMON_CGROUPMANAGER_HPP_INCLUDED
+
+#include <string>
+#include <cstdint>
+#include <sys/types.h>
+
+#include <piga/daemon/LogManager.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The CgroupManager class isolates the daemon and its apps with cgroup v2.
+ *
+ * The daemon needs a delegated cgroup (Delegate=yes in the service file). Inside of it,
+ * the daemon moves itself into the "daemon" leaf and every app gets its own cgroup
+ * below "apps". Both subtrees can be restricted to a cpuset, so the input path of the
+ * daemon keeps its cores, and the limits of every app are set from its config.
+ */
+class CgroupManager
+{
+public:
+    /**
+     * @brief Resource limits of an app, empty values are not limited.
+     *
+     * The values are written as they are, see the cgroup v2 documentation of
+     * cpu.max, cpuset.cpus, memory.high, memory.max and io.weight.
+     */
+    struct Limits {
+        std::string cpuMax;
+        std::string cpuset;
+        std::string memoryHigh;
+        std::string memoryMax;
+        int ioWeight = 0;
+    };
+
+    CgroupManager();
+    ~CgroupManager();
+
+    /**
+     * @brief Sets up the daemon and apps subtrees in the cgroup of the daemon.
+     *
+     * @param daemonCpuset Cores reserved for the daemon, empty to not restrict it.
+     * @param appsCpuset Cores available to all apps, empty to not restrict them.
+     * @return False if cgroup v2 is not available or the cgroup is not delegated.
+     */
+    bool init(const std::string &daemonCpuset, const std::string &appsCpuset);
+    bool isActive() const;
+
+    /**
+     * @brief Creates the cgroup of the app if needed and applies its limits.
+     *
+     * @return The path of its cgroup.procs file or an empty string on failure.
+     */
+    std::string prepareApp(const std::string &name, const Limits &limits);
+
+    /**
+     * @brief Moves an already running process into a cgroup.
+     */
+    bool attach(const std::string &procsPath, pid_t pid);
+
+    /**
+     * @brief Freezes or thaws all processes in the cgroup of the cgroup.procs file.
+     */
+    bool setFrozen(const std::string &procsPath, bool frozen);
+    /**
+     * @brief Sets cpu.weight (1 to 10000, default 100) of the cgroup of the cgroup.procs file.
+     */
+    bool setCpuWeight(const std::string &procsPath, int weight);
+    /**
+     * @brief Reads memory.current of the cgroup of the cgroup.procs file.
+     *
+     * @return The memory usage in bytes or -1.
+     */
+    int64_t getMemoryUsage(const std::string &procsPath);
+private:
+    bool writeFile(const std::string &path, const std::string &value);
+    static std::string getGroupPath(const std::string &procsPath);
+
+    std::string m_root;
+    bool m_active = false;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef PIGA_DAEMON_CHILDREAPER_HPP_INCLUDED
+#define PIGA_DAEMON_CHILDREAPER_HPP_INCLUDED
+
+#include <map>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <sys/types.h>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include <piga/daemon/LogManager.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The ChildReaper class reports the exit of child processes on the io_service.
+ *
+ * Every watched child gets a pidfd, which becomes readable as soon as the child exits.
+ * On kernels without pidfd_open (before 5.3), SIGCHLD is handled instead and all
+ * watched children are checked when it arrives. The child is reaped before its
+ * handler is called.
+ */
+class ChildReaper
+{
+public:
+    /**
+     * @brief Called with the wait status of the exited child, or with UnknownStatus.
+     */
+    typedef std::function<void(int status)> Handler;
+    /**
+     * @brief The child is gone, but its wait status could not be read.
+     *
+     * Matches none of WIFEXITED, WIFSIGNALED, WIFSTOPPED and WIFCONTINUED.
+     */
+    static const int UnknownStatus = -1;
+
+    ChildReaper(std::shared_ptr<boost::asio::io_service> io_service);
+    ~ChildReaper();
+
+    void watch(pid_t pid, Handler handler);
+    /**
+     * @brief Stops watching the child. Its handler is not called anymore and it is not reaped.
+     */
+    void unwatch(pid_t pid);
+
+    bool usesPidfd() const;
+
+    /**
+     * @brief Reaps all children on SIGCHLD, also the ones which are not watched.
+     *
+     * Needed when the daemon is a child subreaper, orphans are reparented to it then.
+     * Watched children which are reaped this way are reported to their handler. The
+     * status of a child which is not watched yet is kept for a while, so a zygote app
+     * which exits before its pid is known is still reported once it is watched.
+     */
+    void setReapOrphans(bool reapOrphans);
+    std::shared_ptr<boost::asio::io_service> getIOService();
+private:
+    struct Child {
+        Handler handler;
+        std::unique_ptr<boost::asio::posix::stream_descriptor> pidfd;
+    };
+
+    struct Unclaimed {
+        int status;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    /// Statuses of unknown children are dropped after this time, they were real orphans.
+    static const int UnclaimedTimeout = 60000;
+
+    void asyncWaitPidfd(pid_t pid);
+    void asyncWaitSignal();
+    /**
+     * @brief Reaps the child if it exited and calls its handler. Returns true if it was reaped.
+     */
+    bool reap(pid_t pid);
+    void dispatch(pid_t pid, int status);
+
+    std::shared_ptr<boost::asio::io_service> m_io_service;
+    std::map<pid_t, Child> m_children;
+    std::map<pid_t, Unclaimed> m_unclaimed;
+    bool m_pidfdSupported = true;
+    bool m_reapOrphans = false;
+    std::unique_ptr<boost::asio::signal_set> m_signals;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
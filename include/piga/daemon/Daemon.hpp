@@ -3,9 +3,9 @@
 
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/signal_set.hpp>
-#include <boost/asio/deadline_timer.hpp>
 #include <memory>
 #include <string>
+#include <vector>
 #include <piga/host.h>
 #include <piga/client.h>
 
@@ -14,6 +14,16 @@
 #include <piga/daemon/Loader.hpp>
 #include <piga/daemon/AppManager.hpp>
 #include <piga/daemon/LogManager.hpp>
+#include <piga/daemon/Doorbell.hpp>
+#include <piga/daemon/NotifySocket.hpp>
+#include <piga/daemon/ChildReaper.hpp>
+#include <piga/daemon/CgroupManager.hpp>
+#include <piga/daemon/MemoryPressureMonitor.hpp>
+#include <piga/daemon/Prefetcher.hpp>
+#include <piga/daemon/LaunchTracer.hpp>
+#include <piga/daemon/Scheduler.hpp>
+#include <piga/daemon/InputThread.hpp>
+#include <piga/daemon/InputAccumulator.hpp>
 
 #define PIGA_DAEMON_PIDFILE_PATH "/etc/piga/proc/daemon.pid"
 
@@ -41,6 +51,15 @@ public:
 
     void signalHandler(const boost::system::error_code &code, int signal_number);
     void update();
+    void doorbellRung();
+    /**
+     * @brief Registers or removes the resource sampling of the apps according to the config.
+     */
+    void updateResourceSampling();
+    /**
+     * @brief Enables or disables the recording of prefetch traces according to the config.
+     */
+    void updateLaunchTracing();
 
     static const char* getPidfilePath() {
         return getenv("PIGA_DAEMON_PIDFILE_PATH");
@@ -48,14 +67,24 @@ public:
 
 private:
     std::unique_ptr<Loader> m_loader;
+    std::shared_ptr<ChildReaper> m_childReaper;
+    std::shared_ptr<CgroupManager> m_cgroupManager;
+    std::shared_ptr<Prefetcher> m_prefetcher;
+    std::shared_ptr<LaunchTracer> m_launchTracer;
     std::shared_ptr<AppManager> m_appManager;
+    std::unique_ptr<MemoryPressureMonitor> m_memoryPressureMonitor;
     std::shared_ptr<::piga::devkit::Devkit> m_devkit;
     std::shared_ptr<DBusManager> m_dbusManager;
     std::shared_ptr<PluginManager> m_pluginManager;
 
     std::shared_ptr<boost::asio::io_service> m_io_service;
     std::shared_ptr<boost::asio::io_service::work> m_work;
-    std::shared_ptr<boost::asio::deadline_timer> m_hostTimer;
+    std::shared_ptr<Scheduler> m_scheduler;
+    Scheduler::Handle m_resourceSamplingHandle = 0;
+    std::shared_ptr<InputThread> m_inputThread;
+    std::shared_ptr<InputAccumulator> m_inputAccumulator;
+    std::shared_ptr<Doorbell> m_doorbell;
+    std::shared_ptr<NotifySocket> m_notifySocket;
     boost::asio::signal_set m_signals;
 
     std::string m_configFilePath = "/etc/piga/daemon.cfg";
@@ -63,8 +92,50 @@ private:
     std::string m_name = "Unnamed Piga Host";
     uid_t m_defaultUID = 1010;
     std::string m_defaultAppPath = "/usr/lib/piga/apps/";
+    // Binary cache of the parsed app configs, empty disables it.
+    std::string m_appCatalogFile = "/var/cache/piga/app_catalog.bin";
     bool m_devkitActive = false;
     uint32_t m_devkitHttpPort = 8080;
+    // The input thread owns the hosts, these are only applied when the daemon starts.
+    bool m_inputThreadActive = false;
+    int m_inputThreadCpu = -1;
+    int m_inputThreadPriority = 0;
+    bool m_watchSoPath = true;
+    // Worker threads for the startup stages, 0 uses one per core.
+    int m_startupThreads = 0;
+    // Reads hosts and the prefetch lists of apps into the page cache before they are loaded.
+    bool m_prefetchActive = true;
+    // Records prefetch traces of apps which have none, in milliseconds after their start.
+    bool m_prefetchRecord = false;
+    int m_prefetchRecordTime = 10000;
+    bool m_zygoteActive = false;
+    std::vector<std::string> m_zygotePreload;
+    bool m_foregroundScheduling = false;
+    int m_backgroundNice = 10;
+    int m_backgroundCpuWeight = 10;
+    // Apps which may be started but not ready at the same time, 0 does not limit them.
+    int m_autostartConcurrency = 0;
+    int m_warmCacheSize = 3;
+    // In MiB.
+    int m_warmCacheMemory = 256;
+    // In milliseconds, 0 disables the sampling.
+    int m_resourceSamplingInterval = 1000;
+    int m_resourceHistoryLength = 120;
+    bool m_memoryPressureActive = false;
+    // A trigger fires if some tasks were stalled on memory for the stall time within the window.
+    int m_memoryPressureStall = 150;
+    int m_memoryPressureWindow = 2000;
+    // Protects the daemon from the OOM killer.
+    int m_oomScoreAdj = -900;
+    bool m_cgroupsActive = false;
+    // CPU lists in the format of cpuset.cpus, empty values do not restrict.
+    std::string m_daemonCpuset;
+    std::string m_appsCpuset;
+    InputAccumulator::Policy m_inputCoalescing = InputAccumulator::KeepDigitalEdges;
+
+    // The doorbell wakes the loop right away, but clients which do not ring it are only
+    // seen by polling the client queue in shared memory, which is done at the old tick.
+    uint32_t m_pollInterval = 20;
 
     std::shared_ptr<piga_host> m_host;
     std::shared_ptr<piga_client> m_client;
@@ -0,0 +1,55 @@
+#ifndef PIGA_DAEMON_DOORBELL_HPP_INCLUDED
+#define PIGA_DAEMON_DOORBELL_HPP_INCLUDED
+
+#include <functional>
+#include <memory>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#define PIGA_DAEMON_DOORBELL_ENVVAR "PIGA_DAEMON_DOORBELL_FD"
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The Doorbell class wakes up the main loop of the daemon when something happened.
+ *
+ * It wraps an eventfd which is registered as a descriptor on the io_service. Every
+ * producer of work (host inputs, clients which pushed an event into the shared memory
+ * queue, ...) rings the doorbell and the daemon runs its update exactly once for all
+ * rings which happened in the meantime.
+ *
+ * Ringing is lock free and async-signal-safe, so it can be done from any thread. The
+ * file descriptor is also published to started apps using the PIGA_DAEMON_DOORBELL_FD
+ * environment variable, so clients can notify the daemon after pushing events.
+ */
+class Doorbell
+{
+public:
+    typedef std::function<void()> Handler;
+
+    Doorbell(std::shared_ptr<boost::asio::io_service> io_service);
+    ~Doorbell();
+
+    /**
+     * @brief Wakes up the waiting handler. Multiple rings before the handler ran are merged.
+     */
+    void ring();
+
+    /**
+     * @brief Calls the handler once after the next ring. Has to be re-armed after each call.
+     */
+    void asyncWait(Handler handler);
+
+    int getFd() const;
+    bool isValid() const;
+private:
+    int m_fd = -1;
+    std::shared_ptr<boost::asio::io_service> m_io_service;
+    std::unique_ptr<boost::asio::posix::stream_descriptor> m_descriptor;
+};
+}
+}
+
+#endif
@@ -3,13 +3,17 @@
 
 #include <string>
 #include <vector>
-#include <map>
 #include <memory>
+#include <cstdint>
+#include <chrono>
 #include <boost/asio/io_service.hpp>
-#include <boost/asio/deadline_timer.hpp>
+
+#include <piga/daemon/Scheduler.hpp>
+#include <piga/daemon/InputAccumulator.hpp>
 
 #include <piga/host.h>
 #include <piga/event.h>
+#include <piga/daemon/host_extension_types.h>
 
 namespace piga
 {
@@ -25,7 +29,7 @@ namespace daemon
 class Host
 {
 public:
-    Host(const std::string &path, std::shared_ptr<boost::asio::io_service> io_service, std::shared_ptr<piga_host> globalHost);
+    Host(const std::string &path, std::shared_ptr<boost::asio::io_service> io_service, std::shared_ptr<Scheduler> scheduler);
     ~Host();
     typedef void (*InputCallbackFunctionType)(int, int, int);
 
@@ -38,10 +42,24 @@ public:
         _COUNT
     };
 
+    /**
+     * @brief Initializes the library. Hosts can be initialized concurrently.
+     */
     void init(int playerCount);
+    /**
+     * @brief Registers the update of an initialized host with the scheduler.
+     *
+     * Has to be called from the thread of the scheduler after every init().
+     */
+    void start();
     bool test();
     void destroy();
 
+    /**
+     * @brief True if the library could be opened and exports all required symbols.
+     */
+    bool isValid() const;
+
     int getPigaMajorVersion();
     int getPigaMinorVersion();
     int getPigaMiniVersion();
@@ -74,15 +92,79 @@ public:
     float useUpdateFunction();
     void update();
 
+    /**
+     * @brief Polls all controls of a fixed function host and submits the changed ones.
+     */
+    void pollFixedFunction();
+    /**
+     * @brief Pulls all pending inputs of an input methods host with one call and submits them.
+     */
+    void pullInputMethods();
+    /**
+     * @brief Reads all pending timestamped inputs of a host implementing pollInputs().
+     */
+    void pollBulkInputs();
+
+    /**
+     * @brief Cost of reading inputs from the host, to compare the pipelines on the same hardware.
+     *
+     * For fixed function hosts this is the poll and diff, for input methods hosts the pull and
+     * for callback hosts the update function, which triggers the callbacks.
+     */
+    struct PipelineStatistics {
+        uint64_t calls = 0;
+        uint64_t inputs = 0;
+        std::chrono::nanoseconds time = std::chrono::nanoseconds(0);
+        std::chrono::nanoseconds maxTime = std::chrono::nanoseconds(0);
+    };
+    const PipelineStatistics& getPipelineStatistics() const;
+    void logPipelineStatistics();
+    Type getType() const;
+    static const char* getTypeName(Type type);
+
     static void globalInputCallback(int player, int input, int value);
+
+    /**
+     * @brief Sets the accumulator which batches the inputs of all hosts and submits them.
+     */
+    static void setInputAccumulator(std::shared_ptr<InputAccumulator> accumulator);
+    /**
+     * @brief Number of control ids polled per player from fixed function hosts.
+     *
+     * The fixed function ABI (getButtonState(player, control)) cannot report how many
+     * controls a host has, and libpiga does not export a control count. Control ids
+     * are single bytes like in the game input events. The table reserves ids 0 to 15,
+     * which covers the ids the fixed function hosts use. Higher ids are dropped.
+     * The size has to stay a multiple of 4, because the table is compared in groups of 4.
+     */
+    static const int FixedFunctionControls = 16;
+    /// Poll interval in milliseconds for polled hosts without an update function.
+    static const int DefaultPollInterval = 10;
+    /// Number of inputs which can be pulled from an input methods host with one call.
+    static const int PullBufferCapacity = 256;
 private:
+    void tick();
+
+    PipelineStatistics m_pipelineStatistics;
+    std::vector<piga_host_input> m_pullBuffer;
+    std::vector<piga_host_timed_input> m_pollBuffer;
+    // Set for hosts which are read through pollInputs(), regardless of their pipeline.
+    bool m_bulkInputs = false;
+    // The host which is currently ticking, callbacks during the tick are counted for it.
+    static Host *m_currentHost;
+
     std::string m_path;
-    std::vector<std::map<char, int> > m_controls;
+    int m_playerCount = 0;
+    // Player major tables of all control values, the previous poll is kept for the diff.
+    std::vector<int32_t> m_controls;
+    std::vector<int32_t> m_previousControls;
     std::shared_ptr<boost::asio::io_service> m_io_service;
-    std::shared_ptr<boost::asio::deadline_timer> m_timer;
+    std::shared_ptr<Scheduler> m_scheduler;
+    Scheduler::Handle m_updateHandle = 0;
+    // Update interval in milliseconds as determined by init(), 0 if the host is not updated.
+    float m_updateInterval = 0;
 
-    static std::shared_ptr<piga_host> m_globalHost;
-    thread_local static std::shared_ptr<piga_event> m_cacheEvent;
+    static std::shared_ptr<InputAccumulator> m_inputAccumulator;
 
     // Mapped functions
     typedef int (*GetPigaMajorVersion)();
@@ -95,6 +177,9 @@ private:
     typedef int (*GetButtonState)(int, int);
     typedef const char*(*GetString)(void);
     typedef void (*SetInputCallback)(InputCallbackFunctionType);
+    typedef int (*PullInputs)(piga_host_input*, int);
+    typedef int (*GetHostExtensionVersion)();
+    typedef int (*PollInputs)(piga_host_timed_input*, int);
 
     typedef int (*ImplementsOutputs)();
     typedef int (*GetOutputCount)();
@@ -115,40 +200,65 @@ private:
     typedef int (*SetFloatOutput)(int, float);
     typedef int (*SetDoubleOutput)(int, double);
 
-    void *m_getPigaMajorVersion = nullptr;
-    void *m_getPigaMinorVersion = nullptr;
-    void *m_getPigaMiniVersion = nullptr;
-    void *m_init = nullptr;
-    void *m_useUpdateFunction = nullptr;
-    void *m_update = nullptr;
-    void *m_destroy = nullptr;
-    void *m_getButtonState = nullptr;
-    void *m_setInputCallback = nullptr;
-
-    void *m_getName = nullptr;
-    void *m_getDescription = nullptr;
-    void *m_getAuthor = nullptr;
-
-    void *m_implementsOutputs = nullptr;
-    void *m_getOutputCount = nullptr;
-    void *m_getOutputType = nullptr;
-    void *m_getOutputPos = nullptr;
-    void *m_getOutputName = nullptr;
-    void *m_getOutputDescription = nullptr;
-    void *m_getIntOutputRangeMin = nullptr;
-    void *m_getIntOutputRangeMax = nullptr;
-    void *m_getFloatOutputRangeMin = nullptr;
-    void *m_getFloatOutputRangeMax = nullptr;
-    void *m_getDoubleOutputRangeMin = nullptr;
-    void *m_getDoubleOutputRangeMax = nullptr;
-    void *m_setColorOutput = nullptr;
-    void *m_setBoolOutput = nullptr;
-    void *m_setStringOutput = nullptr;
-    void *m_setIntOutput = nullptr;
-    void *m_setFloatOutput = nullptr;
-    void *m_setDoubleOutput = nullptr;
+    /**
+     * Every symbol of the host interface, described once as
+     * X(function pointer type, member of Symbols, exported name, required).
+     *
+     * All of them are resolved right after loading the library. A host which misses
+     * a required symbol is rejected, optional symbols are nullptr if they are missing.
+     */
+#define PIGA_DAEMON_HOST_SYMBOLS(X) \
+    X(GetPigaMajorVersion, getPigaMajorVersion, "getPigaMajorVersion", true) \
+    X(GetPigaMinorVersion, getPigaMinorVersion, "getPigaMinorVersion", true) \
+    X(GetPigaMiniVersion, getPigaMiniVersion, "getPigaMiniVersion", true) \
+    X(Init, init, "init", true) \
+    X(UseUpdateFunction, useUpdateFunction, "useUpdateFunction", false) \
+    X(Update, update, "update", false) \
+    X(Destroy, destroy, "destroy", false) \
+    X(GetButtonState, getButtonState, "getButtonState", false) \
+    X(SetInputCallback, setInputCallback, "setCallbackFunc", false) \
+    X(PullInputs, pullInputs, "pullInputs", false) \
+    X(GetHostExtensionVersion, getHostExtensionVersion, "getHostExtensionVersion", false) \
+    X(PollInputs, pollInputs, "pollInputs", false) \
+    X(GetString, getName, "getName", false) \
+    X(GetString, getDescription, "getDescription", false) \
+    X(GetString, getAuthor, "getAuthor", false) \
+    X(ImplementsOutputs, implementsOutputs, "implementsOutputs", false) \
+    X(GetOutputCount, getOutputCount, "getOutputCount", false) \
+    X(GetOutputType, getOutputType, "getOutputType", false) \
+    X(GetOutputPos, getOutputPos, "getOutputPos", false) \
+    X(GetOutputName, getOutputName, "getOutputName", false) \
+    X(GetOutputDescription, getOutputDescription, "getOutputDescription", false) \
+    X(GetIntOutputRangeMin, getIntOutputRangeMin, "getIntOutputRangeMin", false) \
+    X(GetIntOutputRangeMax, getIntOutputRangeMax, "getIntOutputRangeMax", false) \
+    X(GetFloatOutputRangeMin, getFloatOutputRangeMin, "getFloatOutputRangeMin", false) \
+    X(GetFloatOutputRangeMax, getFloatOutputRangeMax, "getFloatOutputRangeMax", false) \
+    X(GetDoubleOutputRangeMin, getDoubleOutputRangeMin, "getDoubleOutputRangeMin", false) \
+    X(GetDoubleOutputRangeMax, getDoubleOutputRangeMax, "getDoubleOutputRangeMax", false) \
+    X(SetColorOutput, setColorOutput, "setColorOutput", false) \
+    X(SetBoolOutput, setBoolOutput, "setBoolOutput", false) \
+    X(SetStringOutput, setStringOutput, "setStringOutput", false) \
+    X(SetIntOutput, setIntOutput, "setIntOutput", false) \
+    X(SetFloatOutput, setFloatOutput, "setFloatOutput", false) \
+    X(SetDoubleOutput, setDoubleOutput, "setDoubleOutput", false)
+
+    struct Symbols {
+#define PIGA_DAEMON_HOST_SYMBOL_MEMBER(type, member, name, required) type member = nullptr;
+        PIGA_DAEMON_HOST_SYMBOLS(PIGA_DAEMON_HOST_SYMBOL_MEMBER)
+#undef PIGA_DAEMON_HOST_SYMBOL_MEMBER
+    };
+
+    /**
+     * @brief Resolves all symbols of the opened library.
+     *
+     * @return False if a required symbol is missing.
+     */
+    bool resolveSymbols();
+
+    Symbols m_symbols;
 
     void *m_dlHandle = nullptr;
+    bool m_initialized = false;
 
     Type m_type = Undefined;
 };
@@ -0,0 +1,111 @@
+#ifndef PIGA_DAEMON_INPUTACCUMULATOR_HPP_INCLUDED
+#define PIGA_DAEMON_INPUTACCUMULATOR_HPP_INCLUDED
+
+#include <mutex>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <boost/asio/io_service.hpp>
+
+#include <piga/host.h>
+#include <piga/event.h>
+
+#include <piga/daemon/InputEvent.hpp>
+#include <piga/daemon/LogManager.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+class Doorbell;
+
+/**
+ * @brief The InputAccumulator class collects the inputs of all hosts and submits them in batches.
+ *
+ * The first input of a tick posts a flush to the io_service of the hosts, so everything
+ * reported by host updates and callbacks until that handler runs is submitted together
+ * and the doorbell is only rung once per batch. Until the flush, repeated writes to the
+ * same (player, input) pair are coalesced according to the policy.
+ *
+ * record() may be called from any thread, host libraries report callbacks from their own.
+ */
+class InputAccumulator
+{
+public:
+    enum Policy {
+        /// Every write is submitted.
+        KeepAll,
+        /// Changes between zero and non-zero are kept, all other changes are coalesced.
+        KeepDigitalEdges,
+        /// Only the latest value of each input is submitted.
+        LatestOnly,
+    };
+
+    /**
+     * @return False if the name is unknown, the policy is not changed then.
+     */
+    static bool getPolicyFromStr(const std::string &str, Policy &policy);
+    static const char* getStrFromPolicy(Policy policy);
+
+    struct Statistics {
+        uint64_t recorded = 0;
+        uint64_t submitted = 0;
+        uint64_t flushes = 0;
+        /// Submitted inputs with a source timestamp and their latency until submission.
+        uint64_t timedInputs = 0;
+        uint64_t latencySum = 0;
+        uint64_t maxLatency = 0;
+    };
+
+    /**
+     * @param globalHost Receives the flushed inputs. May be nullptr, like in the tests.
+     */
+    InputAccumulator(std::shared_ptr<boost::asio::io_service> io_service, std::shared_ptr<piga_host> globalHost, int playerCount, Policy policy = KeepDigitalEdges);
+    ~InputAccumulator();
+
+    void setPolicy(Policy policy);
+    void setDoorbell(std::shared_ptr<Doorbell> doorbell);
+    /**
+     * @brief Called on the flushing thread with every batch after it was submitted.
+     */
+    typedef std::function<void(const std::vector<InputEvent> &batch)> BatchHandler;
+    void setBatchHandler(BatchHandler handler);
+
+    void record(int player, int input, int value, uint64_t timestamp = 0);
+    void flush();
+
+    Statistics getStatistics() const;
+    void logStatistics();
+private:
+    static const int InputsPerPlayer = 256;
+
+    int getKey(int player, int input) const;
+
+    std::shared_ptr<boost::asio::io_service> m_io_service;
+    std::shared_ptr<piga_host> m_globalHost;
+    std::shared_ptr<piga_event> m_cacheEvent;
+    std::shared_ptr<Doorbell> m_doorbell;
+    BatchHandler m_batchHandler;
+
+    int m_playerCount;
+    Policy m_policy;
+
+    // Guards the pending events and the statistics.
+    mutable std::mutex m_mutex;
+    // Index of the pending event of every (player, input) pair in m_events or -1.
+    std::vector<int32_t> m_pending;
+    std::vector<InputEvent> m_events;
+    // The events of the running flush, swapped with m_events to keep both allocations.
+    std::vector<InputEvent> m_flushing;
+    bool m_flushPosted = false;
+
+    Statistics m_statistics;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef PIGA_DAEMON_INPUTEVENT_HPP_INCLUDED
+#define PIGA_DAEMON_INPUTEVENT_HPP_INCLUDED
+
+#include <cstdint>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief A single input as it was reported by a host.
+ */
+struct InputEvent {
+    int player = 0;
+    int input = 0;
+    int value = 0;
+    /// CLOCK_MONOTONIC time in nanoseconds at which the host read the input, 0 if unknown.
+    uint64_t timestamp = 0;
+};
+}
+}
+
+#endif
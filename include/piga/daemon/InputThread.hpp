@@ -0,0 +1,60 @@
+#ifndef PIGA_DAEMON_INPUTTHREAD_HPP_INCLUDED
+#define PIGA_DAEMON_INPUTTHREAD_HPP_INCLUDED
+
+#include <memory>
+#include <thread>
+#include <functional>
+#include <boost/asio/io_service.hpp>
+
+#include <piga/daemon/Scheduler.hpp>
+#include <piga/daemon/LogManager.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The InputThread class runs the input path of the daemon on its own thread.
+ *
+ * Hosts which are loaded into this thread are polled by its own scheduler and their
+ * input callbacks run here, so the control plane on the main io_service (config reloads,
+ * app starts, the devkit, ...) cannot delay controller input. The thread can be pinned
+ * to a CPU core and can run with the SCHED_FIFO real time policy.
+ */
+class InputThread
+{
+public:
+    /**
+     * @param cpu The core the thread is pinned to. -1 disables pinning.
+     * @param realtimePriority The SCHED_FIFO priority (1-99). 0 keeps the normal scheduling.
+     */
+    InputThread(int cpu = -1, int realtimePriority = 0);
+    ~InputThread();
+
+    void start();
+    void stop();
+
+    /**
+     * @brief Runs the function on the input thread.
+     */
+    void post(std::function<void()> function);
+
+    std::shared_ptr<boost::asio::io_service> getIOService();
+    std::shared_ptr<Scheduler> getScheduler();
+private:
+    void run();
+
+    int m_cpu = -1;
+    int m_realtimePriority = 0;
+
+    std::shared_ptr<boost::asio::io_service> m_io_service;
+    std::shared_ptr<boost::asio::io_service::work> m_work;
+    std::shared_ptr<Scheduler> m_scheduler;
+    std::thread m_thread;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
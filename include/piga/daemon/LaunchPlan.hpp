@@ -0,0 +1,160 @@
+#ifndef PIGA_DAEMON_LAUNCHPLAN_HPP_INCLUDED
+#define PIGA_DAEMON_LAUNCHPLAN_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <sched.h>
+#include <sys/types.h>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The LaunchPlan class holds everything needed to start an app process.
+ *
+ * It is built once when the app config is loaded: all arguments and environment
+ * variables are stored in one arena, the executable is resolved against PATH and the
+ * working directory is made absolute. Starting the process then only needs syscalls.
+ *
+ * The process is started with clone(CLONE_VM | CLONE_VFORK), so the page tables of
+ * the daemon are not copied. The child only runs async-signal-safe code until execve.
+ */
+class LaunchPlan
+{
+public:
+    /**
+     * @brief Scheduling settings of the process, only the enabled ones are applied.
+     */
+    struct Scheduling {
+        bool setPolicy = false;
+        /// SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO or SCHED_RR.
+        int policy = SCHED_OTHER;
+        /// Only used by SCHED_FIFO and SCHED_RR.
+        int priority = 0;
+        bool setNice = false;
+        int nice = 0;
+        bool setIoprio = false;
+        /// 1 (realtime), 2 (best-effort) or 3 (idle).
+        int ioprioClass = 2;
+        /// 0 (highest) to 7 (lowest).
+        int ioprioLevel = 4;
+        bool setOomScoreAdj = false;
+        int oomScoreAdj = 0;
+        bool setAffinity = false;
+        cpu_set_t affinity = cpu_set_t();
+    };
+
+    /**
+     * @brief Applies the scheduling settings to a process.
+     *
+     * Async-signal-safe, so it can be used in the child before execve. Every setting
+     * is tried, even if an earlier one failed.
+     *
+     * @param pid The process to change, 0 for the calling process.
+     * @return 0 or the errno of the first setting which could not be applied.
+     */
+    static int applyScheduling(pid_t pid, const Scheduling &scheduling);
+    /**
+     * @brief Reads the current settings of a process, all of them are marked as set.
+     *
+     * @return False if the process does not exist anymore.
+     */
+    static bool readScheduling(pid_t pid, Scheduling &scheduling);
+    /**
+     * @brief The oom_score_adj of children which do not set their own.
+     *
+     * The daemon protects itself from the OOM killer and its children would inherit
+     * that, so they always get this value instead. Set it to the value the daemon had
+     * before it protected itself.
+     */
+    static void setDefaultOomScoreAdj(int oomScoreAdj);
+    static int getDefaultOomScoreAdj();
+    /**
+     * @brief Parses a list in the format of cpuset.cpus, like "0-1,3".
+     *
+     * @return False if the list is invalid or empty.
+     */
+    static bool parseCpuList(const std::string &str, cpu_set_t &cpus);
+    static std::string formatCpuList(const cpu_set_t &cpus);
+
+    void clear();
+
+    /**
+     * @brief Sets the executable. Names without a slash are looked up in PATH.
+     */
+    void setExecutable(const std::string &executable);
+    void addArgument(const std::string &argument);
+    void addEnvironment(const std::string &envvar);
+    void setWorkingDirectory(const std::string &workingDirectory);
+    void setUid(uid_t uid);
+    /**
+     * @brief The fd is created with O_CLOEXEC by the daemon and should be inherited anyway.
+     */
+    void addInheritedFd(int fd);
+    /**
+     * @brief The child moves itself into the cgroup before it drops its privileges.
+     *
+     * @param procsPath Path to the cgroup.procs file, empty to stay in the cgroup of the daemon.
+     */
+    void setCgroup(const std::string &procsPath);
+    /**
+     * @brief Applied in the child before it drops its privileges.
+     */
+    void setScheduling(const Scheduling &scheduling);
+    const Scheduling& getScheduling() const;
+
+    /**
+     * @brief Builds argv and envp from the arena. Has to be called before spawn().
+     */
+    void finalize();
+    bool isValid() const;
+
+    /**
+     * @brief Starts the process.
+     *
+     * @param error Set to the errno of the failed step, if the process could not be started.
+     * @return The pid of the started process or -1.
+     */
+    pid_t spawn(int &error);
+    /**
+     * @brief Result of applyScheduling() in the last started child, which is started anyway.
+     */
+    int getSchedulingError() const;
+
+    const std::string& getExecutable() const;
+    const std::string& getWorkingDirectory() const;
+    /// Null terminated, valid after finalize().
+    char * const * getArguments() const;
+    /// Null terminated, valid after finalize().
+    char * const * getEnvironment() const;
+    bool hasUid() const;
+    uid_t getUid() const;
+private:
+    static const std::size_t StackSize = 64 * 1024;
+    static int m_defaultOomScoreAdj;
+
+    std::string m_executable;
+    std::string m_workingDirectory;
+    bool m_setUid = false;
+    uid_t m_uid = 0;
+    std::vector<int> m_inheritedFds;
+    std::string m_cgroupProcs;
+    Scheduling m_scheduling;
+    int m_schedulingError = 0;
+
+    // All strings, each terminated with a NUL byte.
+    std::vector<char> m_arena;
+    std::vector<std::size_t> m_argumentOffsets;
+    std::vector<std::size_t> m_environmentOffsets;
+    std::vector<char*> m_argv;
+    std::vector<char*> m_envp;
+    bool m_valid = false;
+
+    std::vector<char> m_stack;
+};
+}
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef PIGA_DAEMON_LAUNCHTRACER_HPP_INCLUDED
+#define PIGA_DAEMON_LAUNCHTRACER_HPP_INCLUDED
+
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <sys/types.h>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include <piga/daemon/LogManager.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The LaunchTracer class records which files an app reads while it starts.
+ *
+ * The opens of the app and its children are observed with fanotify on the directories
+ * of the app and on the library directories. Only these directories are marked and not
+ * their whole mounts, so opens of other processes elsewhere do not reach the daemon.
+ * After the recording time, the pages of the opened files which are in the page cache
+ * are written as a trace in the format of Prefetcher::readTrace(), in the order the
+ * files were opened. Collecting the pages and writing the trace is done on a thread
+ * with low priority, so it does not block the main loop.
+ *
+ * Without fanotify (it needs CAP_SYS_ADMIN), only the app directory is recorded: its
+ * cached pages are collected with mincore() at the end of the recording, which may
+ * also contain pages which were cached before the start.
+ */
+class LaunchTracer
+{
+public:
+    LaunchTracer(std::shared_ptr<boost::asio::io_service> io_service);
+    ~LaunchTracer();
+
+    /**
+     * @brief Prepares a recording before the app is started, so no open is missed.
+     *
+     * @param version Stored in the trace, see readVersion().
+     */
+    void begin(const std::string &name, const std::string &directory, const std::string &traceFile, const std::string &version);
+    /**
+     * @brief Starts recording the started process of a prepared recording.
+     *
+     * @param cgroupProcs If not empty, every process in the cgroup belongs to the app.
+     *                    Otherwise, the descendants of pid do.
+     */
+    void attach(const std::string &name, pid_t pid, const std::string &cgroupProcs, std::chrono::milliseconds duration);
+    /**
+     * @brief Drops a recording without writing the trace.
+     */
+    void cancel(const std::string &name);
+    bool isRecording(const std::string &name) const;
+
+    /**
+     * @brief The version of a trace file, empty if it does not exist.
+     */
+    static std::string readVersion(const std::string &traceFile);
+private:
+    /**
+     * @brief Everything the writer thread needs to write one trace.
+     */
+    struct Trace {
+        std::string name;
+        std::string directory;
+        std::string traceFile;
+        std::string version;
+        std::vector<std::string> files;
+        /// Without fanotify, the files of the app directory are used.
+        bool scanDirectory = false;
+    };
+    struct Recording {
+        std::string name;
+        std::string directory;
+        std::string traceFile;
+        std::string version;
+        pid_t pid = 0;
+        /// Relative to the cgroup2 mount, like in /proc/<pid>/cgroup.
+        std::string cgroup;
+        /// Opened files in the order of their first open.
+        std::vector<std::string> files;
+        std::set<std::string> seen;
+        /// Processes which were checked already and if they belong to the app.
+        std::map<pid_t, bool> processes;
+        std::unique_ptr<boost::asio::posix::stream_descriptor> fanotify;
+        std::unique_ptr<boost::asio::steady_timer> timer;
+    };
+
+    /// Traces are kept compact, the rest of a launch is fast enough without them.
+    static const std::size_t MaxFiles = 2048;
+    /// Subdirectories of the app which are watched, deeper trees are rarely read at launch.
+    static const std::size_t MaxDirectories = 256;
+
+    /**
+     * @brief Marks the directories of the app and the library directories. False if the app directory could not be marked.
+     */
+    bool addMarks(int fd, const std::string &directory);
+    void asyncRead(Recording &recording);
+    void readEvents(Recording &recording);
+    bool belongsToApp(Recording &recording, pid_t pid);
+    void finish(const std::string &name);
+    /**
+     * @brief The writer thread, started with the first finished recording.
+     */
+    void run();
+    void write(Trace &trace);
+    /**
+     * @brief Appends the cached parts of the file as trace lines. Returns false if nothing is cached.
+     */
+    bool appendCachedRanges(const std::string &path, const std::string &entry, std::string &trace);
+
+    std::shared_ptr<boost::asio::io_service> m_io_service;
+    std::map<std::string, std::unique_ptr<Recording>> m_recordings;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Trace> m_traces;
+    bool m_stop = false;
+    std::thread m_thread;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
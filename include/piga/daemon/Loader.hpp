@@ -2,22 +2,41 @@
 #define PIGA_DAEMON_LOADER_HPP_INCLUDED
 
 #include <string>
-#include <vector>
+#include <map>
+#include <set>
 #include <memory>
+#include <cstdint>
+#include <sys/types.h>
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
 
 #include <piga/host.h>
+#include <piga/daemon/Scheduler.hpp>
+#include <piga/daemon/LogManager.hpp>
 
 namespace piga
 {
 namespace daemon
 {
 class Host;
+class WorkerPool;
 
+/**
+ * @brief The Loader class keeps the hosts in m_soDir loaded.
+ *
+ * Every .so file below the directory is registered with its inode and modification
+ * time. A reload only touches the entries which changed on disk: new files are loaded,
+ * removed files are unloaded and replaced files are swapped. All other hosts keep
+ * running with their state.
+ *
+ * When watching is enabled, the directory is observed with inotify and a reload is
+ * done automatically shortly after the last change.
+ */
 class Loader
 {
 public:
-    Loader(const std::string &soDir, int playerCount, std::shared_ptr<boost::asio::io_service> ioService, std::shared_ptr<piga_host> globalHost);
+    Loader(const std::string &soDir, int playerCount, std::shared_ptr<boost::asio::io_service> ioService, std::shared_ptr<Scheduler> scheduler, std::shared_ptr<piga_host> globalHost);
     ~Loader();
 
     const std::string& getSoDir();
@@ -27,18 +46,65 @@ public:
     void setPlayerCount(int playerCount);
 
     /**
-     * @brief Reloads all loaded files.
+     * @brief Enables or disables the inotify watch on the so directory.
+     */
+    void setWatching(bool watching);
+    bool isWatching() const;
+
+    /**
+     * @brief Brings the loaded hosts in sync with the so directory.
      *
      * Including:
-     *   * All loaded hosts in the m_soDir.
+     *   * Loading new hosts in the m_soDir.
+     *   * Unloading hosts whose files were removed.
+     *   * Swapping hosts whose files were replaced.
+     *
+     * If the player count changed since the last reload, all hosts are initialized again.
+     *
+     * @param pool If given, the host libraries are opened concurrently on the pool. They are
+     *             initialized one after another on the calling thread.
+     */
+    void reload(WorkerPool *pool = nullptr);
+
+    /**
+     * @brief Logs the pipeline statistics of all loaded hosts.
      */
-    void reload();
+    void logStatistics();
 private:
-    std::vector<std::shared_ptr<Host>> m_hosts;
+    struct Entry {
+        /// nullptr if the file could not be loaded. It is retried once it changes.
+        std::shared_ptr<Host> host;
+        dev_t device = 0;
+        ino_t inode = 0;
+        int64_t mtime = 0;
+    };
+
+    /// Coalesces bursts of file system events (copying, linking, ...) into one reload.
+    static const int WatchDebounceMs = 200;
+
+    void updateWatches();
+    void stopWatching();
+    void asyncWatch();
+    void watchEvent();
+
+    std::map<std::string, Entry> m_hosts;
     std::string m_soDir;
     int m_playerCount;
+    int m_loadedPlayerCount = -1;
     std::shared_ptr<boost::asio::io_service> m_ioService;
+    std::shared_ptr<Scheduler> m_scheduler;
     std::shared_ptr<piga_host> m_globalHost;
+
+    // All directories below and including m_soDir, as found by the last reload.
+    std::set<std::string> m_directories;
+
+    int m_inotifyFd = -1;
+    // Watch descriptors and their directories.
+    std::map<int, std::string> m_watches;
+    std::unique_ptr<boost::asio::posix::stream_descriptor> m_inotifyDescriptor;
+    boost::asio::steady_timer m_reloadTimer;
+
+    SeverityChannelLogger m_log;
 };
 }
 }
@@ -0,0 +1,60 @@
+#ifndef PIGA_DAEMON_MEMORYPRESSUREMONITOR_HPP_INCLUDED
+#define PIGA_DAEMON_MEMORYPRESSUREMONITOR_HPP_INCLUDED
+
+#include <memory>
+#include <functional>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include <piga/daemon/LogManager.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The MemoryPressureMonitor class reports memory pressure on the io_service.
+ *
+ * A trigger is registered in /proc/pressure/memory (PSI, Linux 5.2 and later). The
+ * kernel signals it when tasks were stalled on memory for longer than the threshold
+ * within the window, at most once per window. After no trigger for two windows, the
+ * pressure is reported to have eased.
+ */
+class MemoryPressureMonitor
+{
+public:
+    typedef std::function<void()> Handler;
+
+    MemoryPressureMonitor(std::shared_ptr<boost::asio::io_service> io_service);
+    ~MemoryPressureMonitor();
+
+    /**
+     * @param stallMs Time in milliseconds some tasks have to be stalled on memory within the window.
+     * @param windowMs Length of the window in milliseconds, between 500 and 10000. Without
+     *                 CAP_SYS_RESOURCE, it has to be a multiple of 2000.
+     * @param pressure Called on every trigger.
+     * @param eased Called once after the pressure is gone.
+     * @return False if PSI is not available.
+     */
+    bool start(unsigned int stallMs, unsigned int windowMs, Handler pressure, Handler eased);
+    void stop();
+    bool isActive() const;
+private:
+    void asyncWait();
+    void triggered();
+
+    std::shared_ptr<boost::asio::io_service> m_io_service;
+    std::unique_ptr<boost::asio::posix::stream_descriptor> m_descriptor;
+    boost::asio::steady_timer m_easeTimer;
+    unsigned int m_windowMs = 2000;
+    bool m_underPressure = false;
+    Handler m_pressure;
+    Handler m_eased;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef PIGA_DAEMON_NOTIFYSOCKET_HPP_INCLUDED
+#define PIGA_DAEMON_NOTIFYSOCKET_HPP_INCLUDED
+
+#include <string>
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include <piga/daemon/LogManager.hpp>
+
+#define PIGA_DAEMON_NOTIFY_ENVVAR "PIGA_DAEMON_NOTIFY_FD"
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The NotifySocket class receives state notifications of started apps.
+ *
+ * It is a datagram socket pair. The client end is inherited by every app and published
+ * in the PIGA_DAEMON_NOTIFY_FD environment variable. Apps send messages in the style of
+ * sd_notify(), newline separated assignments like "READY=1" or "STATUS=Loading assets".
+ * Menus can hint at apps which are about to be started with "PREFETCH=<app>".
+ * The kernel attaches the pid of the sender to every message, so only the main process
+ * of an app can notify the daemon about the app.
+ */
+class NotifySocket
+{
+public:
+    typedef std::function<void(pid_t pid, const std::string &message)> Handler;
+
+    NotifySocket(std::shared_ptr<boost::asio::io_service> io_service);
+    ~NotifySocket();
+
+    /**
+     * @brief Calls the handler for every received message until the socket is destroyed.
+     */
+    void asyncReceive(Handler handler);
+
+    /**
+     * @brief The end which is inherited by the apps.
+     */
+    int getClientFd() const;
+    bool isValid() const;
+private:
+    void asyncWait();
+    void receive();
+
+    int m_serverFd = -1;
+    int m_clientFd = -1;
+    std::shared_ptr<boost::asio::io_service> m_io_service;
+    std::unique_ptr<boost::asio::posix::stream_descriptor> m_descriptor;
+    Handler m_handler;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef PIGA_DAEMON_PREFETCHER_HPP_INCLUDED
+#define PIGA_DAEMON_PREFETCHER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+
+#include <piga/daemon/LogManager.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The Prefetcher class reads files into the page cache before they are needed.
+ *
+ * Jobs are processed in order on a thread with batch scheduling, nice 19 and the
+ * lowest best-effort I/O priority, so prefetching never competes with running apps.
+ * Every range is read with readahead(), which falls back to posix_fadvise(WILLNEED).
+ *
+ * Paths may contain glob patterns. Directories are prefetched recursively.
+ */
+class Prefetcher
+{
+public:
+    struct Range {
+        std::string path;
+        uint64_t offset = 0;
+        /// 0 reads until the end of the file.
+        uint64_t length = 0;
+    };
+
+    struct Statistics {
+        uint64_t jobs = 0;
+        uint64_t files = 0;
+        uint64_t bytes = 0;
+    };
+
+    Prefetcher();
+    ~Prefetcher();
+
+    void start();
+    void stop();
+
+    /**
+     * @brief Queues the ranges. A job with the same name which is still queued or running is not queued again.
+     *
+     * @param traceFile If given, its ranges are prefetched after the other ones, see readTrace().
+     *                  It is read on the prefetch thread.
+     */
+    void prefetch(const std::string &name, std::vector<Range> ranges, const std::string &traceFile = std::string());
+
+    /**
+     * @brief Appends the ranges of a trace file.
+     *
+     * Every line is either a path, which is read completely, or "<offset> <length> <path>".
+     * Empty lines and lines starting with # are skipped. Relative paths are relative to the
+     * directory of the trace file.
+     *
+     * @return False if the file could not be read.
+     */
+    static bool readTrace(const std::string &traceFile, std::vector<Range> &ranges);
+
+    Statistics getStatistics();
+    void logStatistics();
+private:
+    struct Job {
+        std::string name;
+        std::vector<Range> ranges;
+        std::string traceFile;
+    };
+
+    void run();
+    void process(const Job &job, uint64_t &files, uint64_t &bytes);
+    void prefetchPath(const Range &range, uint64_t &files, uint64_t &bytes);
+    bool prefetchFile(const std::string &path, uint64_t offset, uint64_t length, uint64_t &bytes);
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Job> m_jobs;
+    std::string m_running;
+    bool m_stop = false;
+    Statistics m_statistics;
+    std::thread m_thread;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
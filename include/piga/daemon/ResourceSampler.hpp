@@ -0,0 +1,82 @@
+#ifndef PIGA_DAEMON_RESOURCESAMPLER_HPP_INCLUDED
+#define PIGA_DAEMON_RESOURCESAMPLER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+#include <piga/daemon/sdk/App.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The ResourceSampler class keeps the recent resource usage of one app.
+ *
+ * Every sample reads the cumulative counters of the app from /proc or its cgroup and
+ * stores the difference to the previous sample as rates. Only the last samples are
+ * kept in a ring, so the memory usage is fixed.
+ *
+ * The memory of an app with a cgroup is its memory.current, which is higher than the
+ * resident set of the main process reported for apps without one.
+ */
+class ResourceSampler
+{
+public:
+    typedef sdk::App::ResourceSample Sample;
+
+    ResourceSampler(std::size_t capacity = 120);
+
+    /**
+     * @brief Changes the number of kept samples, the history is cleared.
+     */
+    void setCapacity(std::size_t capacity);
+    /**
+     * @brief Clears the history, for example when the app was started again.
+     */
+    void reset();
+
+    /**
+     * @param pid The main process of the app.
+     * @param cgroupProcs The cgroup.procs file of the app or an empty string.
+     * @return False if the counters could not be read. The first successful call only
+     *         records the counters and adds no sample.
+     */
+    bool sample(pid_t pid, const std::string &cgroupProcs);
+
+    bool hasSamples() const;
+    const Sample& getCurrent() const;
+    /**
+     * @brief All kept samples, the oldest one first.
+     */
+    std::vector<Sample> getHistory() const;
+private:
+    struct Counters {
+        std::chrono::steady_clock::time_point time;
+        uint64_t cpuNs = 0;
+        uint64_t memory = 0;
+        uint64_t readBytes = 0;
+        uint64_t writeBytes = 0;
+        uint64_t voluntarySwitches = 0;
+        uint64_t involuntarySwitches = 0;
+        uint64_t runDelayNs = 0;
+    };
+
+    static bool readProcess(pid_t pid, Counters &counters);
+    static bool readCgroup(const std::string &group, Counters &counters);
+
+    std::vector<Sample> m_samples;
+    std::size_t m_capacity;
+    // Index of the next sample to overwrite, once the ring is full.
+    std::size_t m_next = 0;
+    Counters m_last;
+    bool m_hasLast = false;
+};
+}
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef PIGA_DAEMON_SCHEDULER_HPP_INCLUDED
+#define PIGA_DAEMON_SCHEDULER_HPP_INCLUDED
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <piga/daemon/LogManager.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The Scheduler class runs periodic tasks on the io_service using a single timer.
+ *
+ * Tasks are kept in a hashed timer wheel with a resolution of one millisecond. Deadlines
+ * are absolute points on the steady clock, so a task which is late or takes some time
+ * does not shift all following runs. If a task falls behind by more than a whole period,
+ * the missed runs are skipped and counted instead of being run back to back.
+ *
+ * The timer only expires for the next deadline, so an idle scheduler does not wake up.
+ */
+class Scheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<void()> Task;
+    typedef uint32_t Handle;
+
+    struct Statistics {
+        uint64_t runs = 0;
+        /// Runs which took longer than the period of the task.
+        uint64_t overruns = 0;
+        /// Runs which were skipped because the task was late by more than a period.
+        uint64_t missedDeadlines = 0;
+        std::chrono::microseconds maxLateness = std::chrono::microseconds(0);
+        std::chrono::microseconds maxRuntime = std::chrono::microseconds(0);
+    };
+
+    Scheduler(std::shared_ptr<boost::asio::io_service> io_service);
+    ~Scheduler();
+
+    /**
+     * @brief Registers a periodic task. The first run happens one period from now.
+     *
+     * @return Handle to change or remove the task later. 0 is never returned.
+     */
+    Handle add(const std::string &name, std::chrono::microseconds period, Task task);
+    void remove(Handle handle);
+
+    /**
+     * @brief Changes the period of a task and lets its next run happen one period from now.
+     *
+     * This can also be called from inside of the task itself.
+     */
+    void reschedule(Handle handle, std::chrono::microseconds period);
+
+    Statistics getStatistics(Handle handle) const;
+    std::vector<std::pair<std::string, Statistics>> getAllStatistics() const;
+    void logStatistics();
+private:
+    struct Entry {
+        std::string name;
+        std::chrono::microseconds period;
+        Clock::time_point deadline;
+        Task task;
+        Statistics statistics;
+        uint32_t generation = 0;
+        bool rescheduled = false;
+    };
+    typedef std::pair<Handle, uint32_t> SlotEntry;
+
+    static const std::size_t WheelSize = 256;
+
+    int64_t toTick(Clock::time_point time) const;
+    void insert(Handle handle, Entry &entry);
+    void arm();
+    void expired(const boost::system::error_code &error);
+    void run(Handle handle, Entry &entry, Clock::time_point now);
+
+    std::shared_ptr<boost::asio::io_service> m_io_service;
+    boost::asio::steady_timer m_timer;
+
+    Clock::time_point m_epoch;
+    int64_t m_currentTick = 0;
+    std::vector<std::vector<SlotEntry>> m_wheel;
+    std::map<Handle, Entry> m_entries;
+    Handle m_nextHandle = 1;
+    Clock::time_point m_armedFor;
+    bool m_armed = false;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
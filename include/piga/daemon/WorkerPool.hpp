@@ -0,0 +1,50 @@
+#ifndef PIGA_DAEMON_WORKERPOOL_HPP_INCLUDED
+#define PIGA_DAEMON_WORKERPOOL_HPP_INCLUDED
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <cstddef>
+#include <boost/asio/io_service.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The WorkerPool class runs independent jobs concurrently on a few threads.
+ *
+ * It is used while starting the daemon to load hosts and parse app configs in
+ * parallel. The calling thread takes part in every batch, so batches can be nested
+ * (a job may start a batch itself) without blocking the pool.
+ */
+class WorkerPool
+{
+public:
+    /**
+     * @param threads Number of worker threads. 0 uses one per core, but at most MaxThreads.
+     */
+    WorkerPool(unsigned int threads = 0);
+    ~WorkerPool();
+
+    /**
+     * @brief Calls function(i) for every i in [0, count) and returns after all calls finished.
+     *
+     * If calls throw, the first exception is rethrown on the calling thread once all
+     * calls finished.
+     */
+    void parallelFor(std::size_t count, std::function<void(std::size_t)> function);
+
+    unsigned int getThreadCount() const;
+
+    static const unsigned int MaxThreads = 4;
+private:
+    std::shared_ptr<boost::asio::io_service> m_io_service;
+    std::shared_ptr<boost::asio::io_service::work> m_work;
+    std::vector<std::thread> m_threads;
+};
+}
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef PIGA_DAEMON_ZYGOTE_HPP_INCLUDED
+#define PIGA_DAEMON_ZYGOTE_HPP_INCLUDED
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <sys/types.h>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include <piga/daemon/LaunchPlan.hpp>
+#include <piga/daemon/LogManager.hpp>
+
+/**
+ * Default entry point of apps started by the zygote. An app opts in by building its
+ * game as a shared library exporting
+ *
+ *     extern "C" int piga_app_main(int argc, char **argv);
+ *
+ * and setting execution.zygote_library in its app_config.cfg.
+ */
+#define PIGA_DAEMON_ZYGOTE_DEFAULT_ENTRY "piga_app_main"
+
+namespace piga
+{
+namespace daemon
+{
+/**
+ * @brief The Zygote class starts apps from a process with preloaded libraries.
+ *
+ * The zygote is the daemon executable started with --zygote. It loads the configured
+ * shared libraries (SDL, the piga client library, ...) once and waits for requests on
+ * a unix socket. For every request it forks, applies uid, working directory and
+ * environment and calls the entry point of the app library in the child. No exec
+ * and no dynamic linking of the preloaded libraries happen at launch time.
+ *
+ * The child is forked by a short lived intermediate process, so it is reparented to
+ * the daemon, which is a child subreaper, and can be reaped like every other app.
+ */
+class Zygote
+{
+public:
+    /**
+     * @brief Called with the pid of the started app, or with -1 and the errno.
+     */
+    typedef std::function<void(pid_t pid, int error)> SpawnHandler;
+
+    Zygote(std::shared_ptr<boost::asio::io_service> io_service);
+    ~Zygote();
+
+    /**
+     * @brief Starts the zygote process, which preloads the given libraries.
+     */
+    bool start(const std::vector<std::string> &preload);
+    bool isRunning() const;
+
+    /**
+     * @brief Starts an app from the zygote without waiting for it.
+     *
+     * The arguments, environment, working directory and uid are taken from the plan.
+     * Requests are answered in order. The handler is always called later on the
+     * io_service, also if the request fails right away.
+     */
+    void spawn(const LaunchPlan &plan, const std::string &library, const std::string &entry, SpawnHandler handler);
+
+    /**
+     * @brief The main function of the zygote process.
+     */
+    static int run(int fd, const std::vector<std::string> &preload);
+private:
+    struct Reply {
+        int32_t pid;
+        int32_t error;
+    };
+
+    static const std::size_t MaxRequestSize = 256 * 1024;
+    /// Milliseconds to wait for the reply of the zygote.
+    static const int ReplyTimeout = 2000;
+
+    /**
+     * @brief Sends the queued requests until the socket is full.
+     */
+    void sendRequests();
+    void readReplies();
+    void asyncWrite();
+    void asyncRead();
+    void armTimeout();
+    /**
+     * @brief Stops using the zygote and fails all requests with the error.
+     */
+    void handleDeath(int error);
+
+    std::shared_ptr<boost::asio::io_service> m_io_service;
+    std::unique_ptr<boost::asio::posix::stream_descriptor> m_socket;
+    std::unique_ptr<boost::asio::steady_timer> m_timeout;
+    /// Requests which were not sent yet, they are the last ones in m_handlers.
+    std::deque<std::vector<char>> m_requests;
+    /// Handlers of all requests which were not answered yet, in the order of the replies.
+    std::deque<SpawnHandler> m_handlers;
+    bool m_writing = false;
+    bool m_reading = false;
+    pid_t m_pid = -1;
+
+    SeverityChannelLogger m_log;
+};
+}
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef PIGA_DAEMON_HOST_EXTENSION_TYPES_H_INCLUDED
+#define PIGA_DAEMON_HOST_EXTENSION_TYPES_H_INCLUDED
+
+/**
+ * Types of the optional host extensions, see host_extensions.h for the functions.
+ *
+ * Kept apart from the function declarations, so the daemon can use the types without
+ * declaring the symbols of a host library in every translation unit.
+ */
+
+#include <stdint.h>
+
+/**
+ * Version of the extensions in host_extensions.h.
+ *
+ * 1: pullInputs()
+ * 2: getHostExtensionVersion() and pollInputs()
+ */
+#define PIGA_DAEMON_HOST_EXTENSION_VERSION 2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct piga_host_input {
+    int player;
+    int input;
+    int value;
+} piga_host_input;
+
+typedef struct piga_host_timed_input {
+    int player;
+    int input;
+    int value;
+    /// CLOCK_MONOTONIC time in nanoseconds at which the host read the input.
+    uint64_t monotonic_ns;
+} piga_host_timed_input;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef PIGA_DAEMON_HOST_EXTENSIONS_H_INCLUDED
+#define PIGA_DAEMON_HOST_EXTENSIONS_H_INCLUDED
+
+/**
+ * Optional symbols a host library can export in addition to the interface of
+ * piga/hosts/host.h. The daemon checks for them while loading a host.
+ *
+ * Included by host libraries which implement the extensions. In the daemon, only the
+ * code resolving the host symbols includes it, everything else uses the types from
+ * host_extension_types.h.
+ */
+
+#include <piga/daemon/host_extension_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Used by hosts which return HOST_RETURNCODE_USEINPUTMETHODS from init().
+ *
+ * Writes up to capacity inputs, which changed since the last call, into the buffer
+ * and returns their count. Called once per update tick of the host. If the buffer
+ * was filled completely, it is called again in the same tick.
+ */
+int pullInputs(piga_host_input *buffer, int capacity);
+
+/**
+ * Returns PIGA_DAEMON_HOST_EXTENSION_VERSION of the header the host was built with.
+ */
+int getHostExtensionVersion(void);
+
+/**
+ * Available since version 2 and preferred over every other pipeline.
+ *
+ * Works like pullInputs(), but every input carries the time it was read by the host,
+ * which the daemon uses for latency accounting. A host exporting this function is
+ * only read through it, the input callback is not registered.
+ */
+int pollInputs(piga_host_timed_input *buffer, int capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
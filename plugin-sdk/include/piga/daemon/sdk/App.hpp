@@ -1,5 +1,12 @@
 #pragma once
 
+#include <string>
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <sys/types.h>
+
 namespace piga
 {
 namespace daemon
@@ -9,6 +16,42 @@ namespace sdk
 class App
 {
 public:
+    /**
+     * @brief Called after the app has stopped.
+     */
+    typedef std::function<void()> StopHandler;
+    /**
+     * @brief Named values describing the current state of the app, used for diagnostics.
+     */
+    typedef std::map<std::string, std::string> Status;
+
+    /**
+     * @brief Resource usage of the app between two samples.
+     *
+     * If the app has a cgroup, CPU, memory and I/O include its children. The scheduler
+     * values are always the ones of the main thread.
+     */
+    struct ResourceSample {
+        /// Milliseconds since the epoch.
+        uint64_t time = 0;
+        /// Percent of one core.
+        double cpu = 0;
+        /**
+         * Memory in bytes. With a cgroup, this is its memory.current, which also counts
+         * the page cache and kernel memory of the app. Otherwise, it is the resident set
+         * of the main process.
+         */
+        uint64_t memory = 0;
+        /// Bytes per second.
+        double readRate = 0;
+        double writeRate = 0;
+        /// Context switches per second.
+        double voluntarySwitches = 0;
+        double involuntarySwitches = 0;
+        /// Percent of the time the main thread waited on a run queue.
+        double runDelay = 0;
+    };
+
     virtual void loadFromName(const std::string &name) = 0;
     virtual void loadFromPath(const std::string &path, bool autostart_active = true) = 0;
     virtual bool loadConfigFile(const std::string &configPath) = 0;
@@ -16,7 +59,13 @@ public:
     
     virtual void reload(bool start = false) = 0;
     virtual void start(bool restartIfRunning = false) = 0;
-    virtual void stop() = 0; 
+    /**
+     * @brief Stops the app without blocking.
+     *
+     * The app gets SIGTERM and is killed if it did not exit after a grace period. The
+     * handler is called once the app exited, or right away if it was not running.
+     */
+    virtual void stop(StopHandler handler = StopHandler()) = 0;
 
     virtual bool isRunning() const = 0;
     virtual bool isInstalled() const = 0;
@@ -31,6 +80,17 @@ public:
     virtual const std::string& getWorkingDir() const = 0;
     virtual const std::string& getExecutable() const = 0;
     virtual bool isAutostart() const = 0;
+
+    /**
+     * @brief Collects the state of the app and its process.
+     *
+     * Has to be called on the io_service of the daemon, like all other methods.
+     */
+    virtual Status getStatus() const = 0;
+    /**
+     * @brief The recent resource usage of the running app, the oldest sample first.
+     */
+    virtual std::vector<ResourceSample> getResourceHistory() const = 0;
 };
 }
 }
@@ -20,6 +20,15 @@ public:
     
     virtual AppPtr operator[](const std::string &name) = 0;
     virtual AppPtr getApp(const std::string &name) = 0;
+
+    /**
+     * @brief Makes the running app the foreground app, which is prioritized over all others.
+     */
+    virtual void setForegroundApp(const std::string &name) = 0;
+    /**
+     * @brief Hints that the app will probably be started soon, so its files are read ahead.
+     */
+    virtual void prefetchApp(const std::string &name) = 0;
 };
 }
 }
@@ -2,25 +2,76 @@
 #include <libconfig.h++>
 #include <boost/log/trivial.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/binary_object.hpp>
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <functional>
+#include <chrono>
+#include <algorithm>
 #include <piga/daemon/Daemon.hpp>
+#include <piga/daemon/NotifySocket.hpp>
 
 namespace piga
 {
 namespace daemon
 {
-App::App(const std::string &defaultAppPath, uid_t defaultUID, char **envp)
-    : m_appPath(defaultAppPath), m_uid(defaultUID), m_envp(envp)
+namespace
+{
+const char *PolicyNames[] = {"other", "fifo", "rr", "batch", nullptr, "idle"};
+const char *IoprioClassNames[] = {"none", "realtime", "best-effort", "idle"};
+
+bool getPolicyFromStr(const std::string &str, int &policy)
+{
+    for(int i = 0; i < 6; ++i) {
+        if(PolicyNames[i] != nullptr && str == PolicyNames[i]) {
+            policy = i;
+            return true;
+        }
+    }
+    return false;
+}
+bool getIoprioClassFromStr(const std::string &str, int &ioprioClass)
+{
+    for(int i = 1; i < 4; ++i) {
+        if(str == IoprioClassNames[i]) {
+            ioprioClass = i;
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+App::App(const std::string &defaultAppPath, uid_t defaultUID, char **envp, std::shared_ptr<ChildReaper> reaper, std::shared_ptr<Zygote> zygote, std::shared_ptr<CgroupManager> cgroups)
+    : m_appPath(defaultAppPath), m_uid(defaultUID), m_envp(envp), m_reaper(reaper), m_zygote(zygote), m_cgroups(cgroups),
+      m_random(std::random_device()())
 {
     m_args.resize(1);
 }
 App::~App()
 {
+    if(m_stopTimer) {
+        boost::system::error_code ec;
+        m_stopTimer->cancel(ec);
+    }
+    cancelRestart();
+    // Nothing could handle the exit anymore, so the app is killed right away.
     if(isRunning()) {
-        stop();
+        killNow();
     }
 }
 void App::loadFromName(const std::string &name)
@@ -33,8 +84,12 @@ void App::loadFromPath(const std::string &path, bool autostart_active)
     m_path = path;
     
     m_workingDir = path;
-    if(loadConfigFile(std::string(path + "/app_config.cfg"))) {
+    bool cached = m_catalog && m_catalog->restore(*this, path);
+    if(cached || loadConfigFile(std::string(path + "/app_config.cfg"))) {
+        if(m_catalog && !cached)
+            m_catalog->store(*this, path);
         m_log = SeverityChannelLogger(boost::log::keywords::channel = "Class:App (\"" + m_name + "\")");
+        buildLaunchPlan();
         m_appLog = SeverityChannelLogger(boost::log::keywords::channel = "App \"" + m_name + "\"");
         
         BOOST_LOG_SEV(m_log,L_INFO) << "App stub \"" << m_name << "\" successfully loaded into the internal database from \"" << path << "\".";
@@ -90,6 +145,39 @@ bool App::loadConfigFile(const std::string &configPath)
         BOOST_LOG_SEV(m_log, L_WARN) << "App config file \"" << configPath << "\" doesn't define restart_on_crash!";
         m_restartOnCrash = false;
     }
+    // Optional, most apps exit quickly enough on SIGTERM.
+    root.lookupValue("stop_timeout", m_stopTimeout);
+    // Optional, background services should neither take the foreground nor be frozen.
+    root.lookupValue("freezable", m_freezable);
+    root.lookupValue("takes_foreground", m_takesForeground);
+    root.lookupValue("memory_priority", m_memoryPriority);
+    // Optional, the startup order and readiness of the app.
+    root.lookupValue("notify", m_notify);
+    root.lookupValue("ready_timeout", m_readyTimeout);
+    m_after.clear();
+    if(root.exists("after")) {
+        Setting &after = root["after"];
+        for(int i = 0; i < after.getLength(); ++i) {
+            m_after.push_back(after[i].c_str());
+        }
+    }
+    m_requires.clear();
+    if(root.exists("requires")) {
+        Setting &requires = root["requires"];
+        for(int i = 0; i < requires.getLength(); ++i) {
+            m_requires.push_back(requires[i].c_str());
+        }
+    }
+    // Optional, files, directories or globs relative to the app directory.
+    m_prefetch.clear();
+    if(root.exists("prefetch")) {
+        Setting &prefetch = root["prefetch"];
+        for(int i = 0; i < prefetch.getLength(); ++i) {
+            m_prefetch.push_back(prefetch[i].c_str());
+        }
+    }
+    m_prefetchTrace = "prefetch.trace";
+    root.lookupValue("prefetch_trace", m_prefetchTrace);
     if(!root.lookupValue("restart_on_exit", m_restartOnExit)) {
         BOOST_LOG_SEV(m_log, L_WARN) << "App config file \"" << configPath << "\" doesn't define restart_on_exit!";
         m_restartOnExit = false;
@@ -107,7 +195,8 @@ bool App::loadConfigFile(const std::string &configPath)
             Setting &args = execution["arguments"];
             m_args.resize(args.getLength() + 1);
             for(std::size_t i = 0; i < args.getLength(); ++i) {
-                m_args[i] = *(args[i]);
+                // The first argument is the executable itself.
+                m_args[i + 1] = *(args[i]);
             }
         }
         catch (const SettingNotFoundException &e) {
@@ -127,9 +216,71 @@ bool App::loadConfigFile(const std::string &configPath)
         if(!execution.lookupValue("working_directory", m_workingDir))
             BOOST_LOG_SEV(m_log, L_WARN) << "App config file \"" << configPath << "\" doesn't specify an working directory. It will be executed in it's root folder.";
 
+        // Optional, apps built as a shared library can be started from the zygote.
+        execution.lookupValue("zygote_library", m_zygoteLibrary);
+        execution.lookupValue("zygote_entry", m_zygoteEntry);
+
         if(!execution.lookupValue("uid", m_uid))
             BOOST_LOG_SEV(m_log, L_WARN) << "App config file \"" << configPath << "\" doesn't specify an uid. It will be executed with the default uid for apps: " << m_uid;
     }
+
+    // Optional, settings which are not given are inherited from the daemon.
+    m_scheduling = LaunchPlan::Scheduling();
+    if(root.exists("scheduling")) {
+        Setting &scheduling = root["scheduling"];
+
+        std::string policy;
+        if(scheduling.lookupValue("policy", policy)) {
+            m_scheduling.setPolicy = getPolicyFromStr(policy, m_scheduling.policy);
+            if(!m_scheduling.setPolicy)
+                BOOST_LOG_SEV(m_log, L_WARN) << "App config file \"" << configPath << "\" has the unknown scheduling policy \"" << policy << "\". Use other, batch, idle, fifo or rr.";
+            scheduling.lookupValue("priority", m_scheduling.priority);
+        }
+        m_scheduling.setNice = scheduling.lookupValue("nice", m_scheduling.nice);
+
+        std::string ioprioClass;
+        if(scheduling.lookupValue("ioprio_class", ioprioClass)) {
+            m_scheduling.setIoprio = getIoprioClassFromStr(ioprioClass, m_scheduling.ioprioClass);
+            if(!m_scheduling.setIoprio)
+                BOOST_LOG_SEV(m_log, L_WARN) << "App config file \"" << configPath << "\" has the unknown ioprio class \"" << ioprioClass << "\". Use realtime, best-effort or idle.";
+            scheduling.lookupValue("ioprio_level", m_scheduling.ioprioLevel);
+        }
+
+        m_scheduling.setOomScoreAdj = scheduling.lookupValue("oom_score_adj", m_scheduling.oomScoreAdj);
+
+        std::string affinity;
+        if(scheduling.lookupValue("affinity", affinity)) {
+            m_scheduling.setAffinity = LaunchPlan::parseCpuList(affinity, m_scheduling.affinity);
+            if(!m_scheduling.setAffinity)
+                BOOST_LOG_SEV(m_log, L_WARN) << "App config file \"" << configPath << "\" has the invalid CPU affinity \"" << affinity << "\". Use a list like \"0-1,3\".";
+        }
+    }
+
+    // Optional, only used if the daemon manages cgroups.
+    m_limits = CgroupManager::Limits();
+    if(root.exists("resources")) {
+        Setting &resources = root["resources"];
+        resources.lookupValue("cpu_max", m_limits.cpuMax);
+        resources.lookupValue("cpuset", m_limits.cpuset);
+        resources.lookupValue("memory_high", m_limits.memoryHigh);
+        resources.lookupValue("memory_max", m_limits.memoryMax);
+        resources.lookupValue("io_weight", m_limits.ioWeight);
+    }
+
+    // Optional, restart_on_crash and restart_on_exit decide if the app is restarted at all.
+    m_restartPolicy = RestartPolicy();
+    if(root.exists("restart")) {
+        Setting &restart = root["restart"];
+        restart.lookupValue("initial_delay", m_restartPolicy.initialDelay);
+        restart.lookupValue("max_delay", m_restartPolicy.maxDelay);
+        restart.lookupValue("multiplier", m_restartPolicy.multiplier);
+        restart.lookupValue("jitter", m_restartPolicy.jitter);
+        restart.lookupValue("max_restarts", m_restartPolicy.maxRestarts);
+        restart.lookupValue("window", m_restartPolicy.window);
+        restart.lookupValue("stable_time", m_restartPolicy.stableTime);
+        m_restartPolicy.multiplier = std::max(m_restartPolicy.multiplier, 1.0);
+        m_restartPolicy.jitter = std::min(std::max(m_restartPolicy.jitter, 0.0), 0.9);
+    }
     return true;
 }
 void App::generateSampleConfig(const std::string &output)
@@ -144,11 +295,45 @@ void App::generateSampleConfig(const std::string &output)
     root.add("wait_for_signal", Setting::TypeBoolean) = false;
     root.add("restart_on_crash", Setting::TypeBoolean) = false;
     root.add("restart_on_exit", Setting::TypeBoolean) = false;
+    root.add("stop_timeout", Setting::TypeInt) = 3000;
+    root.add("freezable", Setting::TypeBoolean) = false;
+    root.add("takes_foreground", Setting::TypeBoolean) = true;
+    root.add("memory_priority", Setting::TypeInt) = 0;
+    root.add("notify", Setting::TypeBoolean) = false;
+    root.add("ready_timeout", Setting::TypeInt) = 30000;
+    root.add("after", Setting::TypeArray);
+    root.add("requires", Setting::TypeArray);
+    root.add("prefetch", Setting::TypeArray);
+    root.add("prefetch_trace", Setting::TypeString) = "prefetch.trace";
     Setting & exec = root.add("execution", Setting::TypeGroup);
     exec.add("executable", Setting::TypeString) = "executable_relative_to_directory_path";
     exec.add("arguments", Setting::TypeArray);
     exec.add("working_directory", Setting::TypeString) = "working directory - absolute (/) or relative (./ or sth/).";
     exec.add("uid", Setting::TypeInt) = 1010;
+    exec.add("zygote_library", Setting::TypeString) = "";
+    exec.add("zygote_entry", Setting::TypeString) = PIGA_DAEMON_ZYGOTE_DEFAULT_ENTRY;
+    Setting & scheduling = root.add("scheduling", Setting::TypeGroup);
+    scheduling.add("policy", Setting::TypeString) = "other";
+    scheduling.add("priority", Setting::TypeInt) = 0;
+    scheduling.add("nice", Setting::TypeInt) = 0;
+    scheduling.add("ioprio_class", Setting::TypeString) = "best-effort";
+    scheduling.add("ioprio_level", Setting::TypeInt) = 4;
+    scheduling.add("oom_score_adj", Setting::TypeInt) = 0;
+    scheduling.add("affinity", Setting::TypeString) = "0-3";
+    Setting & resources = root.add("resources", Setting::TypeGroup);
+    resources.add("cpu_max", Setting::TypeString) = "max 100000";
+    resources.add("cpuset", Setting::TypeString) = "";
+    resources.add("memory_high", Setting::TypeString) = "max";
+    resources.add("memory_max", Setting::TypeString) = "max";
+    resources.add("io_weight", Setting::TypeInt) = 100;
+    Setting & restart = root.add("restart", Setting::TypeGroup);
+    restart.add("initial_delay", Setting::TypeInt) = 500;
+    restart.add("max_delay", Setting::TypeInt) = 30000;
+    restart.add("multiplier", Setting::TypeFloat) = 2.0;
+    restart.add("jitter", Setting::TypeFloat) = 0.2;
+    restart.add("max_restarts", Setting::TypeInt) = 5;
+    restart.add("window", Setting::TypeInt) = 60000;
+    restart.add("stable_time", Setting::TypeInt) = 10000;
 
     try {
         cfg.writeFile(output.c_str());
@@ -168,10 +353,27 @@ void App::executeAutostart()
 }
 void App::start(bool restartIfRunning)
 {
+    if(!m_automaticRestart) {
+        // Starting the app explicitly gives it a fresh chance.
+        cancelRestart();
+        if(m_restartTripped)
+            BOOST_LOG_SEV(m_log, L_INFO) << "App \"" << m_name << "\" is started explicitly, so it may be restarted automatically again.";
+        m_restartTripped = false;
+        m_restartAttempts = 0;
+        m_restartTimes.clear();
+    }
+
+    if(m_starting) {
+        BOOST_LOG_SEV(m_log, L_INFO) << "App \"" << m_name << "\" is already being started.";
+        return;
+    }
     if(isRunning()) {
         if(restartIfRunning) {
             BOOST_LOG_SEV(m_log, L_INFO) << "App \"" << m_name << "\" with executable \"" << m_path << "/" << m_executable << "\" is already running and will be restarted.";
-            stop();
+            stop([this]() {
+                start();
+            });
+            return;
         } else {
             BOOST_LOG_SEV(m_log, L_INFO) << "App \"" << m_name << "\" with executable \"" << m_path << "/" << m_executable << "\" is already running and will not be restarted!";
             return;
@@ -180,109 +382,253 @@ void App::start(bool restartIfRunning)
 
     BOOST_LOG_SEV(m_log, L_INFO) << "Starting app \"" << m_name << "\" with executable \"" << m_path << "/" << m_executable << "\".";
     
-    // Arguments and environment variables.
-    m_args[0] = (m_path + "/" + m_executable).c_str();
-    char **args = new char*[m_args.size() + 1];
-    for(std::size_t i = 0; i < m_args.size(); ++i) {
-        args[i] = new char[m_args[i].length()];
-        std::memcpy(args[i], m_args[i].c_str(), m_args[i].length());
-    }
-    args[m_args.size()] = nullptr;
-    
-    std::size_t envpSize = 0;
-    while(m_envp[envpSize] != nullptr) {
-        ++envpSize;
+    if(!m_launchPlan.isValid()) {
+        buildLaunchPlan();
     }
-    
-    envpSize += m_envvars.size() + 2;
-    
-    char **env = new char*[envpSize + 1];
-    for(std::size_t i = 0; i < envpSize; ++i) {
-        
-        if(i == 0) {
-            // The pidfile envvar should always be set.
-            std::string pidfile_envvar = "PIGA_DAEMON_PIDFILE_PATH=";
-            pidfile_envvar += Daemon::getPidfilePath();
-            env[i] = new char[pidfile_envvar.length()];
-            std::memcpy(env[i], pidfile_envvar.c_str(), pidfile_envvar.length());
-        }
-        else if(i == 1) {
-            // The XDG_RUNTIME_DIR should be set.
-            std::string runtime_envvar = "XDG_RUNTIME_DIR=";
-            if(m_runAsRoot)
-                runtime_envvar += "/run/user/0";
-            else 
-                runtime_envvar += "/run/user/" + std::to_string(m_uid);
-            env[i] = new char[runtime_envvar.length()];
-            std::memcpy(env[i], runtime_envvar.c_str(), runtime_envvar.length());
-        } else if(i < m_envvars.size() + 2) {
-            // Copy the envvars vector.
-            env[i] = new char[m_envvars[i - 2].length()];
-            std::memcpy(env[i], m_envvars[i - 2].c_str(), m_envvars[i - 2].length());
-        } else {
-            // Assign the env variables from outside.
-            env[i] = m_envp[i - m_envvars.size() - 2];
-        }
-        
+
+    // The limits are applied on every start, so they follow changes of the config.
+    m_cgroupProcs.clear();
+    if(m_cgroups && m_cgroups->isActive()) {
+        m_cgroupProcs = m_cgroups->prepareApp(m_name, m_limits);
     }
-    env[envpSize] = nullptr;
-    pid_t pid = fork();
-    if(pid == 0) {
-        // Child Process
+    m_launchPlan.setCgroup(m_cgroupProcs);
 
-        // Set the user ID to the specified user if it shouldn't be run as root.
-        if(!m_runAsRoot)
-			setuid(m_uid);
+    // The recording starts before the process exists, so its first opens are seen.
+    bool recording = false;
+    if(m_launchTracer && !m_prefetchTrace.empty()) {
+        std::string trace = m_prefetchTrace[0] == '/' ? m_prefetchTrace : m_path + "/" + m_prefetchTrace;
+        std::string version = getVersionStamp();
+        boost::system::error_code ec;
+        std::string recordedVersion = LaunchTracer::readVersion(trace);
+        if(!boost::filesystem::exists(trace, ec) || (!recordedVersion.empty() && recordedVersion != version)) {
+            m_launchTracer->begin(m_name, m_path, trace, version);
+            recording = true;
+        }
+    }
 
-        //setsid();
+    std::chrono::steady_clock::time_point launchBegin = std::chrono::steady_clock::now();
+    if(m_zygote && m_zygote->isRunning() && !m_zygoteLibrary.empty()) {
+        std::string library = m_zygoteLibrary[0] == '/' ? m_zygoteLibrary : m_path + "/" + m_zygoteLibrary;
+        // The main loop keeps running while the zygote forks.
+        m_starting = true;
+        bool automaticRestart = m_automaticRestart;
+        m_zygote->spawn(m_launchPlan, library, m_zygoteEntry, [this, recording, launchBegin, automaticRestart](pid_t pid, int error) {
+            m_starting = false;
+            // The restart timer already returned, so the start is marked as automatic again.
+            m_automaticRestart = automaticRestart;
+            if(pid > 0) {
+                // Forked by the zygote, so it can only be moved after it exists.
+                if(!m_cgroupProcs.empty())
+                    m_cgroups->attach(m_cgroupProcs, pid);
+                m_schedulingError = LaunchPlan::applyScheduling(pid, m_scheduling);
+                finishStart(pid, true, 0, recording, launchBegin);
+                m_automaticRestart = false;
+                return;
+            }
+            BOOST_LOG_SEV(m_log, L_WARN) << "Could not start app \"" << m_name << "\" from the zygote: " << strerror(error) << ". Starting it directly.";
+            pid = m_launchPlan.spawn(error);
+            m_schedulingError = m_launchPlan.getSchedulingError();
+            finishStart(pid, false, error, recording, launchBegin);
+            m_automaticRestart = false;
+        });
+        return;
+    }
 
-        // Set the working directory.
-        if(m_workingDir[0] != '/') {
-            // The working directory is relative.
-            boost::filesystem::current_path(m_path + "/" + m_workingDir);
-        } else {
-            // The working directory is absolute.
-            boost::filesystem::current_path(m_workingDir);
+    int error = 0;
+    pid_t pid = m_launchPlan.spawn(error);
+    m_schedulingError = m_launchPlan.getSchedulingError();
+    finishStart(pid, false, error, recording, launchBegin);
+}
+void App::finishStart(pid_t pid, bool zygote, int error, bool recording, std::chrono::steady_clock::time_point launchBegin)
+{
+    m_waitpid_counter = 0;
+    if(pid > 0) {
+        if(m_schedulingError != 0) {
+            BOOST_LOG_SEV(m_log, L_WARN) << "Not all scheduling settings of app \"" << m_name << "\" could be applied: " << strerror(m_schedulingError);
         }
 
+        std::chrono::nanoseconds time = std::chrono::steady_clock::now() - launchBegin;
+        LaunchStatistics &statistics = zygote ? m_zygoteLaunchStatistics : m_directLaunchStatistics;
+        ++statistics.launches;
+        statistics.time += time;
+        statistics.maxTime = std::max(statistics.maxTime, time);
+        BOOST_LOG_SEV(m_log, L_INFO) << "Started app \"" << m_name << "\" " << (zygote ? "from the zygote" : "directly")
+                                     << " in " << std::chrono::duration_cast<std::chrono::microseconds>(time).count() / 1000.0 << "ms.";
+
+        m_running = true;
+        m_frozen = false;
+        m_background = false;
+        m_resources.reset();
+        m_ready = !m_notify && !m_waitForSignal;
+        m_notifyStatus.clear();
+
+        m_pid = pid;
+        m_startTime = std::chrono::steady_clock::now();
+        if(recording) {
+            m_launchTracer->attach(m_name, pid, m_cgroupProcs, m_launchTraceDuration);
+        }
 
-        if(m_executable[0] == '.') {
-			execvpe((m_path + m_executable).c_str(), args, env);
+        if(m_reaper) {
+            m_reaper->watch(pid, std::bind(&App::handleWaitStatus, this, std::placeholders::_1));
+            if(!m_ready && m_readyTimeout > 0) {
+                // Apps waiting for this one must not wait forever for a lost READY=1.
+                if(!m_readyTimer) {
+                    m_readyTimer.reset(new boost::asio::steady_timer(*m_reaper->getIOService()));
+                }
+                m_readyTimer->expires_from_now(std::chrono::milliseconds(m_readyTimeout));
+                m_readyTimer->async_wait([this, pid](const boost::system::error_code &error) {
+                    if(error || !m_running || m_ready || m_pid != pid)
+                        return;
+                    BOOST_LOG_SEV(m_log, L_WARN) << "App \"" << m_name << "\" did not report its readiness within " << m_readyTimeout << "ms and is treated as ready.";
+                    setReady();
+                });
+            }
+        }
+        if(m_stateHandler) {
+            m_stateHandler(*this);
+        }
+        if(m_stopAfterStart) {
+            m_stopAfterStart = false;
+            stop();
+        }
+    } else {
+        BOOST_LOG_SEV(m_log, L_ERROR) << "Could not start app \"" << m_name << "\" with executable \"" << m_launchPlan.getExecutable() << "\": " << strerror(error);
+        if(recording)
+            m_launchTracer->cancel(m_name);
+        if(m_stopAfterStart) {
+            m_stopAfterStart = false;
+            // Reports the state as well.
+            finishStop();
         } else {
-			execvpe(m_executable.c_str(), args, env);
+            if(m_stateHandler)
+                m_stateHandler(*this);
+            // A failed restart counts like another crash. Without the reaper, the
+            // restart would be done right away and fail again.
+            if(m_automaticRestart && m_reaper)
+                scheduleRestart();
         }
+    }
+}
+void App::buildLaunchPlan()
+{
+    m_launchPlan.clear();
 
-        BOOST_LOG_SEV(m_log, L_ERROR) << "Error while trying to run \"" << m_executable << "\". : " << strerror(errno);
+    if(m_executable.empty())
+        return;
 
-        for(std::size_t i = 0; i < m_args.size(); ++i) {
-            delete[] args[i];
-        }
-        delete[] args;
+    if(m_executable[0] == '.') {
+        m_launchPlan.setExecutable(m_path + m_executable);
+    } else {
+        m_launchPlan.setExecutable(m_executable);
+    }
 
-        // Exit this process.
-        exit(-1);
+    m_launchPlan.addArgument(m_path + "/" + m_executable);
+    for(std::size_t i = 1; i < m_args.size(); ++i) {
+        m_launchPlan.addArgument(m_args[i]);
     }
-    else if(pid > 0) {
-        // Parent Process
-        m_running = true;
 
-        m_pid = pid;
-    } else if(pid < 0) {
-        BOOST_LOG_SEV(m_log, L_ERROR) << "Could not fork() for app \"" << m_name << "\".";
+    // The first entries are always set by the daemon, followed by the envvars of the app.
+    // The pidfile envvar should always be set.
+    m_launchPlan.addEnvironment(std::string("PIGA_DAEMON_PIDFILE_PATH=") + Daemon::getPidfilePath());
+    // The XDG_RUNTIME_DIR should be set.
+    if(m_runAsRoot)
+        m_launchPlan.addEnvironment("XDG_RUNTIME_DIR=/run/user/0");
+    else
+        m_launchPlan.addEnvironment("XDG_RUNTIME_DIR=/run/user/" + std::to_string(m_uid));
+    // Clients can ring the doorbell of the daemon after pushing events.
+    const char *doorbell = getenv(PIGA_DAEMON_DOORBELL_ENVVAR);
+    m_launchPlan.addEnvironment(std::string(PIGA_DAEMON_DOORBELL_ENVVAR "=") + (doorbell != nullptr ? doorbell : ""));
+    if(doorbell != nullptr) {
+        m_launchPlan.addInheritedFd(std::atoi(doorbell));
     }
-    // Delete the allocated memory for the exec call.
-    for(std::size_t i = 0; i < m_args.size(); ++i) {
-        delete[] args[i];
+    // Apps report their readiness and status over the notify socket.
+    const char *notify = getenv(PIGA_DAEMON_NOTIFY_ENVVAR);
+    m_launchPlan.addEnvironment(std::string(PIGA_DAEMON_NOTIFY_ENVVAR "=") + (notify != nullptr ? notify : ""));
+    if(notify != nullptr) {
+        m_launchPlan.addInheritedFd(std::atoi(notify));
     }
-    delete[] args;
-    for(std::size_t i = 0; i < m_envvars.size() + 2; ++i) {
-        delete[] env[i];
+    for(const std::string &envvar : m_envvars) {
+        m_launchPlan.addEnvironment(envvar);
     }
-    delete[] env;
-    m_waitpid_counter = 0;
+    // Assign the env variables from outside.
+    for(std::size_t i = 0; m_envp != nullptr && m_envp[i] != nullptr; ++i) {
+        m_launchPlan.addEnvironment(m_envp[i]);
+    }
+
+    // Set the working directory.
+    if(m_workingDir[0] != '/') {
+        // The working directory is relative.
+        m_launchPlan.setWorkingDirectory(m_path + "/" + m_workingDir);
+    } else {
+        // The working directory is absolute.
+        m_launchPlan.setWorkingDirectory(m_workingDir);
+    }
+
+    // Set the user ID to the specified user if it shouldn't be run as root.
+    if(!m_runAsRoot)
+        m_launchPlan.setUid(m_uid);
+
+    m_launchPlan.setScheduling(m_scheduling);
+
+    m_launchPlan.finalize();
+}
+void App::stop(StopHandler handler)
+{
+    cancelRestart();
+    if(m_starting) {
+        // Stopped as soon as the zygote reports the pid.
+        if(handler)
+            m_stopHandlers.push_back(handler);
+        m_stopAfterStart = true;
+        return;
+    }
+    if(!isRunning()) {
+        if(handler)
+            handler();
+        return;
+    }
+    if(handler)
+        m_stopHandlers.push_back(handler);
+    if(m_stopping)
+        return;
+
+    if(!m_reaper) {
+        // Without the reaper, the exit cannot be awaited asynchronously.
+        killNow();
+        finishStop();
+        return;
+    }
+
+    BOOST_LOG_SEV(m_log, L_INFO) << "Stopping app \"" << m_name << "\" with a grace period of " << m_stopTimeout << "ms.";
+    m_stopping = true;
+    if(m_frozen) {
+        // A frozen cgroup would only handle the SIGTERM after being thawed.
+        setFrozen(false);
+    }
+    kill(m_pid, SIGTERM);
+    // A stopped process would only handle the SIGTERM after being continued.
+    kill(m_pid, SIGCONT);
+
+    if(!m_stopTimer) {
+        m_stopTimer.reset(new boost::asio::steady_timer(*m_reaper->getIOService()));
+    }
+    m_stopTimer->expires_from_now(std::chrono::milliseconds(m_stopTimeout));
+    m_stopTimer->async_wait([this](const boost::system::error_code &error) {
+        if(error || !m_stopping)
+            return;
+        BOOST_LOG_SEV(m_log, L_WARN) << "App \"" << m_name << "\" did not exit within " << m_stopTimeout << "ms after SIGTERM and is killed.";
+        kill(m_pid, SIGKILL);
+    });
 }
-void App::stop()
+void App::killNow()
 {
+    if(m_reaper) {
+        // The exit is handled here and must not trigger a restart.
+        m_reaper->unwatch(m_pid);
+    }
+    if(m_frozen) {
+        setFrozen(false);
+    }
     kill(getPid(), SIGKILL);
     int status;
     waitpid(m_pid, &status, WUNTRACED | WCONTINUED);
@@ -294,6 +640,25 @@ void App::stop()
         BOOST_LOG_SEV(m_log, L_DEBUG) << "App \"" << m_name << "\" killed by signal \"" << WTERMSIG(status) << "\"";
     }
 }
+void App::finishStop()
+{
+    m_stopping = false;
+    if(m_stopTimer) {
+        boost::system::error_code ec;
+        m_stopTimer->cancel(ec);
+    }
+    // Apps waiting for this one learn that it will not become ready.
+    if(m_stateHandler) {
+        m_stateHandler(*this);
+    }
+
+    // Handlers may start the app again, which could add new handlers.
+    std::vector<StopHandler> handlers;
+    handlers.swap(m_stopHandlers);
+    for(auto &handler : handlers) {
+        handler();
+    }
+}
 bool App::isRunning() const
 {
     return m_running;
@@ -307,21 +672,12 @@ pid_t App::getPid() const
     return m_pid;
 }
 
-inline static void handle_exit_code_and_restart(App *app, int code)
-{
-	if(code == EXIT_SUCCESS) {
-		// This means a normal exit. Should it be restarted?
-		if(app->restartOnExit())
-            app->start();
-	} else {
-		// This means a crash. Should it be restarted?
-		if(app->restartOnCrash())
-            app->start();
-	}
-}
-
 void App::update()
 {
+    // With a reaper, exits are handled as soon as they happen.
+    if(m_reaper)
+        return;
+
     if(isInstalled() && isRunning()) {
         ++m_waitpid_counter;
 
@@ -345,6 +701,7 @@ void App::update()
             case -1:
                 // An error occured.
                 BOOST_LOG_SEV(m_log, L_ERROR) << "Waitpid on pid " << m_pid << " returned an error!";
+                status = ChildReaper::UnknownStatus;
                 break;
             default:
                 // This indicates success! Continue to the signal handling.
@@ -353,25 +710,131 @@ void App::update()
                 break;
         }
 
-        // Handle the result
-        if(WIFEXITED(status)) {
-            m_running = false;
-            BOOST_LOG_SEV(m_log, L_DEBUG) << "App \"" << m_name << "\" exited with status \"" << WEXITSTATUS(status) << "\"";
-
-            handle_exit_code_and_restart(this, WEXITSTATUS(status));
-        } else if(WIFSIGNALED(status)) {
-            m_running = false;
-            BOOST_LOG_SEV(m_log, L_DEBUG) << "App \"" << m_name << "\" killed by signal \"" << WTERMSIG(status) << "\"";
-
-            handle_exit_code_and_restart(this, WEXITSTATUS(status));
-        } else if(WIFSTOPPED(status)) {
-            m_stopped = true;
-            BOOST_LOG_SEV(m_log, L_DEBUG) << "App \"" << m_name << "\" stopped by signal \"" << WSTOPSIG(status) << "\"";
-        } else if(WIFCONTINUED(status)) {
-            m_stopped = false;
-            BOOST_LOG_SEV(m_log, L_DEBUG) << "App \"" << m_name << "\" continued.";
+        handleWaitStatus(status);
+    }
+}
+void App::handleWaitStatus(int status)
+{
+    if(status == ChildReaper::UnknownStatus) {
+        // The process is gone, but it is unknown how it ended.
+        m_running = false;
+        m_frozen = false;
+        if(m_stopping) {
+            BOOST_LOG_SEV(m_log, L_INFO) << "App \"" << m_name << "\" stopped.";
+            finishStop();
+            return;
         }
+        BOOST_LOG_SEV(m_log, L_WARN) << "App \"" << m_name << "\" is gone, but its exit status is unknown.";
+        if(m_stateHandler)
+            m_stateHandler(*this);
+        handleExit(true);
+        return;
+    }
+    if(m_stopping && (WIFEXITED(status) || WIFSIGNALED(status))) {
+        // The exit was requested, so it is neither a crash nor a reason to restart.
+        m_running = false;
+        m_frozen = false;
+        BOOST_LOG_SEV(m_log, L_INFO) << "App \"" << m_name << "\" stopped.";
+        finishStop();
+        return;
     }
+
+    // Handle the result
+    if(WIFEXITED(status)) {
+        m_running = false;
+        m_frozen = false;
+        BOOST_LOG_SEV(m_log, L_DEBUG) << "App \"" << m_name << "\" exited with status \"" << WEXITSTATUS(status) << "\"";
+
+        if(m_stateHandler)
+            m_stateHandler(*this);
+        handleExit(WEXITSTATUS(status) != EXIT_SUCCESS);
+    } else if(WIFSIGNALED(status)) {
+        m_running = false;
+        m_frozen = false;
+        BOOST_LOG_SEV(m_log, L_DEBUG) << "App \"" << m_name << "\" killed by signal \"" << WTERMSIG(status) << "\"";
+
+        if(m_stateHandler)
+            m_stateHandler(*this);
+        handleExit(true);
+    } else if(WIFSTOPPED(status)) {
+        m_stopped = true;
+        BOOST_LOG_SEV(m_log, L_DEBUG) << "App \"" << m_name << "\" stopped by signal \"" << WSTOPSIG(status) << "\"";
+    } else if(WIFCONTINUED(status)) {
+        m_stopped = false;
+        BOOST_LOG_SEV(m_log, L_DEBUG) << "App \"" << m_name << "\" continued.";
+    }
+}
+void App::handleExit(bool crashed)
+{
+    if(crashed ? !m_restartOnCrash : !m_restartOnExit)
+        return;
+    // Only exits in quick succession count as a crash loop.
+    if(std::chrono::steady_clock::now() - m_startTime >= std::chrono::milliseconds(m_restartPolicy.stableTime))
+        m_restartAttempts = 0;
+    scheduleRestart();
+}
+void App::scheduleRestart()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while(!m_restartTimes.empty() && now - m_restartTimes.front() > std::chrono::milliseconds(m_restartPolicy.window))
+        m_restartTimes.pop_front();
+    if(m_restartPolicy.maxRestarts > 0 && m_restartTimes.size() >= static_cast<std::size_t>(m_restartPolicy.maxRestarts)) {
+        m_restartTripped = true;
+        BOOST_LOG_SEV(m_log, L_ERROR) << "App \"" << m_name << "\" was restarted " << m_restartTimes.size() << " times within "
+                                      << m_restartPolicy.window << "ms and is not restarted anymore until it is started explicitly.";
+        return;
+    }
+    m_restartTimes.push_back(now);
+
+    std::uniform_real_distribution<double> random(0.0, 1.0);
+    double delay = m_restartPolicy.getDelay(m_restartAttempts, random(m_random));
+    ++m_restartAttempts;
+
+    if(!m_reaper) {
+        // Without the reaper there is no io_service to wait on, so the restart is done right away.
+        m_automaticRestart = true;
+        start();
+        m_automaticRestart = false;
+        return;
+    }
+
+    BOOST_LOG_SEV(m_log, L_INFO) << "App \"" << m_name << "\" is restarted in " << static_cast<int>(delay) << "ms (attempt " << m_restartAttempts << ").";
+    if(!m_restartTimer) {
+        m_restartTimer.reset(new boost::asio::steady_timer(*m_reaper->getIOService()));
+    }
+    m_restartPending = true;
+    m_restartDue = now + std::chrono::milliseconds(static_cast<int>(delay));
+    m_restartTimer->expires_at(m_restartDue);
+    m_restartTimer->async_wait([this](const boost::system::error_code &error) {
+        if(error || !m_restartPending)
+            return;
+        m_restartPending = false;
+        // A failed start schedules the next restart itself, also if the zygote answers later.
+        if(isRunning() || isStarting())
+            return;
+        m_automaticRestart = true;
+        start();
+        m_automaticRestart = false;
+    });
+}
+double App::RestartPolicy::getDelay(int attempts, double random) const
+{
+    double delay = initialDelay * std::pow(multiplier, attempts);
+    delay = std::min(delay, static_cast<double>(maxDelay));
+    // Apps failing because of the same cause should not restart in lockstep.
+    return delay * (1.0 - jitter + 2.0 * jitter * random);
+}
+void App::cancelRestart()
+{
+    m_restartPending = false;
+    if(m_restartTimer) {
+        boost::system::error_code ec;
+        m_restartTimer->cancel(ec);
+    }
+}
+bool App::isRestartTripped() const
+{
+    return m_restartTripped;
 }
 bool App::restartOnExit() const
 {
@@ -393,6 +856,10 @@ const std::string &App::getName() const
 {
     return m_name;
 }
+const App::LaunchStatistics &App::getLaunchStatistics(bool zygote) const
+{
+    return zygote ? m_zygoteLaunchStatistics : m_directLaunchStatistics;
+}
 const std::string &App::getWorkingDir() const
 {
     return m_workingDir;
@@ -405,5 +872,313 @@ bool App::isAutostart() const
 {
     return m_autostart;
 }
+void App::setStateHandler(StateHandler handler)
+{
+    m_stateHandler = handler;
+}
+bool App::isFreezable() const
+{
+    return m_freezable;
+}
+bool App::takesForeground() const
+{
+    return m_takesForeground;
+}
+bool App::isFrozen() const
+{
+    return m_frozen;
+}
+bool App::isStopping() const
+{
+    return m_stopping;
+}
+bool App::isStarting() const
+{
+    return m_starting;
+}
+bool App::isInBackground() const
+{
+    return m_background;
+}
+void App::moveToForeground()
+{
+    if(!isRunning() || !m_background)
+        return;
+    m_background = false;
+
+    if(m_frozen) {
+        setFrozen(false);
+    } else {
+        setNice(m_scheduling.setNice ? m_scheduling.nice : 0);
+        if(m_cgroups && !m_cgroupProcs.empty())
+            m_cgroups->setCpuWeight(m_cgroupProcs, 100);
+    }
+    BOOST_LOG_SEV(m_log, L_INFO) << "App \"" << m_name << "\" moved to the foreground.";
+}
+void App::moveToBackground(int nice, int cpuWeight)
+{
+    if(!isRunning() || m_background || m_stopping)
+        return;
+    m_background = true;
+
+    if(m_freezable) {
+        setFrozen(true);
+    } else {
+        setNice(nice);
+        if(m_cgroups && !m_cgroupProcs.empty())
+            m_cgroups->setCpuWeight(m_cgroupProcs, cpuWeight);
+    }
+    BOOST_LOG_SEV(m_log, L_INFO) << "App \"" << m_name << "\" moved to the background" << (m_frozen ? " and was frozen." : ".");
+}
+uint64_t App::getMemoryUsage() const
+{
+    if(!isRunning())
+        return 0;
+    if(m_cgroups && !m_cgroupProcs.empty()) {
+        int64_t usage = m_cgroups->getMemoryUsage(m_cgroupProcs);
+        if(usage >= 0)
+            return usage;
+    }
+    // The second value of statm is the resident set in pages.
+    std::ifstream statm("/proc/" + std::to_string(m_pid) + "/statm");
+    uint64_t size = 0, resident = 0;
+    if(!(statm >> size >> resident))
+        return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+int App::getMemoryPriority() const
+{
+    return m_memoryPriority;
+}
+void App::setFrozen(bool frozen)
+{
+    if(frozen == m_frozen)
+        return;
+
+    // The freezer of the cgroup also stops the children of the app and cannot be
+    // undone by the app itself. Without a cgroup, only the app process is stopped.
+    bool success;
+    if(m_cgroups && !m_cgroupProcs.empty()) {
+        success = m_cgroups->setFrozen(m_cgroupProcs, frozen);
+    } else {
+        success = kill(m_pid, frozen ? SIGSTOP : SIGCONT) == 0;
+    }
+    if(success) {
+        m_frozen = frozen;
+    } else {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not " << (frozen ? "freeze" : "thaw") << " app \"" << m_name << "\".";
+    }
+}
+void App::setNice(int nice)
+{
+    boost::system::error_code ec;
+    for(boost::filesystem::directory_iterator it("/proc/" + std::to_string(m_pid) + "/task", ec), end; !ec && it != end; it.increment(ec)) {
+        pid_t tid = std::atoi(it->path().filename().c_str());
+        if(tid > 0)
+            setpriority(PRIO_PROCESS, tid, nice);
+    }
+}
+App::Status App::getStatus() const
+{
+    Status status;
+    status["name"] = m_name;
+    status["running"] = m_running ? "true" : "false";
+    status["pid"] = std::to_string(m_running ? m_pid : 0);
+    status["background"] = m_background ? "true" : "false";
+    status["frozen"] = m_frozen ? "true" : "false";
+    status["ready"] = isReady() ? "true" : "false";
+    status["restart.state"] = m_restartTripped ? "tripped" : (m_restartPending ? "pending" : "idle");
+    status["restart.attempts"] = std::to_string(m_restartAttempts);
+    if(m_restartPending) {
+        std::chrono::milliseconds remaining = std::chrono::duration_cast<std::chrono::milliseconds>(m_restartDue - std::chrono::steady_clock::now());
+        status["restart.delay"] = std::to_string(std::max<int64_t>(remaining.count(), 0));
+    }
+    if(!m_notifyStatus.empty()) {
+        status["notify_status"] = m_notifyStatus;
+    }
+    if(!m_cgroupProcs.empty()) {
+        status["cgroup"] = m_cgroupProcs.substr(0, m_cgroupProcs.find_last_of('/'));
+    }
+
+    // The effective values, which may differ from the config if they could not be applied.
+    LaunchPlan::Scheduling scheduling;
+    if(m_running && LaunchPlan::readScheduling(m_pid, scheduling)) {
+        const char *policy = scheduling.policy >= 0 && scheduling.policy < 6 ? PolicyNames[scheduling.policy] : nullptr;
+        status["scheduling.policy"] = policy != nullptr ? policy : std::to_string(scheduling.policy);
+        status["scheduling.priority"] = std::to_string(scheduling.priority);
+        if(scheduling.setNice)
+            status["scheduling.nice"] = std::to_string(scheduling.nice);
+        if(scheduling.setIoprio && scheduling.ioprioClass >= 0 && scheduling.ioprioClass < 4)
+            status["scheduling.ioprio"] = std::string(IoprioClassNames[scheduling.ioprioClass]) + "/" + std::to_string(scheduling.ioprioLevel);
+        if(scheduling.setOomScoreAdj)
+            status["scheduling.oom_score_adj"] = std::to_string(scheduling.oomScoreAdj);
+        if(scheduling.setAffinity)
+            status["scheduling.affinity"] = LaunchPlan::formatCpuList(scheduling.affinity);
+    }
+    if(m_schedulingError != 0) {
+        status["scheduling.error"] = strerror(m_schedulingError);
+    }
+
+    if(m_running && m_resources.hasSamples()) {
+        const ResourceSample &sample = m_resources.getCurrent();
+        status["resources.cpu"] = std::to_string(sample.cpu);
+        status["resources.memory"] = std::to_string(sample.memory);
+        status["resources.read_rate"] = std::to_string(sample.readRate);
+        status["resources.write_rate"] = std::to_string(sample.writeRate);
+        status["resources.voluntary_switches"] = std::to_string(sample.voluntarySwitches);
+        status["resources.involuntary_switches"] = std::to_string(sample.involuntarySwitches);
+        status["resources.run_delay"] = std::to_string(sample.runDelay);
+    }
+    return status;
+}
+const std::vector<std::string> &App::getAfter() const
+{
+    return m_after;
+}
+const std::vector<std::string> &App::getRequires() const
+{
+    return m_requires;
+}
+bool App::isReady() const
+{
+    return m_running && m_ready;
+}
+void App::setReady()
+{
+    if(!m_running || m_ready)
+        return;
+    m_ready = true;
+    if(m_readyTimer) {
+        boost::system::error_code ec;
+        m_readyTimer->cancel(ec);
+    }
+    BOOST_LOG_SEV(m_log, L_INFO) << "App \"" << m_name << "\" is ready.";
+    if(m_stateHandler)
+        m_stateHandler(*this);
+}
+void App::handleNotification(const std::string &message)
+{
+    std::size_t begin = 0;
+    while(begin < message.size()) {
+        std::size_t end = message.find('\n', begin);
+        if(end == std::string::npos)
+            end = message.size();
+        std::string assignment = message.substr(begin, end - begin);
+        begin = end + 1;
+
+        if(assignment == "READY=1") {
+            setReady();
+        } else if(assignment.compare(0, 7, "STATUS=") == 0) {
+            m_notifyStatus = assignment.substr(7);
+            BOOST_LOG_SEV(m_appLog, L_INFO) << m_notifyStatus;
+        }
+    }
+}
+std::vector<App::ResourceSample> App::getResourceHistory() const
+{
+    if(!m_running)
+        return std::vector<ResourceSample>();
+    return m_resources.getHistory();
+}
+std::vector<Prefetcher::Range> App::getPrefetchRanges() const
+{
+    std::vector<Prefetcher::Range> ranges;
+    if(m_prefetch.empty() && getPrefetchTrace().empty())
+        return ranges;
+
+    std::vector<std::string> paths;
+    if(!m_launchPlan.getExecutable().empty())
+        paths.push_back(m_launchPlan.getExecutable());
+    if(!m_zygoteLibrary.empty())
+        paths.push_back(m_zygoteLibrary[0] == '/' ? m_zygoteLibrary : m_path + "/" + m_zygoteLibrary);
+    for(const std::string &path : m_prefetch) {
+        paths.push_back(!path.empty() && path[0] == '/' ? path : m_path + "/" + path);
+    }
+
+    for(std::string &path : paths) {
+        Prefetcher::Range range;
+        range.path = std::move(path);
+        ranges.push_back(std::move(range));
+    }
+    return ranges;
+}
+std::string App::getPrefetchTrace() const
+{
+    if(m_prefetchTrace.empty())
+        return m_prefetchTrace;
+    std::string trace = m_prefetchTrace[0] == '/' ? m_prefetchTrace : m_path + "/" + m_prefetchTrace;
+    boost::system::error_code ec;
+    if(!boost::filesystem::exists(trace, ec))
+        return std::string();
+    // A trace of another version would read the wrong files.
+    std::string version = LaunchTracer::readVersion(trace);
+    if(!version.empty() && version != getVersionStamp())
+        return std::string();
+    return trace;
+}
+void App::setCatalog(std::shared_ptr<AppCatalog> catalog)
+{
+    m_catalog = catalog;
+}
+template<class Archive>
+void App::serializeConfig(Archive &archive)
+{
+    archive & m_name & m_autostart & m_runAsRoot & m_waitForSignal & m_restartOnCrash & m_restartOnExit;
+    archive & m_stopTimeout & m_freezable & m_takesForeground & m_memoryPriority;
+    archive & m_notify & m_readyTimeout & m_after & m_requires & m_prefetch & m_prefetchTrace;
+    archive & m_executable & m_args & m_envvars & m_workingDir & m_uid & m_zygoteLibrary & m_zygoteEntry;
+
+    archive & m_scheduling.setPolicy & m_scheduling.policy & m_scheduling.priority;
+    archive & m_scheduling.setNice & m_scheduling.nice;
+    archive & m_scheduling.setIoprio & m_scheduling.ioprioClass & m_scheduling.ioprioLevel;
+    archive & m_scheduling.setOomScoreAdj & m_scheduling.oomScoreAdj;
+    archive & m_scheduling.setAffinity & boost::serialization::make_binary_object(&m_scheduling.affinity, sizeof(m_scheduling.affinity));
+
+    archive & m_limits.cpuMax & m_limits.cpuset & m_limits.memoryHigh & m_limits.memoryMax & m_limits.ioWeight;
+
+    archive & m_restartPolicy.initialDelay & m_restartPolicy.maxDelay & m_restartPolicy.multiplier & m_restartPolicy.jitter;
+    archive & m_restartPolicy.maxRestarts & m_restartPolicy.window & m_restartPolicy.stableTime;
+}
+void App::saveConfig(boost::archive::binary_oarchive &archive) const
+{
+    // Saving does not change anything, the archive only needs one function for both directions.
+    const_cast<App*>(this)->serializeConfig(archive);
+}
+void App::loadConfig(boost::archive::binary_iarchive &archive)
+{
+    serializeConfig(archive);
+}
+void App::setLaunchTracer(std::shared_ptr<LaunchTracer> tracer, std::chrono::milliseconds duration)
+{
+    m_launchTracer = tracer;
+    m_launchTraceDuration = duration;
+}
+std::string App::getVersionStamp() const
+{
+    std::string stamp;
+    std::vector<std::string> files = {m_launchPlan.getExecutable()};
+    if(!m_zygoteLibrary.empty())
+        files.push_back(m_zygoteLibrary[0] == '/' ? m_zygoteLibrary : m_path + "/" + m_zygoteLibrary);
+    for(const std::string &file : files) {
+        struct stat st;
+        if(file.empty() || stat(file.c_str(), &st) != 0)
+            continue;
+        if(!stamp.empty())
+            stamp += ",";
+        stamp += std::to_string(st.st_size) + "-" + std::to_string(st.st_mtime);
+    }
+    return stamp;
+}
+void App::sampleResources()
+{
+    // A frozen app does not change, its last sample stays valid.
+    if(!m_running || m_frozen)
+        return;
+    m_resources.sample(m_pid, m_cgroupProcs);
+}
+void App::setResourceHistoryLength(std::size_t length)
+{
+    m_resources.setCapacity(length);
+}
 }
 }
@@ -0,0 +1,213 @@
+#include <piga/daemon/AppCatalog.hpp>
+#include <piga/daemon/App.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/archive_exception.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+
+namespace piga
+{
+namespace daemon
+{
+namespace
+{
+/**
+ * @brief Reads from memory without copying it, used for the mapped cache file.
+ */
+class MemoryBuffer : public std::streambuf
+{
+public:
+    MemoryBuffer(const char *data, std::size_t size)
+    {
+        char *begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+};
+}
+
+AppCatalog::AppCatalog(const std::string &cacheFile)
+    : m_cacheFile(cacheFile),
+      m_log(bl::keywords::channel = "Class:AppCatalog")
+{
+
+}
+AppCatalog::~AppCatalog()
+{
+
+}
+bool AppCatalog::load(uid_t defaultUID)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_defaultUID = defaultUID;
+    m_entries.clear();
+    m_used.clear();
+    m_dirty = true;
+
+    int fd = open(m_cacheFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+    struct ::stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return false;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    bool valid = false;
+    try {
+        MemoryBuffer buffer(static_cast<const char*>(map), st.st_size);
+        std::istream stream(&buffer);
+        boost::archive::binary_iarchive archive(stream);
+
+        uint32_t formatVersion = 0;
+        uid_t defaultUIDOfCache = 0;
+        archive >> formatVersion >> defaultUIDOfCache;
+        if(formatVersion == FormatVersion && defaultUIDOfCache == defaultUID) {
+            archive >> m_entries;
+            valid = true;
+        }
+    }
+    catch(const std::exception &e) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not read the app catalog \"" << m_cacheFile << "\": " << e.what();
+        m_entries.clear();
+    }
+    munmap(map, st.st_size);
+
+    if(!valid) {
+        BOOST_LOG_SEV(m_log, L_INFO) << "The app catalog \"" << m_cacheFile << "\" is outdated, all apps are parsed again.";
+        return false;
+    }
+    m_dirty = false;
+    std::chrono::microseconds time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+    BOOST_LOG_SEV(m_log, L_INFO) << "Loaded " << m_entries.size() << " apps from the catalog in " << time.count() / 1000.0 << "ms.";
+    return true;
+}
+bool AppCatalog::save()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Removed apps are not restored anymore, so they are dropped from the cache.
+    for(auto it = m_entries.begin(); it != m_entries.end();) {
+        if(m_used.count(it->first) == 0) {
+            it = m_entries.erase(it);
+            m_dirty = true;
+        } else {
+            ++it;
+        }
+    }
+    if(!m_dirty)
+        return true;
+
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(boost::filesystem::path(m_cacheFile).parent_path(), ec);
+
+    std::string temporary = m_cacheFile + ".tmp";
+    try {
+        std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+        boost::archive::binary_oarchive archive(stream);
+        uint32_t formatVersion = FormatVersion;
+        archive << formatVersion << m_defaultUID << m_entries;
+        stream.flush();
+        if(!stream)
+            throw std::runtime_error("write failed");
+    }
+    catch(const std::exception &e) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not write the app catalog \"" << m_cacheFile << "\": " << e.what();
+        std::remove(temporary.c_str());
+        return false;
+    }
+    if(std::rename(temporary.c_str(), m_cacheFile.c_str()) != 0) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not replace the app catalog \"" << m_cacheFile << "\".";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    m_dirty = false;
+    return true;
+}
+bool AppCatalog::restore(App &app, const std::string &path)
+{
+    Entry current;
+    if(!stat(path, current))
+        return false;
+
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(path);
+        if(it == m_entries.end() || it->second.device != current.device || it->second.inode != current.inode
+           || it->second.size != current.size || it->second.mtime != current.mtime)
+            return false;
+        data = it->second.data;
+    }
+
+    try {
+        MemoryBuffer buffer(data.data(), data.size());
+        std::istream stream(&buffer);
+        boost::archive::binary_iarchive archive(stream);
+        app.loadConfig(archive);
+    }
+    catch(const std::exception &e) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not restore the app in \"" << path << "\" from the catalog: " << e.what();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_used.insert(path);
+    return true;
+}
+void AppCatalog::store(const App &app, const std::string &path)
+{
+    Entry entry;
+    if(!stat(path, entry))
+        return;
+
+    try {
+        std::ostringstream stream;
+        {
+            boost::archive::binary_oarchive archive(stream);
+            app.saveConfig(archive);
+        }
+        entry.data = stream.str();
+    }
+    catch(const std::exception &e) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not add the app in \"" << path << "\" to the catalog: " << e.what();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries[path] = std::move(entry);
+    m_used.insert(path);
+    m_dirty = true;
+}
+const std::string &AppCatalog::getCacheFile() const
+{
+    return m_cacheFile;
+}
+bool AppCatalog::stat(const std::string &path, Entry &entry)
+{
+    struct ::stat st;
+    if(::stat((path + "/app_config.cfg").c_str(), &st) != 0)
+        return false;
+    entry.device = st.st_dev;
+    entry.inode = st.st_ino;
+    entry.size = st.st_size;
+    entry.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+}
+}
@@ -1,13 +1,19 @@
 #include <piga/daemon/AppManager.hpp>
+#include <piga/daemon/WorkerPool.hpp>
 #include <boost/filesystem.hpp>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <boost/log/trivial.hpp>
 
 namespace piga
 {
 namespace daemon
 {
 
-AppManager::AppManager(const std::string &directory, uid_t defaultUID, char **envp)
-    : m_directory(directory), m_defaultUID(defaultUID), m_envp(envp)
+AppManager::AppManager(const std::string &directory, uid_t defaultUID, char **envp, std::shared_ptr<ChildReaper> reaper, std::shared_ptr<CgroupManager> cgroups)
+    : m_directory(directory), m_defaultUID(defaultUID), m_envp(envp), m_reaper(reaper), m_cgroups(cgroups),
+      m_log(bl::keywords::channel = "Class:AppManager")
 {
 
 }
@@ -16,18 +22,46 @@ AppManager::~AppManager()
 
 }
 void AppManager::reload(const std::string &directory)
+{
+    loadApps(directory);
+
+    processApps();
+}
+void AppManager::loadApps(const std::string &directory, WorkerPool *pool)
 {
     m_directory = directory;
 
     using namespace boost::filesystem;
-    directory_iterator it{path{directory}};
-
-    for (;
+    std::vector<std::string> paths;
+    for (directory_iterator it{path{directory}};
         it != directory_iterator{}; ++it) {
-        std::shared_ptr<App> app(new App(m_directory, m_defaultUID, m_envp));
+        paths.push_back(it->path().string());
+    }
+
+    if(m_catalog) {
+        m_catalog->load(m_defaultUID);
+    }
 
-        app->loadFromPath(it->path().string(), false);
+    // Parsing the configs is independent for every app.
+    std::vector<std::shared_ptr<App>> apps(paths.size());
+    auto loadApp = [&](std::size_t i) {
+        std::shared_ptr<App> app(new App(m_directory, m_defaultUID, m_envp, m_reaper, m_zygote, m_cgroups));
+        app->setStateHandler(std::bind(&AppManager::appStateChanged, this, std::placeholders::_1));
+        app->setResourceHistoryLength(m_resourceHistoryLength);
+        app->setLaunchTracer(m_launchTracer, m_launchTraceDuration);
+        app->setCatalog(m_catalog);
+        app->loadFromPath(paths[i], false);
+        apps[i] = app;
+    };
+    if(pool) {
+        pool->parallelFor(paths.size(), loadApp);
+    } else {
+        for(std::size_t i = 0; i < paths.size(); ++i) {
+            loadApp(i);
+        }
+    }
 
+    for(auto &app : apps) {
         if(app->isInstalled()) {
             // Only if the parsing was good enough, the app is installed. Then it can be added to the internal map.
 
@@ -40,35 +74,474 @@ void AppManager::reload(const std::string &directory)
         }
     }
 
-    // The internal map sorts the entries after their names. No additional sorting
-    // has to be done
-    processApps();
+    if(m_catalog) {
+        m_catalog->save();
+    }
+}
+void AppManager::startZygote(const std::vector<std::string> &preload)
+{
+    // Apps started by the zygote are orphans of it, the reaper has to collect them.
+    if(m_zygote || !m_reaper)
+        return;
+
+    std::shared_ptr<Zygote> zygote = std::make_shared<Zygote>(m_reaper->getIOService());
+    if(!zygote->start(preload))
+        return;
+    m_zygote = zygote;
+    m_reaper->setReapOrphans(true);
+}
+void AppManager::logLaunchStatistics()
+{
+    for(int zygote = 0; zygote < 2; ++zygote) {
+        App::LaunchStatistics total;
+        for(auto &app : m_apps) {
+            const App::LaunchStatistics &statistics = std::static_pointer_cast<App>(app.second)->getLaunchStatistics(zygote);
+            total.launches += statistics.launches;
+            total.time += statistics.time;
+            total.maxTime = std::max(total.maxTime, statistics.maxTime);
+        }
+        if(total.launches == 0)
+            continue;
+
+        BOOST_LOG_SEV(m_log, L_INFO) << (zygote ? "Zygote" : "Direct") << " launches: " << total.launches
+                                     << ", average " << std::chrono::duration_cast<std::chrono::microseconds>(total.time).count() / 1000.0 / total.launches << "ms"
+                                     << ", max " << std::chrono::duration_cast<std::chrono::microseconds>(total.maxTime).count() / 1000.0 << "ms.";
+    }
+}
+void AppManager::setForegroundScheduling(bool active, int backgroundNice, int backgroundCpuWeight)
+{
+    m_backgroundNice = backgroundNice;
+    m_backgroundCpuWeight = backgroundCpuWeight;
+    if(active == m_foregroundScheduling)
+        return;
+    m_foregroundScheduling = active;
+
+    if(active) {
+        applyForeground();
+    } else {
+        // Everything runs as configured again.
+        for(auto &app : m_apps) {
+            std::static_pointer_cast<App>(app.second)->moveToForeground();
+        }
+    }
+}
+void AppManager::setForegroundApp(const std::string &name)
+{
+    std::shared_ptr<App> app = std::static_pointer_cast<App>((*this)[name]);
+    if(!app || !app->isRunning()) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "The app \"" << name << "\" is not running and cannot be moved to the foreground.";
+        return;
+    }
+
+    m_foreground = name;
+    m_foregroundHistory.erase(std::remove(m_foregroundHistory.begin(), m_foregroundHistory.end(), name), m_foregroundHistory.end());
+    m_foregroundHistory.push_back(name);
+
+    if(m_foregroundScheduling) {
+        BOOST_LOG_SEV(m_log, L_INFO) << "The app \"" << name << "\" is now in the foreground.";
+        applyForeground();
+    }
+}
+const std::string &AppManager::getForegroundApp() const
+{
+    return m_foreground;
+}
+void AppManager::appStateChanged(App &app)
+{
+    bootStateChanged(app);
+
+    if(app.isRunning()) {
+        if(app.takesForeground()) {
+            setForegroundApp(app.getName());
+        } else if(m_foregroundScheduling && !m_foreground.empty()) {
+            app.moveToBackground(m_backgroundNice, m_backgroundCpuWeight);
+        }
+        return;
+    }
+
+    m_foregroundHistory.erase(std::remove(m_foregroundHistory.begin(), m_foregroundHistory.end(), app.getName()), m_foregroundHistory.end());
+    if(app.getName() != m_foreground)
+        return;
+
+    // The previous foreground app takes over, if it is still running.
+    m_foreground.clear();
+    while(!m_foregroundHistory.empty()) {
+        AppPtr previous = (*this)[m_foregroundHistory.back()];
+        if(previous && previous->isRunning()) {
+            setForegroundApp(previous->getName());
+            return;
+        }
+        m_foregroundHistory.pop_back();
+    }
+
+    // Without a foreground app, nothing is held back.
+    for(auto &entry : m_apps) {
+        std::static_pointer_cast<App>(entry.second)->moveToForeground();
+    }
+}
+void AppManager::applyForeground()
+{
+    if(m_foreground.empty())
+        return;
+
+    // The foreground app is thawed first, so it never waits for the others.
+    AppPtr foreground = (*this)[m_foreground];
+    if(foreground) {
+        std::static_pointer_cast<App>(foreground)->moveToForeground();
+    }
+    for(auto &entry : m_apps) {
+        if(entry.first != m_foreground && entry.second->isRunning()) {
+            std::static_pointer_cast<App>(entry.second)->moveToBackground(m_backgroundNice, m_backgroundCpuWeight);
+        }
+    }
+    enforceWarmCache();
+}
+void AppManager::setWarmCache(std::size_t maxApps, uint64_t memoryBudget)
+{
+    m_warmCacheSize = maxApps;
+    m_warmCacheMemory = memoryBudget;
+    enforceWarmCache();
+}
+void AppManager::switchToApp(const std::string &name)
+{
+    std::shared_ptr<App> app = std::static_pointer_cast<App>((*this)[name]);
+    if(!app) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Switch to the unknown app \"" << name << "\" was requested.";
+        return;
+    }
+
+    if(m_foregroundScheduling && app->isRunning() && app->isInBackground()) {
+        BOOST_LOG_SEV(m_log, L_INFO) << "Resuming app \"" << name << "\" from the warm cache.";
+        setForegroundApp(name);
+        return;
+    }
+
+    // Not cached, the app is started again once it exited.
+    app->stop([app]() {
+        app->reload();
+        app->start();
+    });
+}
+std::size_t AppManager::trimWarmCache(std::size_t maxApps)
+{
+    std::vector<std::shared_ptr<App>> warmApps = getWarmApps();
+    std::size_t evicted = 0;
+    for(std::size_t i = 0; i + maxApps < warmApps.size(); ++i) {
+        BOOST_LOG_SEV(m_log, L_INFO) << "Evicting app \"" << warmApps[i]->getName() << "\" from the warm cache.";
+        warmApps[i]->stop();
+        ++evicted;
+    }
+    return evicted;
+}
+std::vector<std::shared_ptr<App>> AppManager::getWarmApps()
+{
+    std::vector<std::shared_ptr<App>> warmApps;
+    for(auto &entry : m_apps) {
+        std::shared_ptr<App> app = std::static_pointer_cast<App>(entry.second);
+        if(app->isRunning() && app->isFrozen())
+            warmApps.push_back(app);
+    }
+
+    // Apps which were never in the foreground are the oldest, followed by the history.
+    auto recency = [this](const std::shared_ptr<App> &app) -> std::ptrdiff_t {
+        auto it = std::find(m_foregroundHistory.begin(), m_foregroundHistory.end(), app->getName());
+        return it == m_foregroundHistory.end() ? -1 : it - m_foregroundHistory.begin();
+    };
+    std::stable_sort(warmApps.begin(), warmApps.end(), [&](const std::shared_ptr<App> &a, const std::shared_ptr<App> &b) {
+        return recency(a) < recency(b);
+    });
+    return warmApps;
+}
+void AppManager::enforceWarmCache()
+{
+    if(!m_foregroundScheduling)
+        return;
+
+    std::vector<std::shared_ptr<App>> warmApps = getWarmApps();
+    std::size_t keep = m_warmCacheSize > 0 ? std::min(warmApps.size(), m_warmCacheSize) : warmApps.size();
+
+    // The most recently used apps are kept as long as they fit into the budget.
+    uint64_t memory = 0;
+    std::size_t fitting = 0;
+    for(std::size_t i = warmApps.size(); i > warmApps.size() - keep; --i) {
+        memory += warmApps[i - 1]->getMemoryUsage();
+        if(m_warmCacheMemory > 0 && memory > m_warmCacheMemory)
+            break;
+        ++fitting;
+    }
+    trimWarmCache(fitting);
+}
+bool AppManager::relieveMemoryPressure()
+{
+    // The cached apps are only kept for convenience, so they go first.
+    std::vector<std::shared_ptr<App>> warmApps = getWarmApps();
+    if(!warmApps.empty()) {
+        trimWarmCache(warmApps.size() - 1);
+        return true;
+    }
+
+    // Without a foreground app, there is nothing to make room for.
+    if(m_foreground.empty())
+        return false;
+
+    std::vector<std::shared_ptr<App>> backgroundApps = getBackgroundAppsByMemoryPriority();
+
+    // Frozen apps cannot allocate anymore, which often is enough for the foreground app.
+    for(auto &app : backgroundApps) {
+        if(!app->isFrozen() && !app->isStopping()) {
+            BOOST_LOG_SEV(m_log, L_WARN) << "Freezing app \"" << app->getName() << "\" because of memory pressure.";
+            app->setFrozen(true);
+            m_pressureFrozen.push_back(app->getName());
+            return true;
+        }
+    }
+    for(auto &app : backgroundApps) {
+        if(app->isStopping())
+            continue;
+        BOOST_LOG_SEV(m_log, L_WARN) << "Stopping app \"" << app->getName() << "\" because of memory pressure.";
+        app->stop();
+        return true;
+    }
+
+    BOOST_LOG_SEV(m_log, L_WARN) << "Memory pressure persists, but only the foreground app is left.";
+    return false;
+}
+void AppManager::memoryPressureEased()
+{
+    for(const std::string &name : m_pressureFrozen) {
+        std::shared_ptr<App> app = std::static_pointer_cast<App>((*this)[name]);
+        if(!app || !app->isRunning() || !app->isFrozen())
+            continue;
+        // Freezable apps in the background would be frozen anyway.
+        if(m_foregroundScheduling && app->isFreezable() && app->isInBackground())
+            continue;
+        BOOST_LOG_SEV(m_log, L_INFO) << "Thawing app \"" << name << "\" after the memory pressure eased.";
+        app->setFrozen(false);
+    }
+    m_pressureFrozen.clear();
+}
+void AppManager::sampleResources()
+{
+    for(auto &entry : m_apps) {
+        std::static_pointer_cast<App>(entry.second)->sampleResources();
+    }
+}
+void AppManager::setResourceHistoryLength(std::size_t length)
+{
+    if(length == m_resourceHistoryLength)
+        return;
+    m_resourceHistoryLength = length;
+    for(auto &entry : m_apps) {
+        std::static_pointer_cast<App>(entry.second)->setResourceHistoryLength(length);
+    }
+}
+void AppManager::setCatalog(std::shared_ptr<AppCatalog> catalog)
+{
+    m_catalog = catalog;
+    for(auto &entry : m_apps) {
+        std::static_pointer_cast<App>(entry.second)->setCatalog(catalog);
+    }
+}
+void AppManager::setLaunchTracer(std::shared_ptr<LaunchTracer> tracer, std::chrono::milliseconds duration)
+{
+    m_launchTracer = tracer;
+    m_launchTraceDuration = duration;
+    for(auto &entry : m_apps) {
+        std::static_pointer_cast<App>(entry.second)->setLaunchTracer(tracer, duration);
+    }
+}
+std::vector<std::shared_ptr<App>> AppManager::getBackgroundAppsByMemoryPriority()
+{
+    std::vector<std::shared_ptr<App>> apps;
+    for(auto &entry : m_apps) {
+        std::shared_ptr<App> app = std::static_pointer_cast<App>(entry.second);
+        if(app->isRunning() && entry.first != m_foreground)
+            apps.push_back(app);
+    }
+    std::stable_sort(apps.begin(), apps.end(), [](const std::shared_ptr<App> &a, const std::shared_ptr<App> &b) {
+        return a->getMemoryPriority() < b->getMemoryPriority();
+    });
+    return apps;
 }
 void AppManager::update()
 {
+    // Exits of the apps are reported by the reaper, there is nothing to poll.
+    if(m_reaper)
+        return;
+
     for(auto &app : m_apps) {
         app.second->update();
     }
 }
 void AppManager::processApps()
 {
-    AppMap::iterator app;
-    if(m_continueAfterWait) {
-        app = m_currentPos;
-        m_continueAfterWait = false;
+    m_bootPending.clear();
+    m_bootStarting.clear();
+    m_bootFailed.clear();
+
+    // Required apps are started as well, even if they are not autostarted.
+    std::vector<std::string> queue;
+    for(auto &entry : m_apps) {
+        if(entry.second->isAutostart())
+            queue.push_back(entry.first);
+    }
+    while(!queue.empty()) {
+        std::string name = queue.back();
+        queue.pop_back();
+        std::shared_ptr<App> app = std::static_pointer_cast<App>((*this)[name]);
+        if(!app || !m_bootPending.insert(name).second)
+            continue;
+        queue.insert(queue.end(), app->getRequires().begin(), app->getRequires().end());
+    }
+
+    // Apps which wait for their dependencies are read ahead meanwhile.
+    for(const std::string &name : m_bootPending) {
+        prefetchApp(name);
     }
-    else
-        app = m_apps.begin();
 
-    for(;app != m_apps.end(); ++app) {
-		app->second->executeAutostart();
+    BOOST_LOG_SEV(m_log, L_INFO) << "Starting " << m_bootPending.size() << " apps" << (m_autostartConcurrency > 0 ? ", at most " + std::to_string(m_autostartConcurrency) + " at a time." : ".");
+    m_booting = true;
+    m_bootBegin = std::chrono::steady_clock::now();
+    launchReadyApps();
+}
+void AppManager::setAutostartConcurrency(std::size_t limit)
+{
+    m_autostartConcurrency = limit;
+    if(m_booting)
+        launchReadyApps();
+}
+void AppManager::setPrefetcher(std::shared_ptr<Prefetcher> prefetcher)
+{
+    m_prefetcher = prefetcher;
+}
+void AppManager::prefetchApp(const std::string &name)
+{
+    std::shared_ptr<App> app = std::static_pointer_cast<App>((*this)[name]);
+    if(!m_prefetcher || !app || app->isRunning())
+        return;
+    m_prefetcher->prefetch(name, app->getPrefetchRanges(), app->getPrefetchTrace());
+}
+void AppManager::handleNotification(pid_t pid, const std::string &message)
+{
+    // Hints of menus are handled for every app, not only for the one which sent them.
+    std::size_t hint = 0;
+    while((hint = message.find("PREFETCH=", hint)) != std::string::npos) {
+        if(hint == 0 || message[hint - 1] == '\n') {
+            std::size_t end = message.find('\n', hint);
+            prefetchApp(message.substr(hint + 9, end == std::string::npos ? std::string::npos : end - hint - 9));
+        }
+        hint += 9;
+    }
 
-        if(app->second->shouldWaitForSignal()) {
-            m_continueAfterWait = true;
-            m_currentPos = ++app;
+    for(auto &entry : m_apps) {
+        if(entry.second->isRunning() && entry.second->getPid() == pid) {
+            std::static_pointer_cast<App>(entry.second)->handleNotification(message);
             return;
         }
     }
+    BOOST_LOG_SEV(m_log, L_DEBUG) << "Ignoring the notification of pid " << pid << ", which is not the main process of an app.";
+}
+void AppManager::readySignalReceived()
+{
+    for(auto &entry : m_apps) {
+        if(entry.second->isRunning() && entry.second->shouldWaitForSignal()) {
+            std::static_pointer_cast<App>(entry.second)->setReady();
+        }
+    }
+}
+AppManager::DependencyState AppManager::getDependencyState(const App &app) const
+{
+    DependencyState state = DependenciesReady;
+    for(const std::string &name : app.getRequires()) {
+        auto dependency = m_apps.find(name);
+        if(dependency == m_apps.end() || m_bootFailed.count(name) > 0)
+            return DependenciesFailed;
+        if(m_bootPending.count(name) > 0 || m_bootStarting.count(name) > 0)
+            state = DependenciesPending;
+        else if(!dependency->second->isRunning())
+            return DependenciesFailed;
+        else if(!std::static_pointer_cast<App>(dependency->second)->isReady())
+            state = DependenciesPending;
+    }
+    // Ordering only matters for apps which are started in the same run.
+    for(const std::string &name : app.getAfter()) {
+        if(m_bootPending.count(name) > 0 || m_bootStarting.count(name) > 0)
+            state = DependenciesPending;
+    }
+    return state;
+}
+void AppManager::launchReadyApps()
+{
+    if(m_launching)
+        return;
+    m_launching = true;
+
+    // Starting or failing an app can unblock apps which were already checked.
+    bool progress = true;
+    while(progress) {
+        progress = false;
+        for(auto it = m_bootPending.begin(); it != m_bootPending.end();) {
+            if(m_autostartConcurrency > 0 && m_bootStarting.size() >= m_autostartConcurrency)
+                break;
+
+            std::string name = *it;
+            std::shared_ptr<App> app = std::static_pointer_cast<App>((*this)[name]);
+            DependencyState state = getDependencyState(*app);
+            if(state == DependenciesPending) {
+                ++it;
+                continue;
+            }
+            it = m_bootPending.erase(it);
+            progress = true;
+
+            if(state == DependenciesFailed) {
+                BOOST_LOG_SEV(m_log, L_ERROR) << "App \"" << name << "\" is not started, because a required app is missing or could not be started.";
+                m_bootFailed.insert(name);
+                continue;
+            }
+            if(!app->isRunning() && !app->isStarting())
+                app->start();
+            if(!app->isRunning() && !app->isStarting()) {
+                m_bootFailed.insert(name);
+            } else if(!app->isReady()) {
+                m_bootStarting.insert(name);
+            }
+        }
+    }
+    m_launching = false;
+
+    if(!m_booting || !m_bootStarting.empty())
+        return;
+    if(!m_bootPending.empty()) {
+        // Nothing is starting anymore, so the remaining apps wait for each other.
+        std::string cycle;
+        for(const std::string &name : m_bootPending) {
+            cycle += (cycle.empty() ? "\"" : ", \"") + name + "\"";
+            m_bootFailed.insert(name);
+        }
+        BOOST_LOG_SEV(m_log, L_ERROR) << "The apps " << cycle << " depend on each other in a cycle and are not started.";
+        m_bootPending.clear();
+    }
+
+    m_booting = false;
+    std::chrono::microseconds time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_bootBegin);
+    BOOST_LOG_SEV(m_log, L_INFO) << "All apps were started in " << time.count() / 1000.0 << "ms, " << m_bootFailed.size() << " could not be started.";
+}
+void AppManager::bootStateChanged(App &app)
+{
+    if(!m_booting || m_bootStarting.count(app.getName()) == 0)
+        return;
+
+    if(app.isReady()) {
+        m_bootStarting.erase(app.getName());
+    } else if(!app.isRunning() && !app.isStarting()) {
+        BOOST_LOG_SEV(m_log, L_ERROR) << "App \"" << app.getName() << "\" exited before it was ready.";
+        m_bootStarting.erase(app.getName());
+        m_bootFailed.insert(app.getName());
+    } else {
+        return;
+    }
+    launchReadyApps();
 }
 AppManager::AppPtr AppManager::operator[](const std::string &name)
 {
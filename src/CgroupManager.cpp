@@ -0,0 +1,151 @@
+#include <piga/daemon/CgroupManager.hpp>
+#include <boost/log/trivial.hpp>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <fstream>
+#include <cctype>
+
+namespace piga
+{
+namespace daemon
+{
+namespace
+{
+const char *CgroupMount = "/sys/fs/cgroup";
+const char *Controllers = "+cpu +cpuset +memory +io";
+
+bool makeDirectory(const std::string &path)
+{
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+}
+
+CgroupManager::CgroupManager()
+    : m_log(bl::keywords::channel = "Class:CgroupManager")
+{
+
+}
+CgroupManager::~CgroupManager()
+{
+
+}
+bool CgroupManager::init(const std::string &daemonCpuset, const std::string &appsCpuset)
+{
+    // With cgroup v2, the only line is "0::/path/of/the/cgroup".
+    std::ifstream self("/proc/self/cgroup");
+    std::string line, path;
+    while(std::getline(self, line)) {
+        if(line.compare(0, 3, "0::") == 0) {
+            path = line.substr(3);
+            break;
+        }
+    }
+    if(path.empty() || access((std::string(CgroupMount) + "/cgroup.controllers").c_str(), F_OK) != 0) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "cgroup v2 is not available, apps are not isolated.";
+        return false;
+    }
+
+    std::string current = std::string(CgroupMount) + path;
+    // After a restart of the daemon, it is already inside of its own leaf.
+    const std::string daemonLeaf = "/daemon";
+    if(current.size() > daemonLeaf.size() && current.compare(current.size() - daemonLeaf.size(), daemonLeaf.size(), daemonLeaf) == 0) {
+        current.resize(current.size() - daemonLeaf.size());
+    }
+    m_root = current;
+
+    // Processes may only live in leaves, so the daemon moves into its own one first.
+    if(!makeDirectory(m_root + "/daemon") || !makeDirectory(m_root + "/apps")) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not create cgroups in \"" << m_root << "\" (" << strerror(errno) << "). Is the service delegated?";
+        return false;
+    }
+    if(!writeFile(m_root + "/daemon/cgroup.procs", std::to_string(getpid())))
+        return false;
+    if(!writeFile(m_root + "/cgroup.subtree_control", Controllers))
+        return false;
+    if(!writeFile(m_root + "/apps/cgroup.subtree_control", Controllers))
+        return false;
+
+    if(!daemonCpuset.empty())
+        writeFile(m_root + "/daemon/cpuset.cpus", daemonCpuset);
+    if(!appsCpuset.empty())
+        writeFile(m_root + "/apps/cpuset.cpus", appsCpuset);
+
+    m_active = true;
+    BOOST_LOG_SEV(m_log, L_INFO) << "Isolating apps in \"" << m_root << "/apps\"" << (daemonCpuset.empty() ? "." : ", the daemon runs on the CPUs " + daemonCpuset + ".");
+    return true;
+}
+bool CgroupManager::isActive() const
+{
+    return m_active;
+}
+std::string CgroupManager::prepareApp(const std::string &name, const CgroupManager::Limits &limits)
+{
+    if(!m_active)
+        return "";
+
+    // The name is chosen by the app config and has to be a single path component.
+    std::string leaf;
+    for(char c : name) {
+        leaf += (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.') ? c : '_';
+    }
+    if(leaf.empty() || leaf[0] == '.')
+        leaf = "_" + leaf;
+
+    std::string path = m_root + "/apps/" + leaf;
+    if(!makeDirectory(path)) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not create the cgroup \"" << path << "\": " << strerror(errno);
+        return "";
+    }
+
+    // Unset limits are reset, so removed config entries take effect on the next start.
+    writeFile(path + "/cpu.max", limits.cpuMax.empty() ? "max" : limits.cpuMax);
+    writeFile(path + "/memory.high", limits.memoryHigh.empty() ? "max" : limits.memoryHigh);
+    writeFile(path + "/memory.max", limits.memoryMax.empty() ? "max" : limits.memoryMax);
+    writeFile(path + "/cpuset.cpus", limits.cpuset);
+    writeFile(path + "/io.weight", "default " + std::to_string(limits.ioWeight > 0 ? limits.ioWeight : 100));
+
+    return path + "/cgroup.procs";
+}
+bool CgroupManager::attach(const std::string &procsPath, pid_t pid)
+{
+    return writeFile(procsPath, std::to_string(pid));
+}
+bool CgroupManager::setFrozen(const std::string &procsPath, bool frozen)
+{
+    return writeFile(getGroupPath(procsPath) + "/cgroup.freeze", frozen ? "1" : "0");
+}
+bool CgroupManager::setCpuWeight(const std::string &procsPath, int weight)
+{
+    return writeFile(getGroupPath(procsPath) + "/cpu.weight", std::to_string(weight));
+}
+int64_t CgroupManager::getMemoryUsage(const std::string &procsPath)
+{
+    std::ifstream file(getGroupPath(procsPath) + "/memory.current");
+    int64_t usage = -1;
+    if(!(file >> usage))
+        return -1;
+    return usage;
+}
+std::string CgroupManager::getGroupPath(const std::string &procsPath)
+{
+    return procsPath.substr(0, procsPath.find_last_of('/'));
+}
+bool CgroupManager::writeFile(const std::string &path, const std::string &value)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if(fd < 0) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not open \"" << path << "\": " << strerror(errno);
+        return false;
+    }
+    bool success = write(fd, value.c_str(), value.size()) == static_cast<ssize_t>(value.size());
+    if(!success) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not write \"" << value << "\" into \"" << path << "\": " << strerror(errno);
+    }
+    close(fd);
+    return success;
+}
+}
+}
@@ -0,0 +1,196 @@
+#include <piga/daemon/ChildReaper.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/log/trivial.hpp>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <cstring>
+#include <vector>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+namespace piga
+{
+namespace daemon
+{
+// Bound to a reference by std::chrono::milliseconds, so it needs a definition.
+const int ChildReaper::UnclaimedTimeout;
+
+ChildReaper::ChildReaper(std::shared_ptr<boost::asio::io_service> io_service)
+    : m_io_service(io_service),
+      m_log(bl::keywords::channel = "Class:ChildReaper")
+{
+    // Probe for pidfd_open with our own pid, which always exists.
+    int fd = syscall(SYS_pidfd_open, getpid(), 0);
+    if(fd < 0) {
+        m_pidfdSupported = false;
+        BOOST_LOG_SEV(m_log, L_INFO) << "pidfd_open is not available (" << strerror(errno) << "), watching children with SIGCHLD.";
+
+        m_signals.reset(new boost::asio::signal_set(*m_io_service, SIGCHLD));
+        asyncWaitSignal();
+    } else {
+        close(fd);
+    }
+}
+ChildReaper::~ChildReaper()
+{
+    if(m_signals) {
+        boost::system::error_code ec;
+        m_signals->cancel(ec);
+    }
+    for(auto &child : m_children) {
+        if(child.second.pidfd) {
+            boost::system::error_code ec;
+            child.second.pidfd->close(ec);
+        }
+    }
+}
+void ChildReaper::watch(pid_t pid, ChildReaper::Handler handler)
+{
+    Child &child = m_children[pid];
+    child.handler = handler;
+
+    auto unclaimed = m_unclaimed.find(pid);
+    if(unclaimed != m_unclaimed.end()) {
+        int status = unclaimed->second.status;
+        m_unclaimed.erase(unclaimed);
+        // If a process with the pid exists, the pid was reused and the status is outdated.
+        if(kill(pid, 0) != 0 && errno == ESRCH) {
+            m_io_service->post([this, pid, status]() {
+                if(m_children.count(pid) > 0)
+                    dispatch(pid, status);
+            });
+            return;
+        }
+    }
+
+    if(m_pidfdSupported) {
+        int fd = syscall(SYS_pidfd_open, pid, 0);
+        if(fd >= 0) {
+            // The pidfd is only used for readiness, it is closed together with the descriptor.
+            child.pidfd.reset(new boost::asio::posix::stream_descriptor(*m_io_service, fd));
+            asyncWaitPidfd(pid);
+            return;
+        }
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not open a pidfd for the child " << pid << ": " << strerror(errno);
+    }
+
+    // The child could have exited before it was watched, SIGCHLD is not raised again.
+    m_io_service->post([this, pid]() {
+        if(m_children.count(pid) > 0)
+            reap(pid);
+    });
+}
+void ChildReaper::unwatch(pid_t pid)
+{
+    auto child = m_children.find(pid);
+    if(child == m_children.end())
+        return;
+
+    if(child->second.pidfd) {
+        boost::system::error_code ec;
+        child->second.pidfd->close(ec);
+    }
+    m_children.erase(child);
+}
+bool ChildReaper::usesPidfd() const
+{
+    return m_pidfdSupported;
+}
+void ChildReaper::setReapOrphans(bool reapOrphans)
+{
+    m_reapOrphans = reapOrphans;
+    if(m_reapOrphans && !m_signals) {
+        m_signals.reset(new boost::asio::signal_set(*m_io_service, SIGCHLD));
+        asyncWaitSignal();
+    }
+}
+std::shared_ptr<boost::asio::io_service> ChildReaper::getIOService()
+{
+    return m_io_service;
+}
+void ChildReaper::asyncWaitPidfd(pid_t pid)
+{
+    m_children[pid].pidfd->async_read_some(boost::asio::null_buffers(),
+        [this, pid](const boost::system::error_code &error, std::size_t) {
+            if(error)
+                return;
+            if(!reap(pid)) {
+                // Readable without a zombie to reap, wait for the real exit.
+                if(m_children.count(pid) > 0)
+                    asyncWaitPidfd(pid);
+            }
+        });
+}
+void ChildReaper::asyncWaitSignal()
+{
+    m_signals->async_wait([this](const boost::system::error_code &error, int) {
+        if(error)
+            return;
+
+        if(m_reapOrphans) {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            for(auto it = m_unclaimed.begin(); it != m_unclaimed.end();) {
+                if(now - it->second.time > std::chrono::milliseconds(UnclaimedTimeout))
+                    it = m_unclaimed.erase(it);
+                else
+                    ++it;
+            }
+
+            int status = 0;
+            pid_t pid;
+            while((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                if(m_children.count(pid) > 0) {
+                    dispatch(pid, status);
+                } else {
+                    // Either an orphan or a zygote app whose pid did not arrive yet.
+                    BOOST_LOG_SEV(m_log, L_DEBUG) << "Reaped the process " << pid << ", which is not watched.";
+                    m_unclaimed[pid] = Unclaimed{status, now};
+                }
+            }
+            asyncWaitSignal();
+            return;
+        }
+
+        // Signals are merged, so every child without a pidfd has to be checked.
+        std::vector<pid_t> pids;
+        for(auto &child : m_children) {
+            if(!child.second.pidfd)
+                pids.push_back(child.first);
+        }
+        for(pid_t pid : pids) {
+            if(m_children.count(pid) > 0)
+                reap(pid);
+        }
+        asyncWaitSignal();
+    });
+}
+bool ChildReaper::reap(pid_t pid)
+{
+    int status = 0;
+    pid_t result = waitpid(pid, &status, WNOHANG);
+    if(result == 0)
+        return false;
+    if(result < 0) {
+        BOOST_LOG_SEV(m_log, L_ERROR) << "Waitpid on pid " << pid << " returned an error: " << strerror(errno);
+        status = UnknownStatus;
+    }
+
+    dispatch(pid, status);
+    return true;
+}
+void ChildReaper::dispatch(pid_t pid, int status)
+{
+    // The entry is removed before the handler runs, it may watch a new child (restarts).
+    Handler handler = m_children[pid].handler;
+    unwatch(pid);
+
+    if(handler)
+        handler(status);
+}
+}
+}
@@ -2,7 +2,11 @@
 #include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <functional>
+#include <algorithm>
+#include <vector>
+#include <chrono>
 #include <fstream>
+#include <cstring>
 
 #include <libconfig.h++>
 #include <iostream>
@@ -15,6 +19,8 @@
 #include <piga/devkit/Devkit.hpp>
 #include <piga/daemon/DBusManager.hpp>
 #include <piga/daemon/PluginManager.hpp>
+#include <piga/daemon/Host.hpp>
+#include <piga/daemon/WorkerPool.hpp>
 
 
 using std::endl;
@@ -70,6 +76,10 @@ Daemon::Daemon(char **envp)
 Daemon::~Daemon()
 {
     BOOST_LOG_SEV(m_log, L_INFO) << "Shutting down pigadaemon.";
+    // The hosts are destroyed with the loader and must not be polled anymore.
+    if(m_inputThread) {
+        m_inputThread->stop();
+    }
     // Remove the pidfile.
     std::remove(PIGA_DAEMON_PIDFILE_PATH);
     bool removed = !std::ifstream(PIGA_DAEMON_PIDFILE_PATH);
@@ -88,8 +98,56 @@ Daemon::~Daemon()
 
 void Daemon::run()
 {
+    std::chrono::steady_clock::time_point startupBegin = std::chrono::steady_clock::now();
+
     reload();
 
+    // The doorbell wakes up the main loop whenever hosts or clients have something to process.
+    // It is created before the stages, because setting the envvar is not thread safe.
+    m_doorbell = std::make_shared<Doorbell>(m_io_service);
+    if(m_doorbell->isValid()) {
+        setenv(PIGA_DAEMON_DOORBELL_ENVVAR, std::to_string(m_doorbell->getFd()).c_str(), 1);
+    }
+    // Apps report their readiness over the notify socket.
+    m_notifySocket = std::make_shared<NotifySocket>(m_io_service);
+    if(m_notifySocket->isValid()) {
+        setenv(PIGA_DAEMON_NOTIFY_ENVVAR, std::to_string(m_notifySocket->getClientFd()).c_str(), 1);
+    }
+
+    // If memory runs out anyway, the OOM killer should pick an app and not the daemon.
+    // Started apps (and the zygote) get back the value the daemon was started with.
+    LaunchPlan::Scheduling current;
+    if(LaunchPlan::readScheduling(getpid(), current) && current.setOomScoreAdj) {
+        LaunchPlan::setDefaultOomScoreAdj(current.oomScoreAdj);
+    }
+    LaunchPlan::Scheduling oomProtection;
+    oomProtection.setOomScoreAdj = true;
+    oomProtection.oomScoreAdj = m_oomScoreAdj;
+    int oomError = LaunchPlan::applyScheduling(0, oomProtection);
+    if(oomError != 0) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not set the oom_score_adj of the daemon to " << m_oomScoreAdj << ": " << strerror(oomError);
+    }
+
+    // Exits of started apps are delivered into the main loop.
+    m_childReaper = std::make_shared<ChildReaper>(m_io_service);
+
+    // The daemon moves itself with all its threads into its own cgroup before the
+    // stages start, so the apps subtree exists before the first app is started.
+    if(m_cgroupsActive) {
+        std::shared_ptr<CgroupManager> cgroupManager = std::make_shared<CgroupManager>();
+        if(cgroupManager->init(m_daemonCpuset, m_appsCpuset)) {
+            m_cgroupManager = cgroupManager;
+        }
+    }
+
+    if(m_prefetchActive) {
+        m_prefetcher = std::make_shared<Prefetcher>();
+        m_prefetcher->start();
+        Prefetcher::Range hosts;
+        hosts.path = m_soPath;
+        m_prefetcher->prefetch("Hosts", {hosts});
+    }
+
     piga_host_config *cfg = piga_host_config_default();
     piga_host_config_set_name(cfg, m_name.c_str());
     m_host = std::shared_ptr<piga_host>(piga_host_create(), piga_host_free);
@@ -97,24 +155,106 @@ void Daemon::run()
     m_cacheEvent = std::shared_ptr<piga_event>(piga_event_create(), piga_event_free);
 
     piga_host_consume_config(m_host.get(), cfg);
-    piga_status status = piga_host_startup(m_host.get());
 
+    // Starting the host, the host libraries and DBus is not thread safe, it is done on this thread.
+    piga_status status = piga_host_startup(m_host.get());
     if(status != PIGA_STATUS_OK) {
         BOOST_LOG_SEV(m_log, L_ERROR) << "Could not start piga_host: " << piga_status_what_copy(status);
         return;
     }
-    
     m_dbusManager->init();
 
+    // Hosts and the daemon tick share one timer.
+    m_scheduler = std::make_shared<Scheduler>(m_io_service);
+
+    // With the input thread, hosts and everything touching m_host run on its io_service.
+    std::shared_ptr<as::io_service> inputIOService = m_io_service;
+    std::shared_ptr<Scheduler> inputScheduler = m_scheduler;
+    if(m_inputThreadActive) {
+        m_inputThread = std::make_shared<InputThread>(m_inputThreadCpu, m_inputThreadPriority);
+        inputIOService = m_inputThread->getIOService();
+        inputScheduler = m_inputThread->getScheduler();
+    }
+
+    m_inputAccumulator = std::make_shared<InputAccumulator>(inputIOService,
+                                                            m_host,
+                                                            piga_host_config_get_player_count(cfg),
+                                                            m_inputCoalescing);
+    m_inputAccumulator->setDoorbell(m_doorbell);
+    Host::setInputAccumulator(m_inputAccumulator);
+
     m_loader = std::unique_ptr<Loader>(new Loader(m_soPath,
                                                   piga_host_config_get_player_count(cfg),
-                                                  m_io_service,
+                                                  inputIOService,
+                                                  inputScheduler,
                                                   m_host));
 
-    m_loader->reload();
+    // Loading the hosts and the apps is independent, both stages run concurrently.
+    // Inside of them, host libraries and app configs are also loaded in parallel on the same pool.
+    std::unique_ptr<WorkerPool> pool(new WorkerPool(m_startupThreads > 0 ? m_startupThreads : 0));
+    std::vector<std::pair<std::string, std::function<void()>>> stages;
+
+    stages.emplace_back("Hosts", [&]() {
+        m_loader->reload(pool.get());
+        m_loader->setWatching(m_watchSoPath);
+    });
+    stages.emplace_back("Apps", [&]() {
+        m_appManager = std::make_shared<AppManager>(m_defaultAppPath, m_defaultUID, m_envp, m_childReaper, m_cgroupManager);
+        m_appManager->setForegroundScheduling(m_foregroundScheduling, m_backgroundNice, m_backgroundCpuWeight);
+        m_appManager->setWarmCache(std::max(m_warmCacheSize, 0), static_cast<uint64_t>(std::max(m_warmCacheMemory, 0)) * 1024 * 1024);
+        m_appManager->setAutostartConcurrency(std::max(m_autostartConcurrency, 0));
+        m_appManager->setPrefetcher(m_prefetcher);
+        if(!m_appCatalogFile.empty()) {
+            m_appManager->setCatalog(std::make_shared<AppCatalog>(m_appCatalogFile));
+        }
+        m_launchTracer = std::make_shared<LaunchTracer>(m_io_service);
+        updateLaunchTracing();
+        if(m_zygoteActive) {
+            m_appManager->startZygote(m_zygotePreload);
+        }
+        m_appManager->loadApps(m_defaultAppPath, pool.get());
+    });
 
-    m_appManager = std::make_shared<AppManager>(m_defaultAppPath, m_defaultUID, m_envp);
-    m_appManager->reload(m_defaultAppPath);
+    std::vector<std::chrono::microseconds> stageTimes(stages.size());
+    try {
+        pool->parallelFor(stages.size(), [&](std::size_t i) {
+            std::chrono::steady_clock::time_point stageBegin = std::chrono::steady_clock::now();
+            stages[i].second();
+            stageTimes[i] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - stageBegin);
+        });
+    }
+    catch(std::exception &e) {
+        // Without the loader or the app manager, the daemon cannot run.
+        BOOST_LOG_SEV(m_log, L_ERROR) << "The startup of the daemon failed: " << e.what();
+        return;
+    }
+    pool.reset();
+
+    for(std::size_t i = 0; i < stages.size(); ++i) {
+        BOOST_LOG_SEV(m_log, L_INFO) << "Startup stage \"" << stages[i].first << "\" took " << stageTimes[i].count() / 1000.0 << "ms.";
+    }
+
+    if(m_inputThread) {
+        m_inputThread->getScheduler()->add("piga_host_update", std::chrono::milliseconds(m_pollInterval), [this]() {
+            piga_host_update(m_host.get());
+        });
+        m_inputThread->start();
+    }
+
+    // Memory is freed for the foreground app step by step while the pressure lasts.
+    if(m_memoryPressureActive) {
+        m_memoryPressureMonitor.reset(new MemoryPressureMonitor(m_io_service));
+        m_memoryPressureMonitor->start(m_memoryPressureStall, m_memoryPressureWindow,
+            [this]() { m_appManager->relieveMemoryPressure(); },
+            [this]() { m_appManager->memoryPressureEased(); });
+    }
+
+    if(m_notifySocket->isValid()) {
+        m_notifySocket->asyncReceive([this](pid_t pid, const std::string &message) {
+            m_appManager->handleNotification(pid, message);
+        });
+    }
+    m_appManager->processApps();
     
     m_pluginManager->setAppManager(m_appManager);
 
@@ -127,9 +267,17 @@ void Daemon::run()
     piga_client_consume_config(m_client.get(), client_cfg);
     piga_client_connect(m_client.get(), "Pigadaemon-Internal-Client", sizeof("Pigadaemon-Internal-Client"));
 
-    m_hostTimer = std::make_shared<as::deadline_timer>(*m_io_service, boost::posix_time::milliseconds(1));
+    m_scheduler->add("Daemon", std::chrono::milliseconds(m_pollInterval),
+                     std::bind(&Daemon::update, this));
 
-    m_hostTimer->async_wait(std::bind(&Daemon::update, this));
+    m_doorbell->asyncWait(std::bind(&Daemon::doorbellRung, this));
+
+    updateResourceSampling();
+
+    update();
+
+    std::chrono::microseconds startupTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startupBegin);
+    BOOST_LOG_SEV(m_log, L_INFO) << "Started the pigadaemon in " << startupTime.count() / 1000.0 << "ms.";
     
     m_io_service->run();
 }
@@ -174,6 +322,9 @@ void Daemon::reload()
                 L_WARNHappened = true;
             } else {
                 root["piga"].lookupValue("name", m_name);
+                root["piga"].lookupValue("startup_threads", m_startupThreads);
+                root["piga"].lookupValue("oom_score_adj", m_oomScoreAdj);
+                root["piga"].lookupValue("prefetch", m_prefetchActive);
             }
 
             if(!root.exists("hosts")) {
@@ -182,6 +333,28 @@ void Daemon::reload()
                 L_WARNHappened = true;
             } else {
                 root["hosts"].lookupValue("so_path", m_soPath);
+                bool inputThreadActive = m_inputThreadActive;
+                int inputThreadCpu = m_inputThreadCpu;
+                int inputThreadPriority = m_inputThreadPriority;
+                root["hosts"].lookupValue("input_thread", inputThreadActive);
+                root["hosts"].lookupValue("input_thread_cpu", inputThreadCpu);
+                root["hosts"].lookupValue("input_thread_priority", inputThreadPriority);
+                if(!m_loader) {
+                    m_inputThreadActive = inputThreadActive;
+                    m_inputThreadCpu = inputThreadCpu;
+                    m_inputThreadPriority = inputThreadPriority;
+                } else if(inputThreadActive != m_inputThreadActive || inputThreadCpu != m_inputThreadCpu
+                          || inputThreadPriority != m_inputThreadPriority) {
+                    BOOST_LOG_SEV(m_log, L_WARN) << "Changes of \"input_thread\", \"input_thread_cpu\" and \"input_thread_priority\" are applied when the daemon is restarted.";
+                }
+                root["hosts"].lookupValue("watch_so_path", m_watchSoPath);
+
+                std::string inputCoalescing;
+                if(root["hosts"].lookupValue("input_coalescing", inputCoalescing)
+                        && !InputAccumulator::getPolicyFromStr(inputCoalescing, m_inputCoalescing)) {
+                    BOOST_LOG_SEV(m_log, L_WARN) << "Unknown input_coalescing \"" << inputCoalescing << "\", using \""
+                                                 << InputAccumulator::getStrFromPolicy(m_inputCoalescing) << "\".";
+                }
             }
             
             if(!root.exists("devkit")) {
@@ -228,6 +401,35 @@ void Daemon::reload()
             } else {
                 root["apps"].lookupValue("default_uid", m_defaultUID);
                 root["apps"].lookupValue("app_path", m_defaultAppPath);
+                root["apps"].lookupValue("catalog_cache", m_appCatalogFile);
+                root["apps"].lookupValue("zygote", m_zygoteActive);
+                root["apps"].lookupValue("foreground_scheduling", m_foregroundScheduling);
+                root["apps"].lookupValue("background_nice", m_backgroundNice);
+                root["apps"].lookupValue("background_cpu_weight", m_backgroundCpuWeight);
+                root["apps"].lookupValue("autostart_concurrency", m_autostartConcurrency);
+                root["apps"].lookupValue("warm_cache_size", m_warmCacheSize);
+                root["apps"].lookupValue("warm_cache_memory", m_warmCacheMemory);
+                root["apps"].lookupValue("resource_sampling_interval", m_resourceSamplingInterval);
+                root["apps"].lookupValue("resource_history", m_resourceHistoryLength);
+                root["apps"].lookupValue("prefetch_record", m_prefetchRecord);
+                root["apps"].lookupValue("prefetch_record_time", m_prefetchRecordTime);
+                root["apps"].lookupValue("memory_pressure", m_memoryPressureActive);
+                root["apps"].lookupValue("memory_pressure_stall", m_memoryPressureStall);
+                root["apps"].lookupValue("memory_pressure_window", m_memoryPressureWindow);
+                if(root["apps"].exists("zygote_preload")) {
+                    Setting &preload = root["apps"]["zygote_preload"];
+                    m_zygotePreload.clear();
+                    for(int i = 0; i < preload.getLength(); ++i) {
+                        m_zygotePreload.push_back(preload[i].c_str());
+                    }
+                }
+            }
+
+            // Optional, cgroups are only used when the service is delegated.
+            if(root.exists("cgroups")) {
+                root["cgroups"].lookupValue("active", m_cgroupsActive);
+                root["cgroups"].lookupValue("daemon_cpuset", m_daemonCpuset);
+                root["cgroups"].lookupValue("apps_cpuset", m_appsCpuset);
             }
         }
         catch(std::exception &e) {
@@ -244,6 +446,9 @@ void Daemon::reload()
         {
             Setting &piga = root["piga"];
             piga.add("name", Setting::TypeString) = m_name;
+            piga.add("startup_threads", Setting::TypeInt) = static_cast<int>(m_startupThreads);
+            piga.add("oom_score_adj", Setting::TypeInt) = m_oomScoreAdj;
+            piga.add("prefetch", Setting::TypeBoolean) = m_prefetchActive;
         }
         root.add("devkit", Setting::TypeGroup);
         {
@@ -255,12 +460,43 @@ void Daemon::reload()
         {
             Setting &hosts = root["hosts"];
             hosts.add("so_path", Setting::TypeString) = m_soPath;
+            hosts.add("watch_so_path", Setting::TypeBoolean) = m_watchSoPath;
+            hosts.add("input_thread", Setting::TypeBoolean) = m_inputThreadActive;
+            hosts.add("input_thread_cpu", Setting::TypeInt) = m_inputThreadCpu;
+            hosts.add("input_thread_priority", Setting::TypeInt) = m_inputThreadPriority;
+            hosts.add("input_coalescing", Setting::TypeString) = InputAccumulator::getStrFromPolicy(m_inputCoalescing);
         }
         root.add("apps", Setting::TypeGroup);
         {
             Setting &apps = root["apps"];
             apps.add("default_uid", Setting::TypeInt) = static_cast<int>(m_defaultUID);
             apps.add("app_path", Setting::TypeString) = m_defaultAppPath;
+            apps.add("catalog_cache", Setting::TypeString) = m_appCatalogFile;
+            apps.add("zygote", Setting::TypeBoolean) = m_zygoteActive;
+            apps.add("foreground_scheduling", Setting::TypeBoolean) = m_foregroundScheduling;
+            apps.add("background_nice", Setting::TypeInt) = m_backgroundNice;
+            apps.add("background_cpu_weight", Setting::TypeInt) = m_backgroundCpuWeight;
+            apps.add("autostart_concurrency", Setting::TypeInt) = m_autostartConcurrency;
+            apps.add("warm_cache_size", Setting::TypeInt) = m_warmCacheSize;
+            apps.add("warm_cache_memory", Setting::TypeInt) = m_warmCacheMemory;
+            apps.add("resource_sampling_interval", Setting::TypeInt) = m_resourceSamplingInterval;
+            apps.add("resource_history", Setting::TypeInt) = m_resourceHistoryLength;
+            apps.add("prefetch_record", Setting::TypeBoolean) = m_prefetchRecord;
+            apps.add("prefetch_record_time", Setting::TypeInt) = m_prefetchRecordTime;
+            apps.add("memory_pressure", Setting::TypeBoolean) = m_memoryPressureActive;
+            apps.add("memory_pressure_stall", Setting::TypeInt) = m_memoryPressureStall;
+            apps.add("memory_pressure_window", Setting::TypeInt) = m_memoryPressureWindow;
+            Setting &preload = apps.add("zygote_preload", Setting::TypeArray);
+            for(const std::string &library : m_zygotePreload) {
+                preload.add(Setting::TypeString) = library;
+            }
+        }
+        root.add("cgroups", Setting::TypeGroup);
+        {
+            Setting &cgroups = root["cgroups"];
+            cgroups.add("active", Setting::TypeBoolean) = m_cgroupsActive;
+            cgroups.add("daemon_cpuset", Setting::TypeString) = m_daemonCpuset;
+            cgroups.add("apps_cpuset", Setting::TypeString) = m_appsCpuset;
         }
 
         std::string samplePath = m_configFilePath + ".sample";
@@ -273,11 +509,53 @@ void Daemon::reload()
         }
     }
 
+    if(m_scheduler) {
+        m_scheduler->logStatistics();
+    }
+    if(m_prefetcher) {
+        m_prefetcher->logStatistics();
+    }
+    if(m_appManager) {
+        m_appManager->logLaunchStatistics();
+        m_appManager->setForegroundScheduling(m_foregroundScheduling, m_backgroundNice, m_backgroundCpuWeight);
+        m_appManager->setWarmCache(std::max(m_warmCacheSize, 0), static_cast<uint64_t>(std::max(m_warmCacheMemory, 0)) * 1024 * 1024);
+        m_appManager->setAutostartConcurrency(std::max(m_autostartConcurrency, 0));
+        updateResourceSampling();
+        updateLaunchTracing();
+    }
+    if(m_inputThread) {
+        std::shared_ptr<Scheduler> inputScheduler = m_inputThread->getScheduler();
+        std::shared_ptr<InputAccumulator> inputAccumulator = m_inputAccumulator;
+        InputAccumulator::Policy policy = m_inputCoalescing;
+        m_inputThread->post([this, inputScheduler, inputAccumulator, policy]() {
+            inputScheduler->logStatistics();
+            inputAccumulator->logStatistics();
+            inputAccumulator->setPolicy(policy);
+            m_loader->logStatistics();
+        });
+    } else if(m_inputAccumulator) {
+        m_inputAccumulator->logStatistics();
+        m_inputAccumulator->setPolicy(m_inputCoalescing);
+        m_loader->logStatistics();
+    }
+
     // Also reload all hosts, if the loader is already loaded (after the first start).
     if(m_loader) {
-        m_loader->setSoDir(m_soPath);
+        if(m_inputThread) {
+            // The hosts belong to the input thread.
+            std::string soPath = m_soPath;
+            bool watchSoPath = m_watchSoPath;
+            m_inputThread->post([this, soPath, watchSoPath]() {
+                m_loader->setSoDir(soPath);
+                m_loader->reload();
+                m_loader->setWatching(watchSoPath);
+            });
+        } else {
+            m_loader->setSoDir(m_soPath);
 
-        m_loader->reload();
+            m_loader->reload();
+            m_loader->setWatching(m_watchSoPath);
+        }
     }
 }
 
@@ -294,9 +572,9 @@ void Daemon::signalHandler(const boost::system::error_code &code, int signal_num
             reload();
             break;
         case SIGUSR1:
-            // This signal means, that the app processing should continue.
-            BOOST_LOG_SEV(m_log, L_INFO) << "Received a SIGUSR1, this means the daemon continues processing the apps now.";
-            m_appManager->processApps();
+            // Apps with wait_for_signal report their readiness with this signal.
+            BOOST_LOG_SEV(m_log, L_INFO) << "Received a SIGUSR1, this means the apps waiting for the signal are ready now.";
+            m_appManager->readySignalReceived();
             break;
     }
     m_signals.async_wait(boost::bind(&Daemon::signalHandler, this, _1, _2));
@@ -304,8 +582,10 @@ void Daemon::signalHandler(const boost::system::error_code &code, int signal_num
 void Daemon::update()
 {
     if(m_host) {
-        // This is the host update function.
-        piga_host_update(m_host.get());
+        // This is the host update function. With the input thread, it runs over there.
+        if(!m_inputThread) {
+            piga_host_update(m_host.get());
+        }
 
         piga_event_queue *clientQueue = piga_client_get_in_queue(m_client.get());
         
@@ -322,11 +602,13 @@ void Daemon::update()
                     event_restart = piga_event_get_request_restart(m_cacheEvent.get());
                     piga_event_request_restart_get_name(event_restart, m_cacheBuffer);
                     app = (*m_appManager)[m_cacheBuffer];
-                    if(app->isRunning()) {
-                        app->stop();
+                    if(!app) {
+                        BOOST_LOG_SEV(m_log, L_WARN) << "Restart of the unknown app \"" << m_cacheBuffer << "\" was requested.";
+                        break;
                     }
-                    app->reload();
-                    app->start();
+                    // Resumed from the warm cache or started again once it exited, the
+                    // main loop keeps running meanwhile.
+                    m_appManager->switchToApp(m_cacheBuffer);
                     break;
                 case PIGA_EVENT_CONSUMER_REGISTERED:    // UNHANDLED
                     break;
@@ -346,13 +628,39 @@ void Daemon::update()
                     break;
             }
         }
-
-        m_hostTimer->expires_from_now(boost::posix_time::milliseconds(20));
-        m_hostTimer->async_wait(std::bind(&Daemon::update, this));
     }
     if(m_appManager) {
         m_appManager->update();
     }
 }
+void Daemon::updateLaunchTracing()
+{
+    m_appManager->setLaunchTracer(m_prefetchRecord ? m_launchTracer : nullptr,
+                                  std::chrono::milliseconds(std::max(m_prefetchRecordTime, 1000)));
+}
+void Daemon::updateResourceSampling()
+{
+    if(!m_scheduler || !m_appManager)
+        return;
+
+    m_appManager->setResourceHistoryLength(std::max(m_resourceHistoryLength, 1));
+    if(m_resourceSamplingInterval <= 0) {
+        if(m_resourceSamplingHandle != 0) {
+            m_scheduler->remove(m_resourceSamplingHandle);
+            m_resourceSamplingHandle = 0;
+        }
+    } else if(m_resourceSamplingHandle == 0) {
+        std::shared_ptr<AppManager> appManager = m_appManager;
+        m_resourceSamplingHandle = m_scheduler->add("Resources", std::chrono::milliseconds(m_resourceSamplingInterval),
+                                                    [appManager]() { appManager->sampleResources(); });
+    } else {
+        m_scheduler->reschedule(m_resourceSamplingHandle, std::chrono::milliseconds(m_resourceSamplingInterval));
+    }
+}
+void Daemon::doorbellRung()
+{
+    update();
+    m_doorbell->asyncWait(std::bind(&Daemon::doorbellRung, this));
+}
 }
 }
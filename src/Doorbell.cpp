@@ -0,0 +1,73 @@
+#include <piga/daemon/Doorbell.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/log/trivial.hpp>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <cstdint>
+
+namespace piga
+{
+namespace daemon
+{
+Doorbell::Doorbell(std::shared_ptr<boost::asio::io_service> io_service)
+    : m_io_service(io_service)
+{
+    m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(m_fd < 0) {
+        BOOST_LOG_TRIVIAL(error) << "Could not create the doorbell eventfd: " << strerror(errno);
+        return;
+    }
+
+    m_descriptor.reset(new boost::asio::posix::stream_descriptor(*m_io_service, m_fd));
+}
+Doorbell::~Doorbell()
+{
+    if(m_descriptor) {
+        // The descriptor owns the fd and closes it.
+        boost::system::error_code ec;
+        m_descriptor->close(ec);
+    }
+}
+void Doorbell::ring()
+{
+    if(m_fd < 0)
+        return;
+
+    uint64_t one = 1;
+    // Only fails with EAGAIN if the counter would overflow, which means
+    // the doorbell is already ringing.
+    ssize_t r = write(m_fd, &one, sizeof(one));
+    (void) r;
+}
+void Doorbell::asyncWait(Doorbell::Handler handler)
+{
+    if(!m_descriptor)
+        return;
+
+    int fd = m_fd;
+    m_descriptor->async_read_some(boost::asio::null_buffers(),
+        [fd, handler](const boost::system::error_code &error, std::size_t) {
+            if(error)
+                return;
+
+            // Reset the counter, so all rings until now are handled by this call.
+            uint64_t count = 0;
+            ssize_t r = read(fd, &count, sizeof(count));
+            (void) r;
+
+            handler();
+        });
+}
+int Doorbell::getFd() const
+{
+    return m_fd;
+}
+bool Doorbell::isValid() const
+{
+    return m_fd >= 0;
+}
+}
+}
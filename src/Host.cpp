@@ -2,107 +2,120 @@
 #include <dlfcn.h>
 #include <boost/log/trivial.hpp>
 #include <piga/hosts/host.h>
+#include <piga/daemon/host_extensions.h>
 #include <piga/event.h>
-#include <piga/event_game_input.h>
-#include <boost/asio/deadline_timer.hpp>
 #include <functional>
 #include <chrono>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 namespace piga
 {
 namespace daemon
 {
 
-std::shared_ptr<piga_host> Host::m_globalHost = std::shared_ptr<piga_host>(nullptr);
-thread_local std::shared_ptr<piga_event> Host::m_cacheEvent = std::shared_ptr<piga_event>(nullptr);
+std::shared_ptr<InputAccumulator> Host::m_inputAccumulator = std::shared_ptr<InputAccumulator>(nullptr);
+Host *Host::m_currentHost = nullptr;
 
-Host::Host(const std::string &path, std::shared_ptr<boost::asio::io_service> io_service, std::shared_ptr<piga_host> globalHost)
-    : m_path(path), m_io_service(io_service)
+Host::Host(const std::string &path, std::shared_ptr<boost::asio::io_service> io_service, std::shared_ptr<Scheduler> scheduler)
+    : m_path(path), m_io_service(io_service), m_scheduler(scheduler)
 {
-    // Set the global host
-    Host::m_globalHost = globalHost;
-    Host::m_cacheEvent = std::shared_ptr<piga_event>(piga_event_create(), piga_event_free);
-
-    // Try to open the handle.
-    m_dlHandle = dlopen(path.c_str(), RTLD_LAZY);
+    // Open the handle once. All relocations are done here, so a broken library
+    // is rejected while loading and not while its functions are called.
+    m_dlHandle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
 
-    if(m_dlHandle != nullptr)
+    if(m_dlHandle == nullptr)
     {
-        //Load informational functions.
-        m_getPigaMajorVersion = dlsym(m_dlHandle, "getPigaMajorVersion");
-        m_getPigaMinorVersion = dlsym(m_dlHandle, "getPigaMinorVersion");
-        m_getPigaMiniVersion = dlsym(m_dlHandle, "getPigaMiniVersion");
-        m_getName = dlsym(m_dlHandle, "getName");
-        m_getDescription = dlsym(m_dlHandle, "getDescription");
-        m_getAuthor = dlsym(m_dlHandle, "getAuthor");
+        BOOST_LOG_TRIVIAL(error) << "Could not open the dlhandle to \"" << path << "\": " << dlerror();
+        return;
     }
-    else
+    if(!resolveSymbols())
     {
-        BOOST_LOG_TRIVIAL(error) << "Could not open the dlhandle to \"" << path << "\".";
-        return;
+        dlclose(m_dlHandle);
+        m_dlHandle = nullptr;
+        m_symbols = Symbols();
     }
 }
 
 Host::~Host()
 {
     destroy();
+
+    if(m_dlHandle != nullptr)
+    {
+        dlclose(m_dlHandle);
+        m_dlHandle = nullptr;
+    }
+}
+
+bool Host::resolveSymbols()
+{
+    bool complete = true;
+
+    // The extensions are only resolved with dlsym(), the declarations keep the types in sync.
+    static_assert(std::is_same<PullInputs, decltype(&::pullInputs)>::value, "PullInputs does not match host_extensions.h");
+    static_assert(std::is_same<GetHostExtensionVersion, decltype(&::getHostExtensionVersion)>::value, "GetHostExtensionVersion does not match host_extensions.h");
+    static_assert(std::is_same<PollInputs, decltype(&::pollInputs)>::value, "PollInputs does not match host_extensions.h");
+
+#define PIGA_DAEMON_HOST_SYMBOL_RESOLVE(type, member, name, required) \
+    m_symbols.member = reinterpret_cast<type>(dlsym(m_dlHandle, name)); \
+    if(required && m_symbols.member == nullptr) { \
+        BOOST_LOG_TRIVIAL(error) << "Host library \"" << m_path << "\" does not export the required symbol \"" << name << "\"."; \
+        complete = false; \
+    }
+    PIGA_DAEMON_HOST_SYMBOLS(PIGA_DAEMON_HOST_SYMBOL_RESOLVE)
+#undef PIGA_DAEMON_HOST_SYMBOL_RESOLVE
+
+    return complete;
+}
+
+bool Host::isValid() const
+{
+    return m_dlHandle != nullptr;
 }
 
 void Host::init(int playerCount)
 {
-    destroy();
+    if(!isValid())
+        return;
 
-    m_dlHandle = dlopen(m_path.c_str(), RTLD_LAZY);
-
-    //Load functions
-    m_getButtonState = dlsym(m_dlHandle, "getButtonState");
-    m_init = dlsym(m_dlHandle, "init");
-    m_useUpdateFunction = dlsym(m_dlHandle, "useUpdateFunction");
-    m_update = dlsym(m_dlHandle, "update");
-    m_destroy = dlsym(m_dlHandle, "destroy");
-    m_getPigaMajorVersion = dlsym(m_dlHandle, "getPigaMajorVersion");
-    m_getPigaMinorVersion = dlsym(m_dlHandle, "getPigaMinorVersion");
-    m_getPigaMiniVersion = dlsym(m_dlHandle, "getPigaMiniVersion");
-    m_getName = dlsym(m_dlHandle, "getName");
-    m_getDescription = dlsym(m_dlHandle, "getDescription");
-    m_getAuthor = dlsym(m_dlHandle, "getAuthor");
-    m_setInputCallback = dlsym(m_dlHandle, "setCallbackFunc");
-
-    m_implementsOutputs = dlsym(m_dlHandle, "implementsOutputs");
-    m_getOutputCount = dlsym(m_dlHandle, "getOutputCount");
-    m_getOutputType = dlsym(m_dlHandle, "getOutputType");
-    m_getOutputPos = dlsym(m_dlHandle, "getOutputPos");
-    m_getOutputName = dlsym(m_dlHandle, "getOutputName");
-    m_getOutputDescription = dlsym(m_dlHandle, "getOutputDescription");
-    m_getIntOutputRangeMin = dlsym(m_dlHandle, "getIntOutputRangeMin");
-    m_getIntOutputRangeMax = dlsym(m_dlHandle, "getIntOutputRangeMax");
-    m_getFloatOutputRangeMin = dlsym(m_dlHandle, "getFloatOutputRangeMin");
-    m_getFloatOutputRangeMax = dlsym(m_dlHandle, "getFloatOutputRangeMax");
-    m_getDoubleOutputRangeMin = dlsym(m_dlHandle, "getDoubleOutputRangeMin");
-    m_getDoubleOutputRangeMax = dlsym(m_dlHandle, "getDoubleOutputRangeMax");
-    m_setColorOutput = dlsym(m_dlHandle, "setColorOutput");
-    m_setBoolOutput = dlsym(m_dlHandle, "setBoolOutput");
-    m_setStringOutput = dlsym(m_dlHandle, "setStringOutput");
-    m_setIntOutput = dlsym(m_dlHandle, "setIntOutput");
-    m_setFloatOutput = dlsym(m_dlHandle, "setFloatOutput");
-    m_setDoubleOutput = dlsym(m_dlHandle, "setDoubleOutput");
+    if(m_initialized)
+        destroy();
 
     if(test())
     {
         //Init the library
-        int code = ((Init) m_init)(playerCount);
+        int code = m_symbols.init(playerCount);
+        m_initialized = true;
+
+        // Hosts implementing the bulk interface are read through it, whatever their pipeline is.
+        int extensionVersion = 0;
+        if(m_symbols.getHostExtensionVersion != nullptr) {
+            extensionVersion = m_symbols.getHostExtensionVersion();
+        }
+        if(extensionVersion > PIGA_DAEMON_HOST_EXTENSION_VERSION) {
+            BOOST_LOG_TRIVIAL(debug) << "Host library \"" << m_path << "\" implements extension version " << extensionVersion
+                                     << ", the daemon only knows version " << PIGA_DAEMON_HOST_EXTENSION_VERSION << ".";
+        }
+        m_bulkInputs = extensionVersion >= 2 && m_symbols.pollInputs != nullptr;
+        if(m_bulkInputs) {
+            m_pollBuffer.resize(PullBufferCapacity);
+            BOOST_LOG_TRIVIAL(debug) << "Host library \"" << m_path << "\" implements extension version " << extensionVersion << " and is read through pollInputs().";
+        }
+
         switch(code)
         {
             case HOST_RETURNCODE_USEFIXEDFUNCTION:
                 m_type = FixedFunction;
-                m_controls.resize(playerCount);
-                for(auto &controls : m_controls)
-                {
-                    for(auto &control : controls)
-                    {
-                        control.second = 0;
-                    }
-                }
+                m_playerCount = playerCount;
+                m_controls.assign(playerCount * FixedFunctionControls, 0);
+                m_previousControls.assign(playerCount * FixedFunctionControls, 0);
                 BOOST_LOG_TRIVIAL(debug) << "Loading host library with the fixed function pipeline.";
 
                 break;
@@ -110,34 +123,33 @@ void Host::init(int playerCount)
                 BOOST_LOG_TRIVIAL(debug) << "Loading host library with the input method pipeline.";
                 m_type = InputMethods;
                 m_controls.clear();
+                m_previousControls.clear();
+                m_pullBuffer.resize(PullBufferCapacity);
+                if(m_symbols.pullInputs == nullptr) {
+                    BOOST_LOG_TRIVIAL(warning) << "The input methods host \"" << m_path << "\" does not export pullInputs(). No inputs will be read from it.";
+                }
                 break;
             case HOST_RETURNCODE_USECALLBACK:
                 BOOST_LOG_TRIVIAL(debug) << "Loading host library with the callback pipeline.";
                 m_type = InputCallback;
-                setInputCallback(&Host::globalInputCallback);
+                if(!m_bulkInputs) {
+                    setInputCallback(&Host::globalInputCallback);
+                }
                 break;
             default:
                 m_type = Undefined;
                 break;
         }
 
-        if(m_useUpdateFunction) {
-            float use = useUpdateFunction();
-            if(use != 0) {
-                m_timer = std::make_shared<boost::asio::deadline_timer>(*m_io_service,
-                    boost::posix_time::millisec(useUpdateFunction()));
-
-                std::function<void(const boost::system::error_code&)> handler = [&](const boost::system::error_code& error) {
-                    if(!error) {
-                        update();
-
-                        m_timer->async_wait(handler);
-                    }
-                };
-
-                m_timer->async_wait(handler);
-            }
+        // The return value of useUpdateFunction is the update interval in milliseconds.
+        float interval = 0;
+        if(m_symbols.useUpdateFunction) {
+            interval = useUpdateFunction();
         }
+        if(interval <= 0 && (m_type == FixedFunction || m_type == InputMethods || m_bulkInputs)) {
+            interval = DefaultPollInterval;
+        }
+        m_updateInterval = interval > 0 ? interval : 0;
 
         BOOST_LOG_TRIVIAL(info) << "Loaded shared object \"" << getName() << "\" with the API-Version " << getPigaMajorVersion() << "." << getPigaMinorVersion() << "." << getPigaMiniVersion()
              << " - the daemon is running on " << HOST_VERSION_MAJOR << "." << HOST_VERSION_MINOR << "." << HOST_VERSION_MINI;
@@ -150,6 +162,16 @@ void Host::init(int playerCount)
     }
 }
 
+void Host::start()
+{
+    if(!m_initialized || m_updateInterval <= 0 || m_updateHandle != 0)
+        return;
+
+    m_updateHandle = m_scheduler->add(std::string("Host:") + getName(),
+        std::chrono::microseconds(static_cast<int64_t>(m_updateInterval * 1000)),
+        std::bind(&Host::tick, this));
+}
+
 bool Host::test()
 {
     if(HOST_VERSION_MAJOR != getPigaMajorVersion())
@@ -169,203 +191,378 @@ bool Host::test()
 
 void Host::destroy()
 {
-    if(m_dlHandle != nullptr)
-    {
-        BOOST_LOG_TRIVIAL(debug) << "Destroyed shared library \"" << getName() << "\".";
+    if(m_updateHandle != 0) {
+        m_scheduler->remove(m_updateHandle);
+        m_updateHandle = 0;
+    }
+    if(!m_initialized)
+        return;
 
-        dlclose(m_dlHandle);
-        m_dlHandle = nullptr;
+    // The library stays loaded, so the host can be initialized again without
+    // reopening and resolving it.
+    if(m_symbols.destroy != nullptr)
+        m_symbols.destroy();
+    m_initialized = false;
+    m_bulkInputs = false;
 
-        m_getPigaMajorVersion = nullptr;
-        m_getPigaMinorVersion = nullptr;
-        m_getPigaMiniVersion = nullptr;
-        m_init = nullptr;
-        m_useUpdateFunction = nullptr;
-        m_update = nullptr;
-        m_destroy = nullptr;
-        m_getButtonState = nullptr;
-        m_getName = nullptr;
-        m_getDescription = nullptr;
-        m_getAuthor = nullptr;
-        m_setInputCallback = nullptr;
-        m_implementsOutputs = nullptr;
-        m_getOutputCount = nullptr;
-        m_getOutputType = nullptr;
-        m_getOutputPos = nullptr;
-        m_getOutputName = nullptr;
-        m_getOutputDescription = nullptr;
-        m_getIntOutputRangeMin = nullptr;
-        m_getIntOutputRangeMax = nullptr;
-        m_getFloatOutputRangeMin = nullptr;
-        m_getFloatOutputRangeMax = nullptr;
-        m_getDoubleOutputRangeMin = nullptr;
-        m_getDoubleOutputRangeMax = nullptr;
-        m_setColorOutput = nullptr;
-        m_setBoolOutput = nullptr;
-        m_setStringOutput = nullptr;
-        m_setIntOutput = nullptr;
-        m_setFloatOutput = nullptr;
-        m_setDoubleOutput = nullptr;
-    }
+    BOOST_LOG_TRIVIAL(debug) << "Destroyed shared library \"" << getName() << "\".";
 }
 
 int Host::getPigaMajorVersion()
 {
-    return ((GetPigaMajorVersion) m_getPigaMajorVersion)();
+    return m_symbols.getPigaMajorVersion();
 }
 
 int Host::getPigaMinorVersion()
 {
-    return ((GetPigaMinorVersion) m_getPigaMinorVersion)();
+    return m_symbols.getPigaMinorVersion();
 }
 
 int Host::getPigaMiniVersion()
 {
-    return ((GetPigaMiniVersion) m_getPigaMiniVersion)();
+    return m_symbols.getPigaMiniVersion();
 }
 
 const char *Host::getName()
 {
-    if(m_getName != nullptr)
-        return ((GetString) m_getName)();
+    if(m_symbols.getName != nullptr)
+        return m_symbols.getName();
     else
         return "";
 }
 
 const char *Host::getDescription()
 {
-    if(m_getDescription != nullptr)
-        return ((GetString) m_getDescription)();
+    if(m_symbols.getDescription != nullptr)
+        return m_symbols.getDescription();
     else
         return "";
 }
 
 const char *Host::getAuthor()
 {
-    if(m_getAuthor != nullptr)
-        return ((GetString) m_getAuthor)();
+    if(m_symbols.getAuthor != nullptr)
+        return m_symbols.getAuthor();
     else
         return "";
 }
 
 void Host::setInputCallback(Host::InputCallbackFunctionType callback)
 {
-    ((SetInputCallback) m_setInputCallback)(callback);
+    if(m_symbols.setInputCallback != nullptr)
+        m_symbols.setInputCallback(callback);
 }
 
 void Host::inputCallback(int controlCode, int playerID, int value)
 {
-    m_controls[playerID][controlCode] = value;
+    if(playerID >= 0 && playerID < m_playerCount && controlCode >= 0 && controlCode < FixedFunctionControls) {
+        m_controls[playerID * FixedFunctionControls + controlCode] = value;
+    }
 }
 
 bool Host::implementsOutputs()
 {
-    return ((ImplementsOutputs) m_implementsOutputs)();
+    if(m_symbols.implementsOutputs != nullptr)
+        return m_symbols.implementsOutputs();
+    else
+        return false;
 }
 
 int Host::getOutputCount()
 {
-    return ((GetOutputCount) m_getOutputCount)();
+    if(m_symbols.getOutputCount != nullptr)
+        return m_symbols.getOutputCount();
+    else
+        return 0;
 }
 
 int Host::getOutputType(int outputID)
 {
-    return ((GetOutputType) m_getOutputType)(outputID);
+    if(m_symbols.getOutputType != nullptr)
+        return m_symbols.getOutputType(outputID);
+    else
+        return 0;
 }
 
 int Host::getOutputPos(int outputID)
 {
-    return ((GetOutputPos) m_getOutputPos)(outputID);
+    if(m_symbols.getOutputPos != nullptr)
+        return m_symbols.getOutputPos(outputID);
+    else
+        return 0;
 }
 
 const char *Host::getOutputName(int outputID)
 {
-    return ((GetOutputName) m_getOutputName)(outputID);
+    if(m_symbols.getOutputName != nullptr)
+        return m_symbols.getOutputName(outputID);
+    else
+        return "";
 }
 
 const char *Host::getOutputDescription(int outputID)
 {
-    return ((GetOutputDescription) m_getOutputDescription)(outputID);
+    if(m_symbols.getOutputDescription != nullptr)
+        return m_symbols.getOutputDescription(outputID);
+    else
+        return "";
 }
 
 int Host::getIntOutputRangeMin(int outputID)
 {
-    return ((GetIntOutputRangeMin) m_getIntOutputRangeMin)(outputID);
+    if(m_symbols.getIntOutputRangeMin != nullptr)
+        return m_symbols.getIntOutputRangeMin(outputID);
+    else
+        return 0;
 }
 
 int Host::getIntOutputRangeMax(int outputID)
 {
-    return ((GetIntOutputRangeMax) m_getIntOutputRangeMax)(outputID);
+    if(m_symbols.getIntOutputRangeMax != nullptr)
+        return m_symbols.getIntOutputRangeMax(outputID);
+    else
+        return 0;
 }
 
 float Host::getFloatOutputRangeMin(int outputID)
 {
-    return ((GetFloatOutputRangeMin) m_getFloatOutputRangeMin)(outputID);
+    if(m_symbols.getFloatOutputRangeMin != nullptr)
+        return m_symbols.getFloatOutputRangeMin(outputID);
+    else
+        return 0;
 }
 
 float Host::getFloatOutputRangeMax(int outputID)
 {
-    return ((GetFloatOutputRangeMax) m_getFloatOutputRangeMax)(outputID);
+    if(m_symbols.getFloatOutputRangeMax != nullptr)
+        return m_symbols.getFloatOutputRangeMax(outputID);
+    else
+        return 0;
 }
 
 double Host::getDoubleOutputRangeMin(int outputID)
 {
-    return ((GetDoubleOutputRangeMin) m_getDoubleOutputRangeMin)(outputID);
+    if(m_symbols.getDoubleOutputRangeMin != nullptr)
+        return m_symbols.getDoubleOutputRangeMin(outputID);
+    else
+        return 0;
 }
 
 double Host::getDoubleOutputRangeMax(int outputID)
 {
-    return ((GetDoubleOutputRangeMax) m_getDoubleOutputRangeMax)(outputID);
+    if(m_symbols.getDoubleOutputRangeMax != nullptr)
+        return m_symbols.getDoubleOutputRangeMax(outputID);
+    else
+        return 0;
 }
 
 int Host::setColorOutput(int outputID, float r, float g, float b, float a)
 {
-    return ((SetColorOutput) m_setColorOutput)(outputID, r, g, b, a);
+    if(m_symbols.setColorOutput != nullptr)
+        return m_symbols.setColorOutput(outputID, r, g, b, a);
+    else
+        return 0;
 }
 
 int Host::setBoolOutput(int outputID, int value)
 {
-    return ((SetBoolOutput) m_setBoolOutput)(outputID, value);
+    if(m_symbols.setBoolOutput != nullptr)
+        return m_symbols.setBoolOutput(outputID, value);
+    else
+        return 0;
 }
 
 int Host::setStringOutput(int outputID, const char *outString)
 {
-    return ((SetStringOutput) m_setStringOutput)(outputID, outString);
+    if(m_symbols.setStringOutput != nullptr)
+        return m_symbols.setStringOutput(outputID, outString);
+    else
+        return 0;
 }
 
 int Host::setIntOutput(int outputID, int value)
 {
-    return ((SetIntOutput) m_setIntOutput)(outputID, value);
+    if(m_symbols.setIntOutput != nullptr)
+        return m_symbols.setIntOutput(outputID, value);
+    else
+        return 0;
 }
 
 int Host::setFloatOutput(int outputID, float value)
 {
-    return ((SetFloatOutput) m_setFloatOutput)(outputID, value);
+    if(m_symbols.setFloatOutput != nullptr)
+        return m_symbols.setFloatOutput(outputID, value);
+    else
+        return 0;
 }
 
 int Host::setDoubleOutput(int outputID, double value)
 {
-    return ((SetDoubleOutput) m_setDoubleOutput)(outputID, value);
+    if(m_symbols.setDoubleOutput != nullptr)
+        return m_symbols.setDoubleOutput(outputID, value);
+    else
+        return 0;
 }
 
 float Host::useUpdateFunction()
 {
-    return ((UseUpdateFunction) m_useUpdateFunction)();
+    if(m_symbols.useUpdateFunction != nullptr)
+        return m_symbols.useUpdateFunction();
+    else
+        return 0;
 }
 void Host::update()
 {
-    ((Update) m_update)();
+    if(m_symbols.update != nullptr)
+        m_symbols.update();
 }
-void Host::globalInputCallback(int player, int input, int value)
+void Host::tick()
+{
+    m_currentHost = this;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if(m_symbols.update) {
+        update();
+    }
+    if(m_bulkInputs) {
+        pollBulkInputs();
+    }
+    else switch(m_type) {
+        case FixedFunction:
+            pollFixedFunction();
+            break;
+        case InputMethods:
+            pullInputMethods();
+            break;
+        default:
+            break;
+    }
+
+    std::chrono::nanoseconds time = std::chrono::steady_clock::now() - start;
+    m_currentHost = nullptr;
+
+    ++m_pipelineStatistics.calls;
+    m_pipelineStatistics.time += time;
+    m_pipelineStatistics.maxTime = std::max(m_pipelineStatistics.maxTime, time);
+}
+void Host::pollFixedFunction()
+{
+    GetButtonState getButtonState = m_symbols.getButtonState;
+    if(getButtonState == nullptr)
+        return;
+
+    int32_t *controls = m_controls.data();
+    for(int player = 0; player < m_playerCount; ++player) {
+        for(int control = 0; control < FixedFunctionControls; ++control) {
+            controls[player * FixedFunctionControls + control] = getButtonState(player, control);
+        }
+    }
+
+    // Compare four controls at once and only look at single controls of changed groups.
+    static_assert(FixedFunctionControls % 4 == 0, "The rows of the control table have to be groups of 4.");
+    const int32_t *previous = m_previousControls.data();
+    const std::size_t count = m_controls.size();
+    for(std::size_t i = 0; i < count; i += 4) {
+        bool changed;
+#if defined(__SSE2__)
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(controls + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i));
+        changed = _mm_movemask_epi8(_mm_cmpeq_epi32(a, b)) != 0xFFFF;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        uint32x4_t eq = vceqq_s32(vld1q_s32(controls + i), vld1q_s32(previous + i));
+        changed = vminvq_u32(eq) == 0;
+#else
+        changed = controls[i] != previous[i] || controls[i + 1] != previous[i + 1]
+               || controls[i + 2] != previous[i + 2] || controls[i + 3] != previous[i + 3];
+#endif
+        if(!changed)
+            continue;
+
+        for(std::size_t n = i; n < i + 4; ++n) {
+            if(controls[n] != previous[n]) {
+                m_inputAccumulator->record(n / FixedFunctionControls, n % FixedFunctionControls, controls[n]);
+                ++m_pipelineStatistics.inputs;
+            }
+        }
+    }
+
+    // The next poll overwrites every value, so the tables can just be swapped.
+    m_controls.swap(m_previousControls);
+}
+void Host::pullInputMethods()
 {
-    piga_host_set_player_input(m_globalHost.get(), player, input, value);
-    piga_event_set_type(m_cacheEvent.get(), PIGA_EVENT_GAME_INPUT);
-    piga_event_game_input *evInput = piga_event_get_game_input(m_cacheEvent.get());
-    piga_event_game_input_set_input_id(evInput, static_cast<char>(input));
-    piga_event_game_input_set_player_id(evInput, static_cast<char>(player));
-    piga_event_game_input_set_input_value(evInput, value);
+    PullInputs pull = m_symbols.pullInputs;
+    if(pull == nullptr)
+        return;
 
-    piga_host_push_event(m_globalHost.get(), m_cacheEvent.get());
+    int count = 0;
+    do {
+        count = pull(m_pullBuffer.data(), PullBufferCapacity);
+        for(int i = 0; i < count; ++i) {
+            const piga_host_input &input = m_pullBuffer[i];
+            m_inputAccumulator->record(input.player, input.input, input.value);
+        }
+        if(count > 0) {
+            m_pipelineStatistics.inputs += count;
+        }
+    } while(count == PullBufferCapacity);
+}
+void Host::pollBulkInputs()
+{
+    PollInputs poll = m_symbols.pollInputs;
+
+    int count = 0;
+    do {
+        count = poll(m_pollBuffer.data(), PullBufferCapacity);
+        for(int i = 0; i < count; ++i) {
+            const piga_host_timed_input &input = m_pollBuffer[i];
+            m_inputAccumulator->record(input.player, input.input, input.value, input.monotonic_ns);
+        }
+        if(count > 0) {
+            m_pipelineStatistics.inputs += count;
+        }
+    } while(count == PullBufferCapacity);
+}
+const Host::PipelineStatistics& Host::getPipelineStatistics() const
+{
+    return m_pipelineStatistics;
+}
+void Host::logPipelineStatistics()
+{
+    const PipelineStatistics &s = m_pipelineStatistics;
+    uint64_t perCall = s.calls > 0 ? s.time.count() / s.calls : 0;
+    uint64_t perInput = s.inputs > 0 ? s.time.count() / s.inputs : 0;
+    BOOST_LOG_TRIVIAL(info) << "Host \"" << getName() << "\" (" << (m_bulkInputs ? "PollInputs" : getTypeName(m_type)) << " pipeline): "
+        << s.calls << " reads with " << s.inputs << " inputs, " << perCall << "ns per read, "
+        << perInput << "ns per input, max " << s.maxTime.count() << "ns.";
+}
+Host::Type Host::getType() const
+{
+    return m_type;
+}
+const char* Host::getTypeName(Host::Type type)
+{
+    switch(type) {
+        case FixedFunction:
+            return "FixedFunction";
+        case InputMethods:
+            return "InputMethods";
+        case InputCallback:
+            return "InputCallback";
+        default:
+            return "Undefined";
+    }
+}
+void Host::globalInputCallback(int player, int input, int value)
+{
+    m_inputAccumulator->record(player, input, value);
+    if(m_currentHost) {
+        ++m_currentHost->m_pipelineStatistics.inputs;
+    }
+}
+void Host::setInputAccumulator(std::shared_ptr<InputAccumulator> accumulator)
+{
+    m_inputAccumulator = accumulator;
 }
 
 }
@@ -0,0 +1,182 @@
+#include <piga/daemon/InputAccumulator.hpp>
+#include <piga/daemon/Doorbell.hpp>
+#include <boost/log/trivial.hpp>
+#include <piga/event_game_input.h>
+#include <algorithm>
+#include <time.h>
+
+namespace piga
+{
+namespace daemon
+{
+namespace
+{
+// In the order of InputAccumulator::Policy.
+const char *PolicyNames[] = {"KeepAll", "KeepDigitalEdges", "LatestOnly"};
+}
+
+bool InputAccumulator::getPolicyFromStr(const std::string &str, InputAccumulator::Policy &policy)
+{
+    for(int i = KeepAll; i <= LatestOnly; ++i) {
+        if(str == PolicyNames[i]) {
+            policy = static_cast<Policy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+const char *InputAccumulator::getStrFromPolicy(InputAccumulator::Policy policy)
+{
+    return PolicyNames[policy];
+}
+
+InputAccumulator::InputAccumulator(std::shared_ptr<boost::asio::io_service> io_service, std::shared_ptr<piga_host> globalHost, int playerCount, InputAccumulator::Policy policy)
+    : m_io_service(io_service),
+      m_globalHost(globalHost),
+      m_cacheEvent(piga_event_create(), piga_event_free),
+      m_playerCount(playerCount),
+      m_policy(policy),
+      m_pending(playerCount * InputsPerPlayer, -1),
+      m_log(bl::keywords::channel = "Class:InputAccumulator")
+{
+    m_events.reserve(playerCount * InputsPerPlayer);
+    m_flushing.reserve(playerCount * InputsPerPlayer);
+}
+InputAccumulator::~InputAccumulator()
+{
+
+}
+void InputAccumulator::setPolicy(InputAccumulator::Policy policy)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_policy = policy;
+}
+void InputAccumulator::setDoorbell(std::shared_ptr<Doorbell> doorbell)
+{
+    m_doorbell = doorbell;
+}
+void InputAccumulator::setBatchHandler(InputAccumulator::BatchHandler handler)
+{
+    m_batchHandler = handler;
+}
+int InputAccumulator::getKey(int player, int input) const
+{
+    if(player < 0 || player >= m_playerCount)
+        return -1;
+    return player * InputsPerPlayer + static_cast<unsigned char>(input);
+}
+void InputAccumulator::record(int player, int input, int value, uint64_t timestamp)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_statistics.recorded;
+
+    int key = getKey(player, input);
+    if(key >= 0 && m_policy != KeepAll && m_pending[key] >= 0) {
+        InputEvent &pending = m_events[m_pending[key]];
+        bool edge = (pending.value != 0) != (value != 0);
+        if(m_policy == LatestOnly || !edge) {
+            pending.value = value;
+            pending.timestamp = timestamp;
+            return;
+        }
+    }
+
+    InputEvent event;
+    event.player = player;
+    event.input = input;
+    event.value = value;
+    event.timestamp = timestamp;
+    if(key >= 0) {
+        m_pending[key] = static_cast<int32_t>(m_events.size());
+    }
+    m_events.push_back(event);
+
+    if(!m_flushPosted) {
+        // Runs after the current handler, which collects all inputs of this tick.
+        m_flushPosted = true;
+        m_io_service->post(std::bind(&InputAccumulator::flush, this));
+    }
+}
+void InputAccumulator::flush()
+{
+    {
+        // Inputs recorded while the batch is submitted go into the next flush.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_flushPosted = false;
+        if(m_events.empty())
+            return;
+        for(const InputEvent &event : m_events) {
+            int key = getKey(event.player, event.input);
+            if(key >= 0) {
+                m_pending[key] = -1;
+            }
+        }
+        m_flushing.swap(m_events);
+    }
+
+    piga_event_set_type(m_cacheEvent.get(), PIGA_EVENT_GAME_INPUT);
+    piga_event_game_input *evInput = piga_event_get_game_input(m_cacheEvent.get());
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t nowNs = static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+
+    uint64_t timedInputs = 0, latencySum = 0, maxLatency = 0;
+    for(const InputEvent &event : m_flushing) {
+        if(m_globalHost) {
+            piga_host_set_player_input(m_globalHost.get(), event.player, event.input, event.value);
+            piga_event_game_input_set_input_id(evInput, static_cast<char>(event.input));
+            piga_event_game_input_set_player_id(evInput, static_cast<char>(event.player));
+            piga_event_game_input_set_input_value(evInput, event.value);
+            piga_host_push_event(m_globalHost.get(), m_cacheEvent.get());
+        }
+
+        if(event.timestamp != 0 && event.timestamp <= nowNs) {
+            uint64_t latency = nowNs - event.timestamp;
+            ++timedInputs;
+            latencySum += latency;
+            maxLatency = std::max(maxLatency, latency);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.submitted += m_flushing.size();
+        ++m_statistics.flushes;
+        m_statistics.timedInputs += timedInputs;
+        m_statistics.latencySum += latencySum;
+        m_statistics.maxLatency = std::max(m_statistics.maxLatency, maxLatency);
+    }
+    if(m_batchHandler) {
+        m_batchHandler(m_flushing);
+    }
+    m_flushing.clear();
+
+    if(m_doorbell) {
+        m_doorbell->ring();
+    }
+}
+InputAccumulator::Statistics InputAccumulator::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+void InputAccumulator::logStatistics()
+{
+    Statistics statistics;
+    std::size_t pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        statistics = m_statistics;
+        pending = m_events.size();
+    }
+    BOOST_LOG_SEV(m_log, L_INFO) << statistics.recorded << " inputs recorded, " << statistics.submitted
+        << " submitted in " << statistics.flushes << " batches, "
+        << (statistics.recorded - statistics.submitted - pending) << " coalesced.";
+    if(statistics.timedInputs > 0) {
+        BOOST_LOG_SEV(m_log, L_INFO) << "Latency from the host to the clients for " << statistics.timedInputs << " timed inputs: "
+            << (statistics.latencySum / statistics.timedInputs) << "ns on average, " << statistics.maxLatency << "ns max.";
+    }
+}
+}
+}
@@ -0,0 +1,83 @@
+#include <piga/daemon/InputThread.hpp>
+#include <boost/log/trivial.hpp>
+#include <pthread.h>
+#include <sched.h>
+#include <cstring>
+
+namespace piga
+{
+namespace daemon
+{
+InputThread::InputThread(int cpu, int realtimePriority)
+    : m_cpu(cpu),
+      m_realtimePriority(realtimePriority),
+      m_io_service(std::make_shared<boost::asio::io_service>()),
+      m_work(std::make_shared<boost::asio::io_service::work>(*m_io_service)),
+      m_scheduler(std::make_shared<Scheduler>(m_io_service)),
+      m_log(bl::keywords::channel = "Class:InputThread")
+{
+
+}
+InputThread::~InputThread()
+{
+    stop();
+}
+void InputThread::start()
+{
+    if(m_thread.joinable())
+        return;
+
+    m_thread = std::thread(&InputThread::run, this);
+
+    if(m_cpu >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(m_cpu, &cpuset);
+        int r = pthread_setaffinity_np(m_thread.native_handle(), sizeof(cpuset), &cpuset);
+        if(r != 0) {
+            BOOST_LOG_SEV(m_log, L_WARN) << "Could not pin the input thread to CPU " << m_cpu << ": " << strerror(r);
+        } else {
+            BOOST_LOG_SEV(m_log, L_INFO) << "Pinned the input thread to CPU " << m_cpu << ".";
+        }
+    }
+    if(m_realtimePriority > 0) {
+        sched_param param;
+        param.sched_priority = m_realtimePriority;
+        int r = pthread_setschedparam(m_thread.native_handle(), SCHED_FIFO, &param);
+        if(r != 0) {
+            BOOST_LOG_SEV(m_log, L_WARN) << "Could not set SCHED_FIFO with priority " << m_realtimePriority << " for the input thread: " << strerror(r);
+        } else {
+            BOOST_LOG_SEV(m_log, L_INFO) << "The input thread runs with SCHED_FIFO and priority " << m_realtimePriority << ".";
+        }
+    }
+}
+void InputThread::stop()
+{
+    if(!m_thread.joinable())
+        return;
+
+    m_work.reset();
+    m_io_service->stop();
+    m_thread.join();
+
+    BOOST_LOG_SEV(m_log, L_INFO) << "Stopped the input thread.";
+}
+void InputThread::post(std::function<void()> function)
+{
+    m_io_service->post(function);
+}
+std::shared_ptr<boost::asio::io_service> InputThread::getIOService()
+{
+    return m_io_service;
+}
+std::shared_ptr<Scheduler> InputThread::getScheduler()
+{
+    return m_scheduler;
+}
+void InputThread::run()
+{
+    BOOST_LOG_SEV(m_log, L_INFO) << "Started the input thread.";
+    m_io_service->run();
+}
+}
+}
@@ -0,0 +1,453 @@
+#include <piga/daemon/LaunchPlan.hpp>
+#include <sched.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <errno.h>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+
+namespace piga
+{
+namespace daemon
+{
+namespace
+{
+const int IoprioClassShift = 13;
+const int IoprioWhoProcess = 1;
+
+// On 32 bit x86 and ARM, setuid is the old call with 16 bit uids.
+#ifdef SYS_setuid32
+const long SetuidSyscall = SYS_setuid32;
+#else
+const long SetuidSyscall = SYS_setuid;
+#endif
+
+// Writes the decimal value into the buffer without snprintf(), which is not async-signal-safe.
+char* formatInt(char *buffer, int value)
+{
+    char digits[16];
+    int count = 0;
+    unsigned int magnitude = value < 0 ? -static_cast<unsigned int>(value) : value;
+    do {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while(magnitude > 0);
+    if(value < 0)
+        *buffer++ = '-';
+    while(count > 0)
+        *buffer++ = digits[--count];
+    *buffer = '\0';
+    return buffer;
+}
+
+struct ChildArguments {
+    const char *executable;
+    char * const *argv;
+    char * const *envp;
+    const char *workingDirectory;
+    bool setUid;
+    uid_t uid;
+    const int *inheritedFds;
+    std::size_t inheritedFdCount;
+    int cgroupFd;
+    const LaunchPlan::Scheduling *scheduling;
+    int schedulingError;
+    const sigset_t *signalMask;
+    // Written by the child, which shares the memory of the daemon.
+    int error;
+};
+
+// Runs in the memory of the daemon until execve, only async-signal-safe calls are allowed.
+int launchChild(void *data)
+{
+    ChildArguments *args = static_cast<ChildArguments*>(data);
+
+    // Handlers of the daemon must not run in the child, ignored signals stay ignored.
+    struct sigaction defaultAction;
+    std::memset(&defaultAction, 0, sizeof(defaultAction));
+    defaultAction.sa_handler = SIG_DFL;
+    for(int sig = 1; sig < NSIG; ++sig) {
+        struct sigaction action;
+        if(sigaction(sig, nullptr, &action) == 0 && action.sa_handler != SIG_IGN && action.sa_handler != SIG_DFL) {
+            sigaction(sig, &defaultAction, nullptr);
+        }
+    }
+    sigprocmask(SIG_SETMASK, args->signalMask, nullptr);
+
+    // Writing 0 moves the writing process, so the app never runs outside of its cgroup.
+    if(args->cgroupFd >= 0 && write(args->cgroupFd, "0", 1) != 1) {
+        args->error = errno;
+        _exit(127);
+    }
+
+    // Raising priorities needs the privileges of the daemon, so this happens before setuid().
+    args->schedulingError = LaunchPlan::applyScheduling(0, *args->scheduling);
+
+    // The setuid() of glibc synchronizes all threads of the process, which would
+    // be the threads of the daemon here. The syscall only changes this process.
+    if(args->setUid && syscall(SetuidSyscall, args->uid) != 0) {
+        args->error = errno;
+        _exit(127);
+    }
+    for(std::size_t i = 0; i < args->inheritedFdCount; ++i) {
+        fcntl(args->inheritedFds[i], F_SETFD, 0);
+    }
+    if(args->workingDirectory[0] != '\0' && chdir(args->workingDirectory) != 0) {
+        args->error = errno;
+        _exit(127);
+    }
+
+    execve(args->executable, args->argv, args->envp);
+
+    args->error = errno;
+    _exit(127);
+}
+}
+
+int LaunchPlan::m_defaultOomScoreAdj = 0;
+
+int LaunchPlan::applyScheduling(pid_t pid, const Scheduling &scheduling)
+{
+    int error = 0;
+    if(scheduling.setPolicy) {
+        struct sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        int policy = scheduling.policy;
+        if(policy == SCHED_FIFO || policy == SCHED_RR) {
+            param.sched_priority = scheduling.priority;
+            // Children of a realtime app should not inherit its priority.
+            policy |= SCHED_RESET_ON_FORK;
+        }
+        if(sched_setscheduler(pid, policy, &param) != 0 && error == 0)
+            error = errno;
+    }
+    if(scheduling.setNice && setpriority(PRIO_PROCESS, pid, scheduling.nice) != 0 && error == 0) {
+        error = errno;
+    }
+    if(scheduling.setIoprio) {
+        int ioprio = (scheduling.ioprioClass << IoprioClassShift) | scheduling.ioprioLevel;
+        if(syscall(SYS_ioprio_set, IoprioWhoProcess, pid, ioprio) != 0 && error == 0)
+            error = errno;
+    }
+    if(scheduling.setOomScoreAdj) {
+        char path[64] = "/proc/self/oom_score_adj";
+        if(pid != 0) {
+            char *end = formatInt(path + 6, pid);
+            std::memcpy(end, "/oom_score_adj", sizeof("/oom_score_adj"));
+        }
+        char value[16];
+        char *end = formatInt(value, scheduling.oomScoreAdj);
+        int fd = open(path, O_WRONLY | O_CLOEXEC);
+        if(fd < 0 || write(fd, value, end - value) != end - value) {
+            if(error == 0)
+                error = errno;
+        }
+        if(fd >= 0)
+            close(fd);
+    }
+    if(scheduling.setAffinity && sched_setaffinity(pid, sizeof(scheduling.affinity), &scheduling.affinity) != 0 && error == 0) {
+        error = errno;
+    }
+    return error;
+}
+bool LaunchPlan::readScheduling(pid_t pid, Scheduling &scheduling)
+{
+    scheduling = Scheduling();
+
+    int policy = sched_getscheduler(pid);
+    if(policy < 0)
+        return false;
+    scheduling.setPolicy = true;
+    scheduling.policy = policy & ~SCHED_RESET_ON_FORK;
+    struct sched_param param;
+    if(sched_getparam(pid, &param) == 0)
+        scheduling.priority = param.sched_priority;
+
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, pid);
+    if(errno == 0) {
+        scheduling.setNice = true;
+        scheduling.nice = nice;
+    }
+
+    long ioprio = syscall(SYS_ioprio_get, IoprioWhoProcess, pid);
+    if(ioprio >= 0) {
+        scheduling.setIoprio = true;
+        scheduling.ioprioClass = ioprio >> IoprioClassShift;
+        scheduling.ioprioLevel = ioprio & ((1 << IoprioClassShift) - 1);
+    }
+
+    std::ifstream oomScoreAdj("/proc/" + std::to_string(pid) + "/oom_score_adj");
+    if(oomScoreAdj >> scheduling.oomScoreAdj) {
+        scheduling.setOomScoreAdj = true;
+    }
+
+    if(sched_getaffinity(pid, sizeof(scheduling.affinity), &scheduling.affinity) == 0) {
+        scheduling.setAffinity = true;
+    }
+    return true;
+}
+void LaunchPlan::setDefaultOomScoreAdj(int oomScoreAdj)
+{
+    m_defaultOomScoreAdj = oomScoreAdj;
+}
+int LaunchPlan::getDefaultOomScoreAdj()
+{
+    return m_defaultOomScoreAdj;
+}
+bool LaunchPlan::parseCpuList(const std::string &str, cpu_set_t &cpus)
+{
+    CPU_ZERO(&cpus);
+    std::size_t begin = 0;
+    while(begin < str.size()) {
+        std::size_t end = str.find(',', begin);
+        if(end == std::string::npos)
+            end = str.size();
+        std::string range = str.substr(begin, end - begin);
+        std::size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            if(first < 0 || last < first || last >= CPU_SETSIZE)
+                return false;
+            for(int cpu = first; cpu <= last; ++cpu) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        catch(const std::exception &e) {
+            return false;
+        }
+        begin = end + 1;
+    }
+    return CPU_COUNT(&cpus) > 0;
+}
+std::string LaunchPlan::formatCpuList(const cpu_set_t &cpus)
+{
+    std::string list;
+    for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if(!CPU_ISSET(cpu, &cpus))
+            continue;
+        int last = cpu;
+        while(last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpus))
+            ++last;
+        if(!list.empty())
+            list += ",";
+        list += std::to_string(cpu);
+        if(last > cpu)
+            list += "-" + std::to_string(last);
+        cpu = last;
+    }
+    return list;
+}
+
+void LaunchPlan::clear()
+{
+    m_executable.clear();
+    m_workingDirectory.clear();
+    m_setUid = false;
+    m_uid = 0;
+    m_inheritedFds.clear();
+    m_cgroupProcs.clear();
+    m_scheduling = Scheduling();
+    m_arena.clear();
+    m_argumentOffsets.clear();
+    m_environmentOffsets.clear();
+    m_argv.clear();
+    m_envp.clear();
+    m_valid = false;
+}
+void LaunchPlan::setExecutable(const std::string &executable)
+{
+    m_executable = executable;
+    if(executable.find('/') != std::string::npos)
+        return;
+
+    // Resolve the name like execvp() would, but only once.
+    const char *path = getenv("PATH");
+    std::string directories = path != nullptr ? path : "/usr/local/bin:/usr/bin:/bin";
+    std::size_t begin = 0;
+    while(begin <= directories.size()) {
+        std::size_t end = directories.find(':', begin);
+        if(end == std::string::npos)
+            end = directories.size();
+
+        std::string directory = directories.substr(begin, end - begin);
+        if(directory.empty())
+            directory = ".";
+        std::string candidate = directory + "/" + executable;
+        if(access(candidate.c_str(), X_OK) == 0) {
+            m_executable = candidate;
+            return;
+        }
+        begin = end + 1;
+    }
+}
+void LaunchPlan::addArgument(const std::string &argument)
+{
+    m_argumentOffsets.push_back(m_arena.size());
+    m_arena.insert(m_arena.end(), argument.begin(), argument.end());
+    m_arena.push_back('\0');
+    m_valid = false;
+}
+void LaunchPlan::addEnvironment(const std::string &envvar)
+{
+    m_environmentOffsets.push_back(m_arena.size());
+    m_arena.insert(m_arena.end(), envvar.begin(), envvar.end());
+    m_arena.push_back('\0');
+    m_valid = false;
+}
+void LaunchPlan::setWorkingDirectory(const std::string &workingDirectory)
+{
+    m_workingDirectory = workingDirectory;
+}
+void LaunchPlan::setUid(uid_t uid)
+{
+    m_setUid = true;
+    m_uid = uid;
+}
+void LaunchPlan::addInheritedFd(int fd)
+{
+    m_inheritedFds.push_back(fd);
+}
+void LaunchPlan::setCgroup(const std::string &procsPath)
+{
+    m_cgroupProcs = procsPath;
+}
+void LaunchPlan::setScheduling(const Scheduling &scheduling)
+{
+    m_scheduling = scheduling;
+}
+const LaunchPlan::Scheduling &LaunchPlan::getScheduling() const
+{
+    return m_scheduling;
+}
+void LaunchPlan::finalize()
+{
+    // The arena does not change anymore, so the pointers stay valid.
+    m_argv.clear();
+    for(std::size_t offset : m_argumentOffsets) {
+        m_argv.push_back(m_arena.data() + offset);
+    }
+    m_argv.push_back(nullptr);
+
+    m_envp.clear();
+    for(std::size_t offset : m_environmentOffsets) {
+        m_envp.push_back(m_arena.data() + offset);
+    }
+    m_envp.push_back(nullptr);
+
+    m_valid = !m_executable.empty();
+}
+bool LaunchPlan::isValid() const
+{
+    return m_valid;
+}
+pid_t LaunchPlan::spawn(int &error)
+{
+    error = 0;
+    if(!m_valid) {
+        error = EINVAL;
+        return -1;
+    }
+    if(m_stack.empty()) {
+        m_stack.resize(StackSize);
+    }
+
+    // Opened here, because the child may not have the permission after setuid().
+    int cgroupFd = -1;
+    if(!m_cgroupProcs.empty()) {
+        cgroupFd = open(m_cgroupProcs.c_str(), O_WRONLY | O_CLOEXEC);
+        if(cgroupFd < 0) {
+            error = errno;
+            return -1;
+        }
+    }
+
+    // No signal may be handled in the child before it resets the handlers.
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+
+    ChildArguments args;
+    args.executable = m_executable.c_str();
+    args.argv = m_argv.data();
+    args.envp = m_envp.data();
+    args.workingDirectory = m_workingDirectory.c_str();
+    args.setUid = m_setUid;
+    args.uid = m_uid;
+    args.inheritedFds = m_inheritedFds.data();
+    args.inheritedFdCount = m_inheritedFds.size();
+    args.cgroupFd = cgroupFd;
+    // The protection of the daemon against the OOM killer is not passed on.
+    Scheduling scheduling = m_scheduling;
+    if(!scheduling.setOomScoreAdj) {
+        scheduling.setOomScoreAdj = true;
+        scheduling.oomScoreAdj = m_defaultOomScoreAdj;
+    }
+    args.scheduling = &scheduling;
+    args.schedulingError = 0;
+    args.signalMask = &previous;
+    args.error = 0;
+
+    // The stack grows down on all supported architectures.
+    uintptr_t stackTop = reinterpret_cast<uintptr_t>(m_stack.data() + m_stack.size()) & ~static_cast<uintptr_t>(15);
+
+    // With CLONE_VFORK, this returns after the child called execve or exited.
+    pid_t pid = clone(&launchChild, reinterpret_cast<void*>(stackTop), CLONE_VM | CLONE_VFORK | SIGCHLD, &args);
+    int cloneError = errno;
+
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    if(cgroupFd >= 0)
+        close(cgroupFd);
+
+    if(pid < 0) {
+        error = cloneError;
+        return -1;
+    }
+    m_schedulingError = args.schedulingError;
+    if(args.error != 0) {
+        // The child exited before execve, it is reaped right here.
+        int status;
+        waitpid(pid, &status, 0);
+        error = args.error;
+        return -1;
+    }
+    return pid;
+}
+int LaunchPlan::getSchedulingError() const
+{
+    return m_schedulingError;
+}
+const std::string &LaunchPlan::getExecutable() const
+{
+    return m_executable;
+}
+const std::string &LaunchPlan::getWorkingDirectory() const
+{
+    return m_workingDirectory;
+}
+char * const *LaunchPlan::getArguments() const
+{
+    return m_argv.data();
+}
+char * const *LaunchPlan::getEnvironment() const
+{
+    return m_envp.data();
+}
+bool LaunchPlan::hasUid() const
+{
+    return m_setUid;
+}
+uid_t LaunchPlan::getUid() const
+{
+    return m_uid;
+}
+}
+}
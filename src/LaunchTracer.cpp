@@ -0,0 +1,398 @@
+#include <piga/daemon/LaunchTracer.hpp>
+#include <piga/daemon/LaunchPlan.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/filesystem.hpp>
+#include <sys/fanotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <sched.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace piga
+{
+namespace daemon
+{
+namespace
+{
+const char *CgroupMount = "/sys/fs/cgroup";
+const char *VersionPrefix = "# version ";
+// Where the dynamic linker and dlopen() find libraries, multiarch directories are globbed.
+const char *LibraryDirectories[] = {"/lib", "/lib64", "/usr/lib", "/usr/lib64", "/usr/local/lib",
+                                    "/lib/*-linux-gnu", "/usr/lib/*-linux-gnu"};
+
+pid_t getParentPid(pid_t pid)
+{
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if(!std::getline(stat, line))
+        return 0;
+    // The name in parentheses may contain spaces, the fields after it are "<state> <ppid>".
+    std::size_t end = line.rfind(')');
+    if(end == std::string::npos)
+        return 0;
+    std::istringstream fields(line.substr(end + 1));
+    std::string state;
+    pid_t ppid = 0;
+    fields >> state >> ppid;
+    return ppid;
+}
+std::string getCgroup(pid_t pid)
+{
+    std::ifstream cgroup("/proc/" + std::to_string(pid) + "/cgroup");
+    std::string line;
+    while(std::getline(cgroup, line)) {
+        if(line.compare(0, 3, "0::") == 0)
+            return line.substr(3);
+    }
+    return std::string();
+}
+}
+
+LaunchTracer::LaunchTracer(std::shared_ptr<boost::asio::io_service> io_service)
+    : m_io_service(io_service),
+      m_log(bl::keywords::channel = "Class:LaunchTracer")
+{
+
+}
+LaunchTracer::~LaunchTracer()
+{
+    while(!m_recordings.empty()) {
+        cancel(m_recordings.begin()->first);
+    }
+    if(m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        m_thread.join();
+    }
+}
+void LaunchTracer::begin(const std::string &name, const std::string &directory, const std::string &traceFile, const std::string &version)
+{
+    cancel(name);
+
+    std::unique_ptr<Recording> recording(new Recording());
+    recording->name = name;
+    recording->directory = directory;
+    recording->traceFile = traceFile;
+    recording->version = version;
+
+    int fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK, O_RDONLY | O_LARGEFILE | O_CLOEXEC);
+    if(fd >= 0 && !addMarks(fd, directory)) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not watch the directory \"" << directory << "\": " << strerror(errno);
+        close(fd);
+        fd = -1;
+    }
+    if(fd >= 0) {
+        recording->fanotify.reset(new boost::asio::posix::stream_descriptor(*m_io_service, fd));
+    } else {
+        BOOST_LOG_SEV(m_log, L_INFO) << "fanotify is not available (" << strerror(errno) << "), the launch of \"" << name << "\" is recorded from the page cache of its directory.";
+    }
+    m_recordings[name] = std::move(recording);
+}
+void LaunchTracer::attach(const std::string &name, pid_t pid, const std::string &cgroupProcs, std::chrono::milliseconds duration)
+{
+    auto it = m_recordings.find(name);
+    if(it == m_recordings.end())
+        return;
+    Recording &recording = *it->second;
+
+    recording.pid = pid;
+    if(!cgroupProcs.empty()) {
+        std::string cgroup = cgroupProcs.substr(0, cgroupProcs.find_last_of('/'));
+        if(cgroup.compare(0, std::strlen(CgroupMount), CgroupMount) == 0)
+            recording.cgroup = cgroup.substr(std::strlen(CgroupMount));
+    }
+
+    BOOST_LOG_SEV(m_log, L_INFO) << "Recording the launch of \"" << name << "\" for " << duration.count() << "ms.";
+    if(recording.fanotify) {
+        asyncRead(recording);
+    }
+    recording.timer.reset(new boost::asio::steady_timer(*m_io_service));
+    recording.timer->expires_from_now(duration);
+    recording.timer->async_wait([this, name](const boost::system::error_code &error) {
+        if(error)
+            return;
+        finish(name);
+    });
+}
+void LaunchTracer::cancel(const std::string &name)
+{
+    auto it = m_recordings.find(name);
+    if(it == m_recordings.end())
+        return;
+
+    boost::system::error_code ec;
+    if(it->second->timer)
+        it->second->timer->cancel(ec);
+    if(it->second->fanotify)
+        it->second->fanotify->close(ec);
+    m_recordings.erase(it);
+}
+bool LaunchTracer::isRecording(const std::string &name) const
+{
+    return m_recordings.count(name) > 0;
+}
+std::string LaunchTracer::readVersion(const std::string &traceFile)
+{
+    std::ifstream file(traceFile);
+    std::string line;
+    // The version is part of the header comments.
+    while(std::getline(file, line) && !line.empty() && line[0] == '#') {
+        if(line.compare(0, std::strlen(VersionPrefix), VersionPrefix) == 0)
+            return line.substr(std::strlen(VersionPrefix));
+    }
+    return std::string();
+}
+bool LaunchTracer::addMarks(int fd, const std::string &directory)
+{
+    const unsigned int flags = FAN_MARK_ADD | FAN_MARK_ONLYDIR;
+    const uint64_t mask = FAN_OPEN | FAN_EVENT_ON_CHILD;
+    if(fanotify_mark(fd, flags, mask, AT_FDCWD, directory.c_str()) != 0)
+        return false;
+
+    // Directory marks only report their direct children, so every subdirectory is marked.
+    std::size_t directories = 1;
+    boost::system::error_code ec;
+    boost::filesystem::recursive_directory_iterator it(directory, ec), end;
+    for(; !ec && it != end && directories < MaxDirectories; it.increment(ec)) {
+        if(boost::filesystem::is_directory(it->status()) && fanotify_mark(fd, flags, mask, AT_FDCWD, it->path().c_str()) == 0)
+            ++directories;
+    }
+
+    for(const char *pattern : LibraryDirectories) {
+        glob_t matches;
+        if(glob(pattern, GLOB_NOSORT | GLOB_ONLYDIR, nullptr, &matches) == 0) {
+            for(std::size_t i = 0; i < matches.gl_pathc; ++i) {
+                fanotify_mark(fd, flags, mask, AT_FDCWD, matches.gl_pathv[i]);
+            }
+        }
+        globfree(&matches);
+    }
+    return true;
+}
+void LaunchTracer::asyncRead(Recording &recording)
+{
+    std::string name = recording.name;
+    recording.fanotify->async_read_some(boost::asio::null_buffers(),
+        [this, name](const boost::system::error_code &error, std::size_t) {
+            if(error)
+                return;
+            auto it = m_recordings.find(name);
+            if(it == m_recordings.end())
+                return;
+            readEvents(*it->second);
+            asyncRead(*it->second);
+        });
+}
+void LaunchTracer::readEvents(Recording &recording)
+{
+    alignas(fanotify_event_metadata) char buffer[8192];
+    while(true) {
+        ssize_t length = read(recording.fanotify->native_handle(), buffer, sizeof(buffer));
+        if(length <= 0)
+            break;
+
+        fanotify_event_metadata *event = reinterpret_cast<fanotify_event_metadata*>(buffer);
+        for(; FAN_EVENT_OK(event, length); event = FAN_EVENT_NEXT(event, length)) {
+            if(event->fd < 0)
+                continue;
+
+            if(recording.files.size() < MaxFiles && belongsToApp(recording, event->pid)) {
+                char path[PATH_MAX];
+                std::string link = "/proc/self/fd/" + std::to_string(event->fd);
+                ssize_t pathLength = readlink(link.c_str(), path, sizeof(path) - 1);
+                struct stat st;
+                if(pathLength > 0 && fstat(event->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+                    std::string file(path, pathLength);
+                    if(recording.seen.insert(file).second)
+                        recording.files.push_back(file);
+                }
+            }
+            close(event->fd);
+        }
+    }
+}
+bool LaunchTracer::belongsToApp(Recording &recording, pid_t pid)
+{
+    // The daemon itself reads the marked directories, e.g. while prefetching.
+    if(pid == recording.pid)
+        return true;
+    if(pid == getpid())
+        return false;
+
+    auto known = recording.processes.find(pid);
+    if(known != recording.processes.end())
+        return known->second;
+
+    bool belongs = false;
+    if(!recording.cgroup.empty()) {
+        std::string cgroup = getCgroup(pid);
+        belongs = cgroup == recording.cgroup || cgroup.compare(0, recording.cgroup.size() + 1, recording.cgroup + "/") == 0;
+    } else {
+        for(pid_t current = pid; current > 1; current = getParentPid(current)) {
+            if(current == recording.pid) {
+                belongs = true;
+                break;
+            }
+        }
+    }
+    recording.processes[pid] = belongs;
+    return belongs;
+}
+void LaunchTracer::finish(const std::string &name)
+{
+    auto it = m_recordings.find(name);
+    if(it == m_recordings.end())
+        return;
+
+    Recording &recording = *it->second;
+    Trace trace;
+    trace.name = recording.name;
+    trace.directory = recording.directory;
+    trace.traceFile = recording.traceFile;
+    trace.version = recording.version;
+    trace.files = std::move(recording.files);
+    trace.scanDirectory = !recording.fanotify;
+    cancel(name);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_traces.push_back(std::move(trace));
+    }
+    m_condition.notify_one();
+    if(!m_thread.joinable()) {
+        m_thread = std::thread(&LaunchTracer::run, this);
+    }
+}
+void LaunchTracer::run()
+{
+    // Only the calling thread is changed with pid 0.
+    LaunchPlan::Scheduling scheduling;
+    scheduling.setPolicy = true;
+    scheduling.policy = SCHED_BATCH;
+    scheduling.setNice = true;
+    scheduling.nice = 19;
+    scheduling.setIoprio = true;
+    scheduling.ioprioClass = 2;
+    scheduling.ioprioLevel = 7;
+    int error = LaunchPlan::applyScheduling(0, scheduling);
+    if(error != 0) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not lower the priority of the trace writer thread: " << strerror(error);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true) {
+        m_condition.wait(lock, [this]() { return m_stop || !m_traces.empty(); });
+        if(m_stop)
+            break;
+
+        Trace trace = std::move(m_traces.front());
+        m_traces.pop_front();
+        lock.unlock();
+        write(trace);
+        lock.lock();
+    }
+}
+void LaunchTracer::write(Trace &trace)
+{
+    if(trace.scanDirectory) {
+        // Without the open order, the cached files of the app directory are used.
+        boost::system::error_code ec;
+        boost::filesystem::recursive_directory_iterator file(trace.directory, ec), end;
+        for(; !ec && file != end && trace.files.size() < MaxFiles; file.increment(ec)) {
+            if(boost::filesystem::is_regular_file(file->status()) && file->path().string() != trace.traceFile)
+                trace.files.push_back(file->path().string());
+        }
+    }
+
+    std::string content = "# Launch trace of \"" + trace.name + "\", generated by piga-daemon.\n";
+    content += VersionPrefix + trace.version + "\n";
+
+    std::string directory = trace.directory;
+    if(!directory.empty() && directory.back() != '/')
+        directory += '/';
+
+    std::size_t files = 0;
+    for(const std::string &file : trace.files) {
+        // Files of the app are stored relative, so the trace stays valid if the app is moved.
+        std::string entry = file.compare(0, directory.size(), directory) == 0 ? file.substr(directory.size()) : file;
+        if(appendCachedRanges(file, entry, content))
+            ++files;
+    }
+
+    std::string temporary = trace.traceFile + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        out << content;
+        if(!out) {
+            BOOST_LOG_SEV(m_log, L_WARN) << "Could not write the launch trace \"" << trace.traceFile << "\".";
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    std::rename(temporary.c_str(), trace.traceFile.c_str());
+    BOOST_LOG_SEV(m_log, L_INFO) << "Recorded " << files << " files of the launch of \"" << trace.name << "\" into \"" << trace.traceFile << "\".";
+}
+bool LaunchTracer::appendCachedRanges(const std::string &path, const std::string &entry, std::string &trace)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    std::size_t size = st.st_size;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return false;
+
+    std::size_t pageSize = sysconf(_SC_PAGESIZE);
+    std::size_t pages = (size + pageSize - 1) / pageSize;
+    std::vector<unsigned char> resident(pages);
+    bool ok = mincore(map, size, resident.data()) == 0;
+    munmap(map, size);
+    if(!ok)
+        return false;
+
+    // Small holes are read as well, fewer and larger reads are faster than exact ones.
+    const std::size_t MaxGap = 16;
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+    for(std::size_t page = 0; page < pages; ++page) {
+        if(!(resident[page] & 1))
+            continue;
+        if(!runs.empty() && page - runs.back().second <= MaxGap)
+            runs.back().second = page + 1;
+        else
+            runs.emplace_back(page, page + 1);
+    }
+    if(runs.empty())
+        return false;
+
+    if(runs.size() == 1 && runs[0].first == 0 && runs[0].second == pages) {
+        trace += entry + "\n";
+        return true;
+    }
+    for(const auto &run : runs) {
+        std::size_t offset = run.first * pageSize;
+        std::size_t length = std::min(run.second * pageSize, size) - offset;
+        trace += std::to_string(offset) + " " + std::to_string(length) + " " + entry + "\n";
+    }
+    return true;
+}
+}
+}
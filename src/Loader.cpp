@@ -1,23 +1,37 @@
 #include <piga/daemon/Loader.hpp>
 #include <piga/daemon/Host.hpp>
+#include <piga/daemon/WorkerPool.hpp>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <chrono>
+#include <vector>
 
 namespace piga
 {
 namespace daemon
 {
+// Bound to a reference by std::chrono::milliseconds, so it needs a definition.
+const int Loader::WatchDebounceMs;
 
-Loader::Loader(const std::string &soDir, int playerCount, std::shared_ptr<boost::asio::io_service> ioService, std::shared_ptr<piga_host> globalHost)
-    : m_soDir(soDir), m_playerCount(playerCount), m_ioService(ioService), m_globalHost(globalHost)
+Loader::Loader(const std::string &soDir, int playerCount, std::shared_ptr<boost::asio::io_service> ioService, std::shared_ptr<Scheduler> scheduler, std::shared_ptr<piga_host> globalHost)
+    : m_soDir(soDir), m_playerCount(playerCount), m_ioService(ioService), m_scheduler(scheduler), m_globalHost(globalHost),
+      m_reloadTimer(*ioService),
+      m_log(bl::keywords::channel = "Class:Loader")
 {
-
 }
 
 Loader::~Loader()
 {
-
+    stopWatching();
 }
 
 const std::string &Loader::getSoDir()
@@ -40,20 +54,257 @@ void Loader::setPlayerCount(int playerCount)
     m_playerCount = playerCount;
 }
 
-void Loader::reload()
+void Loader::setWatching(bool watching)
+{
+    if(!watching) {
+        stopWatching();
+        return;
+    }
+    if(m_inotifyFd >= 0)
+        return;
+
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_inotifyFd < 0) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not create an inotify instance, hosts are only reloaded on SIGHUP: " << strerror(errno);
+        return;
+    }
+    m_inotifyDescriptor.reset(new boost::asio::posix::stream_descriptor(*m_ioService, m_inotifyFd));
+
+    updateWatches();
+    asyncWatch();
+
+    BOOST_LOG_SEV(m_log, L_INFO) << "Watching \"" << m_soDir << "\" for changed hosts.";
+}
+
+bool Loader::isWatching() const
 {
-    m_hosts.clear();
+    return m_inotifyFd >= 0;
+}
 
-    // Iterate recursively over the soDir to find hosts, which are then loaded.
+void Loader::reload(WorkerPool *pool)
+{
     using namespace boost::filesystem;
 
-    for (recursive_directory_iterator it{path{m_soDir}};
-         it != recursive_directory_iterator{}; ++it) {
-        std::unique_ptr<Host> host(new Host(it->path().string(), m_ioService, m_globalHost));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // The hosts have to be initialized again if the player count changed.
+    bool reinitialize = m_loadedPlayerCount != m_playerCount;
+    m_loadedPlayerCount = m_playerCount;
+
+    int loaded = 0, unloaded = 0, swapped = 0, unchanged = 0;
+    std::set<std::string> found;
+    // Hosts which have to be initialized, loading and initializing them is independent.
+    std::vector<std::string> newPaths;
+    std::vector<std::shared_ptr<Host>> initHosts;
+
+    m_directories.clear();
+    m_directories.insert(path(m_soDir).string());
 
+    // Iterate recursively over the soDir to find hosts.
+    boost::system::error_code ec;
+    recursive_directory_iterator it(path(m_soDir), ec);
+    if(ec) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not read the host directory \"" << m_soDir << "\": " << ec.message();
+    }
+    for(; !ec && it != recursive_directory_iterator(); it.increment(ec)) {
+        file_status status = it->status();
+        std::string filePath = it->path().string();
+
+        if(is_directory(status)) {
+            m_directories.insert(filePath);
+            continue;
+        }
+        if(!is_regular_file(status) || it->path().extension() != ".so")
+            continue;
+
+        struct stat st;
+        if(stat(filePath.c_str(), &st) != 0)
+            continue;
+        int64_t mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+        found.insert(filePath);
+
+        auto entry = m_hosts.find(filePath);
+        if(entry != m_hosts.end()) {
+            if(entry->second.device == st.st_dev && entry->second.inode == st.st_ino && entry->second.mtime == mtime) {
+                if(reinitialize && entry->second.host) {
+                    initHosts.push_back(entry->second.host);
+                }
+                ++unchanged;
+                continue;
+            }
+
+            // The old library has to be closed before the new one is opened, both
+            // could claim the same devices.
+            m_hosts.erase(entry);
+            ++swapped;
+        } else {
+            ++loaded;
+        }
+
+        Entry newEntry;
+        newEntry.device = st.st_dev;
+        newEntry.inode = st.st_ino;
+        newEntry.mtime = mtime;
+        m_hosts[filePath] = newEntry;
+        newPaths.push_back(filePath);
+    }
+
+    for(auto entry = m_hosts.begin(); entry != m_hosts.end();) {
+        if(found.count(entry->first) == 0) {
+            BOOST_LOG_SEV(m_log, L_INFO) << "Unloading the removed host \"" << entry->first << "\".";
+            entry = m_hosts.erase(entry);
+            ++unloaded;
+        } else {
+            ++entry;
+        }
+    }
+
+    // Unregistering from the scheduler is done on this thread, init() only touches the host.
+    for(auto &host : initHosts) {
+        host->destroy();
+    }
+
+    // Opening and relocating the libraries is independent and done in parallel.
+    std::vector<std::shared_ptr<Host>> newHosts(newPaths.size());
+    auto openHost = [&](std::size_t n) {
+        std::shared_ptr<Host> host = std::make_shared<Host>(newPaths[n], m_ioService, m_scheduler);
+        if(host->isValid()) {
+            newHosts[n] = host;
+        }
+    };
+    if(pool) {
+        pool->parallelFor(newPaths.size(), openHost);
+    } else {
+        for(std::size_t n = 0; n < newPaths.size(); ++n) {
+            openHost(n);
+        }
+    }
+
+    // Host libraries are not thread safe, so they are initialized one after another
+    // and registered with the scheduler on this thread.
+    for(auto &host : initHosts) {
         host->init(m_playerCount);
-        m_hosts.push_back(std::move(host));
+        host->start();
+    }
+    for(std::size_t n = 0; n < newPaths.size(); ++n) {
+        if(newHosts[n]) {
+            newHosts[n]->init(m_playerCount);
+            newHosts[n]->start();
+            m_hosts[newPaths[n]].host = newHosts[n];
+        }
     }
+
+    if(isWatching()) {
+        updateWatches();
+    }
+
+    std::chrono::microseconds time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    BOOST_LOG_SEV(m_log, L_INFO) << "Reloaded hosts in " << time.count() / 1000.0 << "ms: "
+                                 << loaded << " loaded, " << swapped << " swapped, " << unloaded << " unloaded, "
+                                 << unchanged << (reinitialize ? " initialized again." : " unchanged.");
+}
+
+void Loader::logStatistics()
+{
+    for(auto &entry : m_hosts) {
+        if(entry.second.host) {
+            entry.second.host->logPipelineStatistics();
+        }
+    }
+}
+
+void Loader::updateWatches()
+{
+    for(auto watch = m_watches.begin(); watch != m_watches.end();) {
+        if(m_directories.count(watch->second) == 0) {
+            inotify_rm_watch(m_inotifyFd, watch->first);
+            watch = m_watches.erase(watch);
+        } else {
+            ++watch;
+        }
+    }
+
+    std::set<std::string> watched;
+    for(auto &watch : m_watches) {
+        watched.insert(watch.second);
+    }
+    for(auto &directory : m_directories) {
+        if(watched.count(directory) != 0)
+            continue;
+
+        int wd = inotify_add_watch(m_inotifyFd, directory.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_ONLYDIR);
+        if(wd < 0) {
+            BOOST_LOG_SEV(m_log, L_WARN) << "Could not watch the host directory \"" << directory << "\": " << strerror(errno);
+            continue;
+        }
+        m_watches[wd] = directory;
+    }
+}
+
+void Loader::stopWatching()
+{
+    if(m_inotifyFd < 0)
+        return;
+
+    boost::system::error_code ec;
+    m_reloadTimer.cancel(ec);
+    // The descriptor owns the fd and closes it, which also removes all watches.
+    m_inotifyDescriptor->close(ec);
+    m_inotifyDescriptor.reset();
+    m_inotifyFd = -1;
+    m_watches.clear();
+}
+
+void Loader::asyncWatch()
+{
+    m_inotifyDescriptor->async_read_some(boost::asio::null_buffers(),
+        [this](const boost::system::error_code &error, std::size_t) {
+            if(error)
+                return;
+            watchEvent();
+        });
+}
+
+void Loader::watchEvent()
+{
+    alignas(inotify_event) char buffer[4096];
+    bool changed = false;
+
+    ssize_t length;
+    while((length = read(m_inotifyFd, buffer, sizeof(buffer))) > 0) {
+        for(char *ptr = buffer; ptr < buffer + length;) {
+            const inotify_event *event = reinterpret_cast<const inotify_event*>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            if(event->mask & IN_IGNORED) {
+                m_watches.erase(event->wd);
+                continue;
+            }
+            if(event->mask & (IN_Q_OVERFLOW | IN_ISDIR | IN_DELETE_SELF)) {
+                changed = true;
+                continue;
+            }
+
+            std::size_t nameLength = event->len > 0 ? strlen(event->name) : 0;
+            if(nameLength > 3 && strcmp(event->name + nameLength - 3, ".so") == 0) {
+                changed = true;
+            }
+        }
+    }
+
+    if(changed) {
+        m_reloadTimer.expires_from_now(std::chrono::milliseconds(WatchDebounceMs));
+        m_reloadTimer.async_wait([this](const boost::system::error_code &error) {
+            if(error)
+                return;
+            BOOST_LOG_SEV(m_log, L_INFO) << "The host directory changed, reloading the changed hosts.";
+            reload();
+        });
+    }
+
+    asyncWatch();
 }
 
 }
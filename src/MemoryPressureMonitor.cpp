@@ -0,0 +1,97 @@
+#include <piga/daemon/MemoryPressureMonitor.hpp>
+#include <boost/log/trivial.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <string>
+#include <chrono>
+
+namespace piga
+{
+namespace daemon
+{
+MemoryPressureMonitor::MemoryPressureMonitor(std::shared_ptr<boost::asio::io_service> io_service)
+    : m_io_service(io_service), m_easeTimer(*io_service),
+      m_log(bl::keywords::channel = "Class:MemoryPressureMonitor")
+{
+
+}
+MemoryPressureMonitor::~MemoryPressureMonitor()
+{
+    stop();
+}
+bool MemoryPressureMonitor::start(unsigned int stallMs, unsigned int windowMs, Handler pressure, Handler eased)
+{
+    stop();
+
+    int fd = open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if(fd < 0) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Memory pressure cannot be monitored, PSI is not available: " << strerror(errno);
+        return false;
+    }
+
+    // The trigger is registered by writing it, it stays active until the fd is closed.
+    std::string trigger = "some " + std::to_string(stallMs * 1000) + " " + std::to_string(windowMs * 1000);
+    if(write(fd, trigger.c_str(), trigger.size() + 1) < 0) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not register the memory pressure trigger \"" << trigger << "\": " << strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    m_windowMs = windowMs;
+    m_pressure = pressure;
+    m_eased = eased;
+    m_underPressure = false;
+    m_descriptor.reset(new boost::asio::posix::stream_descriptor(*m_io_service, fd));
+    asyncWait();
+
+    BOOST_LOG_SEV(m_log, L_INFO) << "Monitoring memory pressure with a stall of " << stallMs << "ms in " << windowMs << "ms.";
+    return true;
+}
+void MemoryPressureMonitor::stop()
+{
+    boost::system::error_code ec;
+    m_easeTimer.cancel(ec);
+    if(m_descriptor) {
+        // The descriptor owns the fd, closing it removes the trigger.
+        m_descriptor->close(ec);
+        m_descriptor.reset();
+    }
+}
+bool MemoryPressureMonitor::isActive() const
+{
+    return static_cast<bool>(m_descriptor);
+}
+void MemoryPressureMonitor::asyncWait()
+{
+    // Triggers are signalled with POLLPRI, which is the error wait of asio.
+    m_descriptor->async_wait(boost::asio::posix::stream_descriptor::wait_error,
+        [this](const boost::system::error_code &error) {
+            if(error)
+                return;
+            triggered();
+            asyncWait();
+        });
+}
+void MemoryPressureMonitor::triggered()
+{
+    if(!m_underPressure) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Memory pressure detected.";
+        m_underPressure = true;
+    }
+    if(m_pressure)
+        m_pressure();
+
+    m_easeTimer.expires_from_now(std::chrono::milliseconds(2 * m_windowMs));
+    m_easeTimer.async_wait([this](const boost::system::error_code &error) {
+        if(error)
+            return;
+        BOOST_LOG_SEV(m_log, L_INFO) << "Memory pressure eased.";
+        m_underPressure = false;
+        if(m_eased)
+            m_eased();
+    });
+}
+}
+}
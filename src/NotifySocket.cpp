@@ -0,0 +1,112 @@
+#include <piga/daemon/NotifySocket.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/log/trivial.hpp>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+
+namespace piga
+{
+namespace daemon
+{
+namespace
+{
+// Messages of sd_notify() are small, longer ones are truncated.
+const std::size_t MaxMessageSize = 4096;
+}
+
+NotifySocket::NotifySocket(std::shared_ptr<boost::asio::io_service> io_service)
+    : m_io_service(io_service),
+      m_log(bl::keywords::channel = "Class:NotifySocket")
+{
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        BOOST_LOG_SEV(m_log, L_ERROR) << "Could not create the notify socket: " << strerror(errno);
+        return;
+    }
+    m_serverFd = fds[0];
+    m_clientFd = fds[1];
+
+    // The kernel attaches the credentials of the sender to every received message.
+    int passCredentials = 1;
+    setsockopt(m_serverFd, SOL_SOCKET, SO_PASSCRED, &passCredentials, sizeof(passCredentials));
+
+    m_descriptor.reset(new boost::asio::posix::stream_descriptor(*m_io_service, m_serverFd));
+    m_descriptor->non_blocking(true);
+}
+NotifySocket::~NotifySocket()
+{
+    if(m_descriptor) {
+        // The descriptor owns the server fd and closes it.
+        boost::system::error_code ec;
+        m_descriptor->close(ec);
+    }
+    if(m_clientFd >= 0) {
+        close(m_clientFd);
+    }
+}
+void NotifySocket::asyncReceive(Handler handler)
+{
+    if(!m_descriptor)
+        return;
+
+    m_handler = handler;
+    asyncWait();
+}
+void NotifySocket::asyncWait()
+{
+    m_descriptor->async_read_some(boost::asio::null_buffers(),
+        [this](const boost::system::error_code &error, std::size_t) {
+            if(error)
+                return;
+            receive();
+            asyncWait();
+        });
+}
+void NotifySocket::receive()
+{
+    char buffer[MaxMessageSize];
+    char control[CMSG_SPACE(sizeof(struct ucred))];
+
+    for(;;) {
+        struct iovec iov;
+        iov.iov_base = buffer;
+        iov.iov_len = sizeof(buffer);
+
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t length = recvmsg(m_serverFd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if(length < 0) {
+            // EAGAIN means all queued messages were handled.
+            return;
+        }
+
+        pid_t pid = 0;
+        for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS) {
+                struct ucred credentials;
+                std::memcpy(&credentials, CMSG_DATA(cmsg), sizeof(credentials));
+                pid = credentials.pid;
+            }
+        }
+        if(pid > 0 && m_handler) {
+            m_handler(pid, std::string(buffer, length));
+        }
+    }
+}
+int NotifySocket::getClientFd() const
+{
+    return m_clientFd;
+}
+bool NotifySocket::isValid() const
+{
+    return m_serverFd >= 0;
+}
+}
+}
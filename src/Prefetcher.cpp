@@ -0,0 +1,215 @@
+#include <piga/daemon/Prefetcher.hpp>
+#include <piga/daemon/LaunchPlan.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/filesystem.hpp>
+#include <fcntl.h>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sched.h>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <cctype>
+
+namespace piga
+{
+namespace daemon
+{
+Prefetcher::Prefetcher()
+    : m_log(bl::keywords::channel = "Class:Prefetcher")
+{
+
+}
+Prefetcher::~Prefetcher()
+{
+    stop();
+}
+void Prefetcher::start()
+{
+    if(m_thread.joinable())
+        return;
+    m_stop = false;
+    m_thread = std::thread(&Prefetcher::run, this);
+}
+void Prefetcher::stop()
+{
+    if(!m_thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_jobs.clear();
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+void Prefetcher::prefetch(const std::string &name, std::vector<Range> ranges, const std::string &traceFile)
+{
+    if(ranges.empty() && traceFile.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_running == name)
+            return;
+        for(const Job &job : m_jobs) {
+            if(job.name == name)
+                return;
+        }
+        Job job;
+        job.name = name;
+        job.ranges = std::move(ranges);
+        job.traceFile = traceFile;
+        m_jobs.push_back(std::move(job));
+    }
+    m_condition.notify_one();
+}
+bool Prefetcher::readTrace(const std::string &traceFile, std::vector<Range> &ranges)
+{
+    std::ifstream file(traceFile);
+    if(!file)
+        return false;
+
+    std::string base = boost::filesystem::path(traceFile).parent_path().string();
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.empty() || line[0] == '#')
+            continue;
+
+        Range range;
+        std::istringstream stream(line);
+        if(std::isdigit(static_cast<unsigned char>(line[0])) && stream >> range.offset >> range.length) {
+            stream >> std::ws;
+            std::getline(stream, range.path);
+        } else {
+            range.path = line;
+        }
+        if(range.path.empty())
+            continue;
+        if(range.path[0] != '/')
+            range.path = base + "/" + range.path;
+        ranges.push_back(std::move(range));
+    }
+    return true;
+}
+Prefetcher::Statistics Prefetcher::getStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+void Prefetcher::logStatistics()
+{
+    Statistics statistics = getStatistics();
+    BOOST_LOG_SEV(m_log, L_INFO) << "Prefetched " << statistics.jobs << " jobs with " << statistics.files << " files and "
+                                 << statistics.bytes / (1024 * 1024) << "MiB.";
+}
+void Prefetcher::run()
+{
+    // Only the calling thread is changed with pid 0.
+    LaunchPlan::Scheduling scheduling;
+    scheduling.setPolicy = true;
+    scheduling.policy = SCHED_BATCH;
+    scheduling.setNice = true;
+    scheduling.nice = 19;
+    scheduling.setIoprio = true;
+    scheduling.ioprioClass = 2;
+    scheduling.ioprioLevel = 7;
+    int error = LaunchPlan::applyScheduling(0, scheduling);
+    if(error != 0) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not lower the priority of the prefetch thread: " << strerror(error);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true) {
+        m_condition.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+        if(m_stop)
+            break;
+
+        Job job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        m_running = job.name;
+        lock.unlock();
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        uint64_t files = 0;
+        uint64_t bytes = 0;
+        process(job, files, bytes);
+        std::chrono::microseconds time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+        BOOST_LOG_SEV(m_log, L_DEBUG) << "Prefetched " << files << " files with " << bytes / 1024 << "KiB of \"" << job.name << "\" in " << time.count() / 1000.0 << "ms.";
+
+        lock.lock();
+        m_running.clear();
+        ++m_statistics.jobs;
+        m_statistics.files += files;
+        m_statistics.bytes += bytes;
+    }
+}
+void Prefetcher::process(const Job &job, uint64_t &files, uint64_t &bytes)
+{
+    std::vector<Range> ranges = job.ranges;
+    if(!job.traceFile.empty() && !readTrace(job.traceFile, ranges)) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not read the prefetch trace \"" << job.traceFile << "\" of \"" << job.name << "\".";
+    }
+
+    for(const Range &range : ranges) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_stop)
+                return;
+        }
+        if(range.path.find_first_of("*?[") == std::string::npos) {
+            prefetchPath(range, files, bytes);
+            continue;
+        }
+
+        glob_t matches;
+        if(glob(range.path.c_str(), GLOB_NOSORT, nullptr, &matches) == 0) {
+            for(std::size_t i = 0; i < matches.gl_pathc; ++i) {
+                Range match = range;
+                match.path = matches.gl_pathv[i];
+                prefetchPath(match, files, bytes);
+            }
+        }
+        globfree(&matches);
+    }
+}
+void Prefetcher::prefetchPath(const Range &range, uint64_t &files, uint64_t &bytes)
+{
+    boost::system::error_code ec;
+    if(!boost::filesystem::is_directory(range.path, ec)) {
+        if(prefetchFile(range.path, range.offset, range.length, bytes))
+            ++files;
+        return;
+    }
+
+    boost::filesystem::recursive_directory_iterator it(range.path, ec), end;
+    for(; !ec && it != end; it.increment(ec)) {
+        if(boost::filesystem::is_regular_file(it->status()) && prefetchFile(it->path().string(), 0, 0, bytes))
+            ++files;
+    }
+}
+bool Prefetcher::prefetchFile(const std::string &path, uint64_t offset, uint64_t length, uint64_t &bytes)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || offset >= static_cast<uint64_t>(st.st_size)) {
+        close(fd);
+        return false;
+    }
+    if(length == 0 || offset + length > static_cast<uint64_t>(st.st_size))
+        length = st.st_size - offset;
+
+    // readahead() waits until the reads are submitted, which paces the thread.
+    if(readahead(fd, offset, length) != 0) {
+        posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+    }
+    close(fd);
+    bytes += length;
+    return true;
+}
+}
+}
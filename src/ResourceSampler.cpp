@@ -0,0 +1,204 @@
+#include <piga/daemon/ResourceSampler.hpp>
+#include <unistd.h>
+#include <errno.h>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+namespace piga
+{
+namespace daemon
+{
+namespace
+{
+/**
+ * @brief Parses a decimal counter. Runs on the main loop, so it must not throw on odd input.
+ */
+bool parseCounter(const std::string &str, uint64_t &value)
+{
+    const char *begin = str.c_str();
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long parsed = std::strtoull(begin, &end, 10);
+    if(end == begin || errno != 0)
+        return false;
+    value = parsed;
+    return true;
+}
+}
+
+ResourceSampler::ResourceSampler(std::size_t capacity)
+    : m_capacity(std::max<std::size_t>(capacity, 1))
+{
+
+}
+void ResourceSampler::setCapacity(std::size_t capacity)
+{
+    m_capacity = std::max<std::size_t>(capacity, 1);
+    m_samples.clear();
+    m_samples.shrink_to_fit();
+    m_next = 0;
+}
+void ResourceSampler::reset()
+{
+    m_samples.clear();
+    m_next = 0;
+    m_hasLast = false;
+}
+bool ResourceSampler::sample(pid_t pid, const std::string &cgroupProcs)
+{
+    Counters counters;
+    counters.time = std::chrono::steady_clock::now();
+    if(!readProcess(pid, counters))
+        return false;
+    if(!cgroupProcs.empty()) {
+        // The cgroup also covers the children, it is preferred if available.
+        readCgroup(cgroupProcs.substr(0, cgroupProcs.find_last_of('/')), counters);
+    }
+
+    if(!m_hasLast) {
+        m_last = counters;
+        m_hasLast = true;
+        return true;
+    }
+
+    double seconds = std::chrono::duration<double>(counters.time - m_last.time).count();
+    if(seconds <= 0)
+        return true;
+
+    // Counters of a restarted app or a changed cgroup may go backwards.
+    auto rate = [seconds](uint64_t current, uint64_t last) {
+        return current >= last ? (current - last) / seconds : 0.0;
+    };
+
+    Sample sample;
+    sample.time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    sample.cpu = rate(counters.cpuNs, m_last.cpuNs) / 1e7;
+    sample.memory = counters.memory;
+    sample.readRate = rate(counters.readBytes, m_last.readBytes);
+    sample.writeRate = rate(counters.writeBytes, m_last.writeBytes);
+    sample.voluntarySwitches = rate(counters.voluntarySwitches, m_last.voluntarySwitches);
+    sample.involuntarySwitches = rate(counters.involuntarySwitches, m_last.involuntarySwitches);
+    sample.runDelay = rate(counters.runDelayNs, m_last.runDelayNs) / 1e7;
+    m_last = counters;
+
+    if(m_samples.size() < m_capacity) {
+        m_samples.push_back(sample);
+    } else {
+        m_samples[m_next] = sample;
+        m_next = (m_next + 1) % m_capacity;
+    }
+    return true;
+}
+bool ResourceSampler::hasSamples() const
+{
+    return !m_samples.empty();
+}
+const ResourceSampler::Sample &ResourceSampler::getCurrent() const
+{
+    // Before the ring is full, m_next stays 0 and the last sample is at the end.
+    return m_samples[(m_next + m_samples.size() - 1) % m_samples.size()];
+}
+std::vector<ResourceSampler::Sample> ResourceSampler::getHistory() const
+{
+    std::vector<Sample> history;
+    history.reserve(m_samples.size());
+    for(std::size_t i = 0; i < m_samples.size(); ++i) {
+        history.push_back(m_samples[(m_next + i) % m_samples.size()]);
+    }
+    return history;
+}
+bool ResourceSampler::readProcess(pid_t pid, Counters &counters)
+{
+    std::string base = "/proc/" + std::to_string(pid);
+
+    // The name in the second field may contain spaces, the fields after it do not.
+    std::ifstream statFile(base + "/stat");
+    std::string stat;
+    if(!std::getline(statFile, stat))
+        return false;
+    std::size_t nameEnd = stat.rfind(')');
+    if(nameEnd == std::string::npos)
+        return false;
+    std::istringstream fields(stat.substr(nameEnd + 2));
+    std::string field;
+    uint64_t utime = 0, stime = 0;
+    // utime and stime are the fields 14 and 15, the state (3) is the first one here.
+    for(int i = 3; i <= 15 && fields >> field; ++i) {
+        if(i == 14 && !parseCounter(field, utime))
+            return false;
+        else if(i == 15 && !parseCounter(field, stime))
+            return false;
+    }
+    counters.cpuNs = (utime + stime) * 1000000000ull / sysconf(_SC_CLK_TCK);
+
+    std::ifstream statm(base + "/statm");
+    uint64_t size = 0, resident = 0;
+    if(statm >> size >> resident)
+        counters.memory = resident * sysconf(_SC_PAGESIZE);
+
+    std::ifstream io(base + "/io");
+    std::string key;
+    uint64_t value = 0;
+    while(io >> key >> value) {
+        if(key == "read_bytes:")
+            counters.readBytes = value;
+        else if(key == "write_bytes:")
+            counters.writeBytes = value;
+    }
+
+    std::ifstream status(base + "/status");
+    std::string line;
+    while(std::getline(status, line)) {
+        if(line.compare(0, 24, "voluntary_ctxt_switches:") == 0)
+            parseCounter(line.substr(24), counters.voluntarySwitches);
+        else if(line.compare(0, 27, "nonvoluntary_ctxt_switches:") == 0)
+            parseCounter(line.substr(27), counters.involuntarySwitches);
+    }
+
+    // Time on the cpu, time waiting on a run queue and the number of time slices.
+    std::ifstream schedstat(base + "/schedstat");
+    uint64_t runNs = 0;
+    schedstat >> runNs >> counters.runDelayNs;
+    return true;
+}
+bool ResourceSampler::readCgroup(const std::string &group, Counters &counters)
+{
+    std::ifstream cpuStat(group + "/cpu.stat");
+    std::string key;
+    uint64_t value = 0;
+    while(cpuStat >> key >> value) {
+        if(key == "usage_usec") {
+            counters.cpuNs = value * 1000;
+            break;
+        }
+    }
+
+    std::ifstream memory(group + "/memory.current");
+    uint64_t current = 0;
+    if(memory >> current)
+        counters.memory = current;
+
+    // One line per device: "major:minor rbytes=... wbytes=... rios=... ...".
+    std::ifstream ioStat(group + "/io.stat");
+    std::string line;
+    uint64_t readBytes = 0, writeBytes = 0, bytes = 0;
+    while(std::getline(ioStat, line)) {
+        std::istringstream entries(line);
+        std::string entry;
+        while(entries >> entry) {
+            if(entry.compare(0, 7, "rbytes=") == 0 && parseCounter(entry.substr(7), bytes))
+                readBytes += bytes;
+            else if(entry.compare(0, 7, "wbytes=") == 0 && parseCounter(entry.substr(7), bytes))
+                writeBytes += bytes;
+        }
+    }
+    if(ioStat.eof()) {
+        counters.readBytes = readBytes;
+        counters.writeBytes = writeBytes;
+    }
+    return true;
+}
+}
+}
@@ -0,0 +1,222 @@
+#include <piga/daemon/Scheduler.hpp>
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+
+namespace piga
+{
+namespace daemon
+{
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::duration_cast;
+
+Scheduler::Scheduler(std::shared_ptr<boost::asio::io_service> io_service)
+    : m_io_service(io_service),
+      m_timer(*io_service),
+      m_epoch(Clock::now()),
+      m_wheel(WheelSize),
+      m_log(bl::keywords::channel = "Class:Scheduler")
+{
+
+}
+Scheduler::~Scheduler()
+{
+    boost::system::error_code ec;
+    m_timer.cancel(ec);
+}
+Scheduler::Handle Scheduler::add(const std::string &name, microseconds period, Scheduler::Task task)
+{
+    if(period <= microseconds(0)) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Task \"" << name << "\" has an invalid period of " << period.count() << "us. Using 1ms instead.";
+        period = milliseconds(1);
+    }
+
+    Handle handle = m_nextHandle++;
+    Entry &entry = m_entries[handle];
+    entry.name = name;
+    entry.period = period;
+    entry.deadline = Clock::now() + period;
+    entry.task = task;
+
+    insert(handle, entry);
+    arm();
+
+    BOOST_LOG_SEV(m_log, L_DEBUG) << "Registered task \"" << name << "\" with a period of " << period.count() << "us.";
+
+    return handle;
+}
+void Scheduler::remove(Scheduler::Handle handle)
+{
+    // The wheel still references the handle, these entries are dropped when their slot is visited.
+    m_entries.erase(handle);
+}
+void Scheduler::reschedule(Scheduler::Handle handle, microseconds period)
+{
+    auto it = m_entries.find(handle);
+    if(it == m_entries.end())
+        return;
+
+    Entry &entry = it->second;
+    entry.period = period;
+    entry.deadline = Clock::now() + period;
+    entry.rescheduled = true;
+
+    insert(handle, entry);
+    arm();
+}
+Scheduler::Statistics Scheduler::getStatistics(Scheduler::Handle handle) const
+{
+    auto it = m_entries.find(handle);
+    if(it == m_entries.end())
+        return Statistics();
+    return it->second.statistics;
+}
+std::vector<std::pair<std::string, Scheduler::Statistics>> Scheduler::getAllStatistics() const
+{
+    std::vector<std::pair<std::string, Statistics>> statistics;
+    for(auto &it : m_entries) {
+        statistics.push_back(std::make_pair(it.second.name, it.second.statistics));
+    }
+    return statistics;
+}
+void Scheduler::logStatistics()
+{
+    for(auto &it : m_entries) {
+        const Statistics &s = it.second.statistics;
+        BOOST_LOG_SEV(m_log, L_INFO) << "Task \"" << it.second.name << "\" (period " << it.second.period.count() << "us): "
+            << s.runs << " runs, " << s.overruns << " overruns, " << s.missedDeadlines << " missed deadlines, "
+            << "max lateness " << s.maxLateness.count() << "us, max runtime " << s.maxRuntime.count() << "us.";
+    }
+}
+int64_t Scheduler::toTick(Clock::time_point time) const
+{
+    return duration_cast<milliseconds>(time - m_epoch).count();
+}
+void Scheduler::insert(Scheduler::Handle handle, Scheduler::Entry &entry)
+{
+    // Older slot entries of this handle become stale through the new generation.
+    ++entry.generation;
+
+    int64_t tick = std::max(toTick(entry.deadline), m_currentTick);
+    m_wheel[tick % WheelSize].push_back(SlotEntry(handle, entry.generation));
+}
+void Scheduler::arm()
+{
+    if(m_entries.empty())
+        return;
+
+    // Search the first slot with a task due in this revolution of the wheel.
+    bool found = false;
+    Clock::time_point next;
+    for(std::size_t offset = 0; offset < WheelSize && !found; ++offset) {
+        int64_t tick = m_currentTick + offset;
+        for(const SlotEntry &slotEntry : m_wheel[tick % WheelSize]) {
+            auto it = m_entries.find(slotEntry.first);
+            if(it == m_entries.end() || it->second.generation != slotEntry.second)
+                continue;
+            if(toTick(it->second.deadline) > tick)
+                continue;
+            if(!found || it->second.deadline < next) {
+                next = it->second.deadline;
+                found = true;
+            }
+        }
+    }
+    if(!found) {
+        // All tasks are further away than one revolution.
+        next = m_entries.begin()->second.deadline;
+        for(auto &it : m_entries) {
+            next = std::min(next, it.second.deadline);
+        }
+    }
+
+    if(m_armed && m_armedFor <= next)
+        return;
+
+    m_armed = true;
+    m_armedFor = next;
+    m_timer.expires_at(next);
+    m_timer.async_wait(std::bind(&Scheduler::expired, this, std::placeholders::_1));
+}
+void Scheduler::expired(const boost::system::error_code &error)
+{
+    if(error) {
+        // The timer was re-armed for an earlier deadline or the scheduler is shutting down.
+        return;
+    }
+    m_armed = false;
+
+    Clock::time_point now = Clock::now();
+    int64_t nowTick = toTick(now);
+
+    // Collect every due task from the slots passed since the last expiry.
+    std::vector<std::pair<Clock::time_point, Handle>> due;
+    int64_t lastTick = std::min(nowTick, m_currentTick + static_cast<int64_t>(WheelSize) - 1);
+    for(int64_t tick = m_currentTick; tick <= lastTick; ++tick) {
+        std::vector<SlotEntry> &slot = m_wheel[tick % WheelSize];
+        std::vector<SlotEntry> remaining;
+        for(const SlotEntry &slotEntry : slot) {
+            auto it = m_entries.find(slotEntry.first);
+            if(it == m_entries.end() || it->second.generation != slotEntry.second)
+                continue;
+            if(it->second.deadline <= now) {
+                due.push_back(std::make_pair(it->second.deadline, slotEntry.first));
+            } else {
+                remaining.push_back(slotEntry);
+            }
+        }
+        slot.swap(remaining);
+    }
+    m_currentTick = nowTick;
+
+    std::sort(due.begin(), due.end());
+    for(auto &d : due) {
+        // Earlier tasks may have removed this one.
+        auto it = m_entries.find(d.second);
+        if(it != m_entries.end()) {
+            run(d.second, it->second, now);
+        }
+    }
+
+    arm();
+}
+void Scheduler::run(Scheduler::Handle handle, Scheduler::Entry &entry, Clock::time_point now)
+{
+    microseconds lateness = duration_cast<microseconds>(now - entry.deadline);
+    entry.rescheduled = false;
+
+    // The task may remove itself, so it is copied before running it.
+    Task task = entry.task;
+    Clock::time_point start = Clock::now();
+    task();
+    Clock::time_point end = Clock::now();
+
+    auto it = m_entries.find(handle);
+    if(it == m_entries.end())
+        return;
+    Entry &e = it->second;
+
+    microseconds runtime = duration_cast<microseconds>(end - start);
+    ++e.statistics.runs;
+    e.statistics.maxLateness = std::max(e.statistics.maxLateness, lateness);
+    e.statistics.maxRuntime = std::max(e.statistics.maxRuntime, runtime);
+    if(runtime > e.period) {
+        ++e.statistics.overruns;
+    }
+
+    if(e.rescheduled) {
+        // The task chose its next deadline itself and is already in the wheel.
+        return;
+    }
+
+    // Advance on the absolute timeline, skipping runs which are already in the past.
+    e.deadline += e.period;
+    if(e.deadline <= end) {
+        int64_t skipped = (end - e.deadline) / e.period + 1;
+        e.deadline += e.period * skipped;
+        e.statistics.missedDeadlines += skipped;
+    }
+    insert(handle, e);
+}
+}
+}
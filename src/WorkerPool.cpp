@@ -0,0 +1,96 @@
+#include <piga/daemon/WorkerPool.hpp>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+#include <exception>
+
+namespace piga
+{
+namespace daemon
+{
+namespace
+{
+struct Batch {
+    std::function<void(std::size_t)> function;
+    std::size_t count = 0;
+    std::atomic<std::size_t> next;
+    std::size_t finished = 0;
+    /// The first exception of a call, rethrown by parallelFor().
+    std::exception_ptr exception;
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+void work(std::shared_ptr<Batch> batch)
+{
+    std::size_t i;
+    while((i = batch->next++) < batch->count) {
+        std::exception_ptr exception;
+        try {
+            batch->function(i);
+        }
+        catch(...) {
+            exception = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        if(exception && !batch->exception)
+            batch->exception = exception;
+        if(++batch->finished == batch->count)
+            batch->done.notify_all();
+    }
+}
+}
+
+const unsigned int WorkerPool::MaxThreads;
+
+WorkerPool::WorkerPool(unsigned int threads)
+    : m_io_service(std::make_shared<boost::asio::io_service>()),
+      m_work(std::make_shared<boost::asio::io_service::work>(*m_io_service))
+{
+    if(threads == 0) {
+        threads = std::max(1u, std::min(std::thread::hardware_concurrency(), MaxThreads));
+    }
+    std::shared_ptr<boost::asio::io_service> io_service = m_io_service;
+    for(unsigned int i = 0; i < threads; ++i) {
+        m_threads.push_back(std::thread([io_service]() {
+            io_service->run();
+        }));
+    }
+}
+WorkerPool::~WorkerPool()
+{
+    m_work.reset();
+    for(auto &thread : m_threads) {
+        thread.join();
+    }
+}
+void WorkerPool::parallelFor(std::size_t count, std::function<void(std::size_t)> function)
+{
+    if(count == 0)
+        return;
+
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->function = function;
+    batch->count = count;
+    batch->next = 0;
+
+    // The calling thread works on the batch too, so one helper less is needed.
+    std::size_t helpers = std::min<std::size_t>(m_threads.size(), count - 1);
+    for(std::size_t i = 0; i < helpers; ++i) {
+        m_io_service->post(std::bind(&work, batch));
+    }
+    work(batch);
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->done.wait(lock, [batch]() { return batch->finished == batch->count; });
+    if(batch->exception)
+        std::rethrow_exception(batch->exception);
+}
+unsigned int WorkerPool::getThreadCount() const
+{
+    return m_threads.size();
+}
+}
+}
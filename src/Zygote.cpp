@@ -0,0 +1,415 @@
+#include <piga/daemon/Zygote.hpp>
+#include <piga/daemon/Doorbell.hpp>
+#include <piga/daemon/NotifySocket.hpp>
+#include <boost/log/trivial.hpp>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+extern char **environ;
+
+namespace piga
+{
+namespace daemon
+{
+namespace
+{
+typedef int (*AppEntry)(int, char**);
+
+void appendString(std::vector<char> &buffer, const char *str)
+{
+    buffer.insert(buffer.end(), str, str + std::strlen(str) + 1);
+}
+void appendList(std::vector<char> &buffer, char * const *list)
+{
+    std::size_t count = 0;
+    while(list[count] != nullptr)
+        ++count;
+    appendString(buffer, std::to_string(count).c_str());
+    for(std::size_t i = 0; i < count; ++i) {
+        appendString(buffer, list[i]);
+    }
+}
+
+/**
+ * Request layout, all fields NUL terminated:
+ * library, entry, working directory, uid (-1 to keep), argc, argv..., envc, envp...
+ */
+struct Request {
+    const char *library = nullptr;
+    const char *entry = nullptr;
+    const char *workingDirectory = nullptr;
+    long uid = -1;
+    std::vector<char*> argv;
+    std::vector<char*> envp;
+};
+
+bool nextString(char *&pos, char *end, char *&str)
+{
+    char *terminator = static_cast<char*>(std::memchr(pos, '\0', end - pos));
+    if(terminator == nullptr)
+        return false;
+    str = pos;
+    pos = terminator + 1;
+    return true;
+}
+bool nextList(char *&pos, char *end, std::vector<char*> &list)
+{
+    char *countStr;
+    if(!nextString(pos, end, countStr))
+        return false;
+    std::size_t count = std::strtoul(countStr, nullptr, 10);
+    list.clear();
+    for(std::size_t i = 0; i < count; ++i) {
+        char *str;
+        if(!nextString(pos, end, str))
+            return false;
+        list.push_back(str);
+    }
+    list.push_back(nullptr);
+    return true;
+}
+bool parseRequest(char *buffer, std::size_t length, Request &request)
+{
+    char *pos = buffer, *end = buffer + length;
+    char *library, *entry, *workingDirectory, *uid;
+    if(!nextString(pos, end, library) || !nextString(pos, end, entry)
+            || !nextString(pos, end, workingDirectory) || !nextString(pos, end, uid))
+        return false;
+    request.library = library;
+    request.entry = entry;
+    request.workingDirectory = workingDirectory;
+    request.uid = std::strtol(uid, nullptr, 10);
+    return nextList(pos, end, request.argv) && nextList(pos, end, request.envp);
+}
+
+// Runs in the forked app process and does not return.
+void launchApp(const Request &request)
+{
+    if(request.uid >= 0 && setuid(request.uid) != 0) {
+        BOOST_LOG_TRIVIAL(error) << "Zygote: could not set the uid " << request.uid << ": " << strerror(errno);
+        _exit(127);
+    }
+    if(request.workingDirectory[0] != '\0' && chdir(request.workingDirectory) != 0) {
+        BOOST_LOG_TRIVIAL(error) << "Zygote: could not change into \"" << request.workingDirectory << "\": " << strerror(errno);
+        _exit(127);
+    }
+    environ = const_cast<char**>(request.envp.data());
+
+    void *handle = dlopen(request.library, RTLD_NOW);
+    if(handle == nullptr) {
+        BOOST_LOG_TRIVIAL(error) << "Zygote: could not load the app library \"" << request.library << "\": " << dlerror();
+        _exit(127);
+    }
+    AppEntry entry = reinterpret_cast<AppEntry>(dlsym(handle, request.entry));
+    if(entry == nullptr) {
+        BOOST_LOG_TRIVIAL(error) << "Zygote: the app library \"" << request.library << "\" does not export \"" << request.entry << "\".";
+        _exit(127);
+    }
+
+    int argc = static_cast<int>(request.argv.size()) - 1;
+    exit(entry(argc, const_cast<char**>(request.argv.data())));
+}
+}
+
+// Bound to a reference by std::chrono::milliseconds, so it needs a definition.
+const int Zygote::ReplyTimeout;
+
+Zygote::Zygote(std::shared_ptr<boost::asio::io_service> io_service)
+    : m_io_service(io_service),
+      m_log(bl::keywords::channel = "Class:Zygote")
+{
+
+}
+Zygote::~Zygote()
+{
+    boost::system::error_code ec;
+    if(m_timeout) {
+        m_timeout->cancel(ec);
+    }
+    if(m_socket) {
+        // The zygote exits as soon as its socket is closed.
+        m_socket->close(ec);
+    }
+    if(m_pid > 0) {
+        waitpid(m_pid, nullptr, 0);
+    }
+}
+bool Zygote::start(const std::vector<std::string> &preload)
+{
+    if(isRunning())
+        return true;
+
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0) {
+        BOOST_LOG_SEV(m_log, L_ERROR) << "Could not create the socket of the zygote: " << strerror(errno);
+        return false;
+    }
+
+    char executable[4096];
+    ssize_t length = readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+    if(length <= 0) {
+        BOOST_LOG_SEV(m_log, L_ERROR) << "Could not find the daemon executable for the zygote: " << strerror(errno);
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    executable[length] = '\0';
+
+    LaunchPlan plan;
+    plan.setExecutable(executable);
+    plan.addArgument(executable);
+    plan.addArgument("--zygote");
+    plan.addArgument(std::to_string(fds[1]));
+    for(const std::string &library : preload) {
+        plan.addArgument("--preload");
+        plan.addArgument(library);
+    }
+    for(std::size_t i = 0; environ[i] != nullptr; ++i) {
+        plan.addEnvironment(environ[i]);
+    }
+    plan.addInheritedFd(fds[1]);
+    // The doorbell and the notify socket are handed down to the apps.
+    const char *doorbell = getenv(PIGA_DAEMON_DOORBELL_ENVVAR);
+    if(doorbell != nullptr) {
+        plan.addInheritedFd(std::atoi(doorbell));
+    }
+    const char *notify = getenv(PIGA_DAEMON_NOTIFY_ENVVAR);
+    if(notify != nullptr) {
+        plan.addInheritedFd(std::atoi(notify));
+    }
+    plan.finalize();
+
+    // Apps are forked by an intermediate process which exits right away. They are
+    // reparented to the daemon, so they are reaped and watched like directly started apps.
+    if(prctl(PR_SET_CHILD_SUBREAPER, 1) != 0) {
+        BOOST_LOG_SEV(m_log, L_WARN) << "Could not become a child subreaper, exits of zygote apps are not reported: " << strerror(errno);
+    }
+
+    int error = 0;
+    m_pid = plan.spawn(error);
+    close(fds[1]);
+    if(m_pid < 0) {
+        BOOST_LOG_SEV(m_log, L_ERROR) << "Could not start the zygote: " << strerror(error);
+        close(fds[0]);
+        return false;
+    }
+    m_socket.reset(new boost::asio::posix::stream_descriptor(*m_io_service, fds[0]));
+    m_timeout.reset(new boost::asio::steady_timer(*m_io_service));
+
+    BOOST_LOG_SEV(m_log, L_INFO) << "Started the zygote with pid " << m_pid << " and " << preload.size() << " preloaded libraries.";
+    return true;
+}
+bool Zygote::isRunning() const
+{
+    return m_socket != nullptr;
+}
+void Zygote::spawn(const LaunchPlan &plan, const std::string &library, const std::string &entry, SpawnHandler handler)
+{
+    if(!isRunning()) {
+        m_io_service->post(std::bind(handler, -1, ESRCH));
+        return;
+    }
+
+    std::vector<char> request;
+    appendString(request, library.c_str());
+    appendString(request, entry.c_str());
+    appendString(request, plan.getWorkingDirectory().c_str());
+    appendString(request, plan.hasUid() ? std::to_string(plan.getUid()).c_str() : "-1");
+    appendList(request, plan.getArguments());
+    appendList(request, plan.getEnvironment());
+
+    if(request.size() > MaxRequestSize) {
+        m_io_service->post(std::bind(handler, -1, E2BIG));
+        return;
+    }
+    m_requests.push_back(std::move(request));
+    m_handlers.push_back(handler);
+    sendRequests();
+}
+void Zygote::sendRequests()
+{
+    bool waiting = m_handlers.size() > m_requests.size();
+    while(!m_requests.empty()) {
+        const std::vector<char> &request = m_requests.front();
+        if(send(m_socket->native_handle(), request.data(), request.size(), MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                // The zygote is busy, the timeout of the sent requests is already running.
+                if(!m_writing)
+                    asyncWrite();
+                return;
+            }
+            handleDeath(errno);
+            return;
+        }
+        m_requests.pop_front();
+    }
+    if(!waiting)
+        armTimeout();
+    if(!m_reading)
+        asyncRead();
+}
+void Zygote::readReplies()
+{
+    while(m_handlers.size() > m_requests.size()) {
+        Reply reply;
+        ssize_t length = recv(m_socket->native_handle(), &reply, sizeof(reply), MSG_DONTWAIT);
+        if(length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            asyncRead();
+            return;
+        }
+        if(length != sizeof(reply)) {
+            handleDeath(length < 0 ? errno : EPROTO);
+            return;
+        }
+
+        SpawnHandler handler = m_handlers.front();
+        m_handlers.pop_front();
+        // The next reply gets the full time again.
+        boost::system::error_code ec;
+        if(m_handlers.size() > m_requests.size())
+            armTimeout();
+        else
+            m_timeout->cancel(ec);
+
+        if(reply.pid > 0)
+            handler(reply.pid, 0);
+        else
+            handler(-1, reply.error != 0 ? reply.error : EPROTO);
+        // The handler may have sent a request which failed.
+        if(!isRunning())
+            return;
+    }
+}
+void Zygote::asyncWrite()
+{
+    m_writing = true;
+    m_socket->async_write_some(boost::asio::null_buffers(),
+        [this](const boost::system::error_code &error, std::size_t) {
+            if(error)
+                return;
+            m_writing = false;
+            sendRequests();
+        });
+}
+void Zygote::asyncRead()
+{
+    m_reading = true;
+    m_socket->async_read_some(boost::asio::null_buffers(),
+        [this](const boost::system::error_code &error, std::size_t) {
+            if(error)
+                return;
+            m_reading = false;
+            readReplies();
+        });
+}
+void Zygote::armTimeout()
+{
+    m_timeout->expires_from_now(std::chrono::milliseconds(ReplyTimeout));
+    m_timeout->async_wait([this](const boost::system::error_code &error) {
+        if(error)
+            return;
+        handleDeath(ETIMEDOUT);
+    });
+}
+void Zygote::handleDeath(int error)
+{
+    BOOST_LOG_SEV(m_log, L_ERROR) << "The zygote does not respond anymore (" << strerror(error) << "), apps are started directly from now on.";
+    boost::system::error_code ec;
+    m_timeout->cancel(ec);
+    m_socket->close(ec);
+    m_socket.reset();
+    m_writing = false;
+    m_reading = false;
+    if(m_pid > 0) {
+        kill(m_pid, SIGKILL);
+        m_pid = -1;
+    }
+
+    // The apps of the open requests are started directly by their handlers.
+    m_requests.clear();
+    for(const SpawnHandler &handler : m_handlers) {
+        m_io_service->post(std::bind(handler, -1, error));
+    }
+    m_handlers.clear();
+}
+int Zygote::run(int fd, const std::vector<std::string> &preload)
+{
+    // The zygote is useless without the daemon.
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    signal(SIGCHLD, SIG_DFL);
+
+    std::size_t loaded = 0;
+    for(const std::string &library : preload) {
+        if(dlopen(library.c_str(), RTLD_NOW | RTLD_GLOBAL) != nullptr) {
+            ++loaded;
+        } else {
+            BOOST_LOG_TRIVIAL(warning) << "Zygote: could not preload \"" << library << "\": " << dlerror();
+        }
+    }
+    BOOST_LOG_TRIVIAL(info) << "Zygote: preloaded " << loaded << " of " << preload.size() << " libraries, waiting for requests.";
+
+    std::vector<char> buffer(MaxRequestSize);
+    for(;;) {
+        ssize_t length = recv(fd, buffer.data(), buffer.size(), 0);
+        if(length == 0)
+            return 0;
+        if(length < 0) {
+            if(errno == EINTR)
+                continue;
+            return 1;
+        }
+
+        Reply reply;
+        reply.pid = -1;
+        reply.error = 0;
+
+        Request request;
+        int pipeFds[2];
+        if(!parseRequest(buffer.data(), length, request)) {
+            reply.error = EINVAL;
+        } else if(pipe2(pipeFds, O_CLOEXEC) != 0) {
+            reply.error = errno;
+        } else {
+            pid_t intermediate = fork();
+            if(intermediate == 0) {
+                close(pipeFds[0]);
+                pid_t app = fork();
+                if(app == 0) {
+                    close(pipeFds[1]);
+                    close(fd);
+                    launchApp(request);
+                }
+                int32_t result[2] = {app, app < 0 ? errno : 0};
+                ssize_t written = write(pipeFds[1], result, sizeof(result));
+                (void) written;
+                _exit(0);
+            }
+            close(pipeFds[1]);
+            if(intermediate < 0) {
+                reply.error = errno;
+            } else {
+                int32_t result[2] = {-1, EPROTO};
+                ssize_t r = read(pipeFds[0], result, sizeof(result));
+                (void) r;
+                // Once the intermediate is reaped, the app is reparented to the daemon.
+                waitpid(intermediate, nullptr, 0);
+                reply.pid = result[0];
+                reply.error = result[1];
+            }
+            close(pipeFds[0]);
+        }
+
+        send(fd, &reply, sizeof(reply), MSG_NOSIGNAL);
+    }
+}
+}
+}
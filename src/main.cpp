@@ -3,6 +3,7 @@
 
 #include <boost/log/trivial.hpp>
 #include <piga/daemon/Daemon.hpp>
+#include <piga/daemon/Zygote.hpp>
 
 #include <iostream>
 using std::cout;
@@ -27,6 +28,8 @@ int main(int argc, char *argv[], char** envp)
         desc.add_options()
             ("help", "produce help message")
             ("sample-app-config", po::value<std::string>(), "generate a sample App-config to the specified output.")
+            ("zygote", po::value<int>(), "internal: run as the app zygote of a daemon, which is connected through the given fd.")
+            ("preload", po::value<std::vector<std::string>>()->composing(), "internal: library preloaded by the zygote.")
         ;
 
         po::variables_map vm;
@@ -42,6 +45,13 @@ int main(int argc, char *argv[], char** envp)
             App::generateSampleConfig(output);
             return 0;
         }
+        else if(vm.count("zygote")) {
+            std::vector<std::string> preload;
+            if(vm.count("preload")) {
+                preload = vm["preload"].as<std::vector<std::string>>();
+            }
+            return Zygote::run(vm["zygote"].as<int>(), preload);
+        }
     }
     catch(const std::exception& e) {
         BOOST_LOG_TRIVIAL(error) << "Could not parse command line options: " << e.what();
@@ -0,0 +1,136 @@
+#include <piga/daemon/AppCatalog.hpp>
+#include <piga/daemon/App.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <unistd.h>
+
+#include "TestHelpers.hpp"
+
+using namespace piga::daemon;
+using namespace piga::daemon::tests;
+
+namespace
+{
+/**
+ * @brief One app directory and the path of a catalog file next to it.
+ */
+struct Fixture {
+    Fixture()
+        : appPath(directory.path + "/apps/app"),
+          cacheFile(directory.path + "/cache/catalog.bin")
+    {
+        writeConfig("[\"service\"]");
+    }
+    /**
+     * @brief Writes a config which differs from the defaults in every key the catalog stores.
+     */
+    void writeConfig(const std::string &requires)
+    {
+        writeAppConfig(appPath, {{"autostart", "true"},
+                                 {"run_as_root", "false"},
+                                 {"wait_for_signal", "true"},
+                                 {"restart_on_crash", "true"},
+                                 {"requires", requires},
+                                 {"after", "[\"menu\"]"}},
+                       {{"executable", "\"./app\""},
+                        {"arguments", "[\"--fullscreen\"]"},
+                        {"working_directory", "\"data\""}});
+    }
+    /**
+     * @brief Parses the app into a new catalog file.
+     */
+    void storeApp()
+    {
+        std::shared_ptr<AppCatalog> catalog = std::make_shared<AppCatalog>(cacheFile);
+        BOOST_CHECK(!catalog->load(getuid()));
+        App app(directory.path + "/apps/", getuid());
+        app.setCatalog(catalog);
+        app.loadFromPath(appPath, false);
+        BOOST_REQUIRE(app.isInstalled());
+        BOOST_REQUIRE(catalog->save());
+        BOOST_REQUIRE(boost::filesystem::exists(cacheFile));
+    }
+
+    TemporaryDirectory directory;
+    std::string appPath;
+    std::string cacheFile;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(AppCatalogTest, Fixture)
+
+BOOST_AUTO_TEST_CASE(RestoresStoredApps)
+{
+    storeApp();
+
+    AppCatalog catalog(cacheFile);
+    BOOST_REQUIRE(catalog.load(getuid()));
+    App app(directory.path + "/apps/", getuid());
+    BOOST_REQUIRE(catalog.restore(app, appPath));
+
+    BOOST_CHECK_EQUAL(app.getName(), "app");
+    BOOST_CHECK(app.isAutostart());
+    BOOST_CHECK(app.shouldWaitForSignal());
+    BOOST_CHECK(app.restartOnCrash());
+    BOOST_CHECK(!app.restartOnExit());
+    BOOST_CHECK_EQUAL(app.getExecutable(), "./app");
+    BOOST_CHECK_EQUAL(app.getWorkingDir(), "data");
+    BOOST_REQUIRE_EQUAL(app.getRequires().size(), 1u);
+    BOOST_CHECK_EQUAL(app.getRequires()[0], "service");
+    BOOST_REQUIRE_EQUAL(app.getAfter().size(), 1u);
+    BOOST_CHECK_EQUAL(app.getAfter()[0], "menu");
+}
+
+BOOST_AUTO_TEST_CASE(DropsChangedConfigs)
+{
+    storeApp();
+    writeConfig("[\"service\", \"network\"]");
+
+    AppCatalog catalog(cacheFile);
+    BOOST_REQUIRE(catalog.load(getuid()));
+    App app(directory.path + "/apps/", getuid());
+    BOOST_CHECK(!catalog.restore(app, appPath));
+}
+
+BOOST_AUTO_TEST_CASE(DropsCachesOfOtherDefaults)
+{
+    storeApp();
+
+    AppCatalog catalog(cacheFile);
+    BOOST_CHECK(!catalog.load(getuid() + 1));
+    App app(directory.path + "/apps/", getuid() + 1);
+    BOOST_CHECK(!catalog.restore(app, appPath));
+}
+
+BOOST_AUTO_TEST_CASE(DropsRemovedApps)
+{
+    storeApp();
+    {
+        // Nothing is restored or stored, so the app is gone.
+        AppCatalog catalog(cacheFile);
+        BOOST_REQUIRE(catalog.load(getuid()));
+        BOOST_REQUIRE(catalog.save());
+    }
+
+    AppCatalog catalog(cacheFile);
+    BOOST_REQUIRE(catalog.load(getuid()));
+    App app(directory.path + "/apps/", getuid());
+    BOOST_CHECK(!catalog.restore(app, appPath));
+}
+
+BOOST_AUTO_TEST_CASE(IgnoresCorruptCaches)
+{
+    boost::filesystem::create_directories(directory.path + "/cache");
+    {
+        std::ofstream cache(cacheFile, std::ios::binary);
+        cache << "not a catalog";
+    }
+
+    AppCatalog catalog(cacheFile);
+    BOOST_CHECK(!catalog.load(getuid()));
+    App app(directory.path + "/apps/", getuid());
+    BOOST_CHECK(!catalog.restore(app, appPath));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
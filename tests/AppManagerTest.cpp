@@ -0,0 +1,115 @@
+#include <piga/daemon/AppManager.hpp>
+#include <boost/test/unit_test.hpp>
+#include <unistd.h>
+
+#include "TestHelpers.hpp"
+
+using namespace piga::daemon;
+using namespace piga::daemon::tests;
+
+namespace
+{
+/**
+ * @brief An app directory with apps which only sleep, started without a reaper.
+ */
+struct Fixture {
+    ~Fixture()
+    {
+        // The apps are killed before their directories are removed.
+        manager.reset();
+    }
+    void addApp(const std::string &name, const ConfigValues &values, const ConfigValues &execution = ConfigValues())
+    {
+        writeAppConfig(directory.path + "/" + name, values, execution);
+    }
+    void startApps()
+    {
+        manager.reset(new AppManager(directory.path, getuid()));
+        manager->reload(directory.path);
+    }
+    bool isRunning(const std::string &name)
+    {
+        AppManager::AppPtr app = manager->getApp(name);
+        BOOST_REQUIRE(app);
+        return app->isRunning();
+    }
+
+    TemporaryDirectory directory;
+    std::unique_ptr<AppManager> manager;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(AppManagerTest, Fixture)
+
+BOOST_AUTO_TEST_CASE(StartsRequiredApps)
+{
+    addApp("client", {{"autostart", "true"}, {"requires", "[\"service\"]"}});
+    addApp("service", {});
+    addApp("unrelated", {});
+    startApps();
+
+    BOOST_CHECK(isRunning("client"));
+    BOOST_CHECK(isRunning("service"));
+    BOOST_CHECK(!isRunning("unrelated"));
+}
+
+BOOST_AUTO_TEST_CASE(WaitsUntilRequiredAppsAreReady)
+{
+    addApp("client", {{"autostart", "true"}, {"requires", "[\"service\"]"}});
+    addApp("service", {{"wait_for_signal", "true"}});
+    startApps();
+
+    BOOST_CHECK(isRunning("service"));
+    BOOST_CHECK(!isRunning("client"));
+
+    manager->readySignalReceived();
+    BOOST_CHECK(isRunning("client"));
+}
+
+BOOST_AUTO_TEST_CASE(DoesNotStartCycles)
+{
+    addApp("a", {{"autostart", "true"}, {"requires", "[\"b\"]"}});
+    addApp("b", {{"autostart", "true"}, {"requires", "[\"c\"]"}});
+    addApp("c", {{"requires", "[\"a\"]"}});
+    addApp("independent", {{"autostart", "true"}});
+    startApps();
+
+    BOOST_CHECK(!isRunning("a"));
+    BOOST_CHECK(!isRunning("b"));
+    BOOST_CHECK(!isRunning("c"));
+    BOOST_CHECK(isRunning("independent"));
+}
+
+BOOST_AUTO_TEST_CASE(DoesNotStartAppsWithFailedRequirements)
+{
+    addApp("missing-client", {{"autostart", "true"}, {"requires", "[\"missing\"]"}});
+    addApp("broken-client", {{"autostart", "true"}, {"requires", "[\"broken\"]"}});
+    addApp("broken", {}, {{"executable", "\"/nonexistent/executable\""}});
+    addApp("transitive-client", {{"autostart", "true"}, {"requires", "[\"broken-client\"]"}});
+    startApps();
+
+    BOOST_CHECK(!isRunning("missing-client"));
+    BOOST_CHECK(!isRunning("broken"));
+    BOOST_CHECK(!isRunning("broken-client"));
+    BOOST_CHECK(!isRunning("transitive-client"));
+}
+
+BOOST_AUTO_TEST_CASE(OrderingDoesNotStartOtherApps)
+{
+    addApp("late", {{"autostart", "true"}, {"after", "[\"early\"]"}});
+    addApp("early", {});
+    addApp("waiting", {{"autostart", "true"}, {"after", "[\"starting\"]"}});
+    addApp("starting", {{"autostart", "true"}, {"wait_for_signal", "true"}});
+    startApps();
+
+    BOOST_CHECK(isRunning("late"));
+    BOOST_CHECK(!isRunning("early"));
+
+    // Ordered after an app of the same run, which is not ready yet.
+    BOOST_CHECK(isRunning("starting"));
+    BOOST_CHECK(!isRunning("waiting"));
+    manager->readySignalReceived();
+    BOOST_CHECK(isRunning("waiting"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,84 @@
+#include <piga/daemon/App.hpp>
+#include <piga/daemon/ChildReaper.hpp>
+#include <piga/daemon/Zygote.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <unistd.h>
+
+#include "TestHelpers.hpp"
+
+using namespace piga::daemon;
+using namespace piga::daemon::tests;
+
+BOOST_AUTO_TEST_SUITE(AppTest)
+
+BOOST_AUTO_TEST_CASE(RestartDelayGrowsExponentially)
+{
+    App::RestartPolicy policy;
+    policy.jitter = 0.0;
+    BOOST_CHECK_CLOSE(policy.getDelay(0, 0.5), 500.0, 0.001);
+    BOOST_CHECK_CLOSE(policy.getDelay(1, 0.5), 1000.0, 0.001);
+    BOOST_CHECK_CLOSE(policy.getDelay(2, 0.5), 2000.0, 0.001);
+    BOOST_CHECK_CLOSE(policy.getDelay(5, 0.5), 16000.0, 0.001);
+
+    policy.multiplier = 1.0;
+    BOOST_CHECK_CLOSE(policy.getDelay(5, 0.5), 500.0, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(RestartDelayIsCapped)
+{
+    App::RestartPolicy policy;
+    policy.jitter = 0.0;
+    BOOST_CHECK_CLOSE(policy.getDelay(6, 0.5), 30000.0, 0.001);
+
+    // The growth overflows to infinity long before the attempts do.
+    double delay = policy.getDelay(100000, 0.5);
+    BOOST_CHECK(std::isfinite(delay));
+    BOOST_CHECK_CLOSE(delay, 30000.0, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(RestartDelayIsJittered)
+{
+    App::RestartPolicy policy;
+    policy.jitter = 0.2;
+    BOOST_CHECK_CLOSE(policy.getDelay(0, 0.0), 400.0, 0.001);
+    BOOST_CHECK_CLOSE(policy.getDelay(0, 0.5), 500.0, 0.001);
+    BOOST_CHECK_CLOSE(policy.getDelay(0, 1.0), 600.0, 0.001);
+
+    // The jitter is applied after the cap, so capped delays still differ.
+    BOOST_CHECK_CLOSE(policy.getDelay(10, 0.0), 24000.0, 0.001);
+    BOOST_CHECK_CLOSE(policy.getDelay(10, 1.0), 36000.0, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(ZygoteRestartIsScheduledOnce)
+{
+    TemporaryDirectory directory;
+    writeAppConfig(directory.path + "/crasher", {{"restart_on_crash", "true"},
+                                                 {"restart", "{ initial_delay = 10; multiplier = 1.0; jitter = 0.0; max_restarts = 3; window = 60000; }"}},
+                   {{"executable", "\"/bin/false\""},
+                    {"zygote_library", std::string("\"") + PIGA_DAEMON_TEST_APP + "\""}});
+
+    std::shared_ptr<boost::asio::io_service> io_service = std::make_shared<boost::asio::io_service>();
+    std::shared_ptr<ChildReaper> reaper = std::make_shared<ChildReaper>(io_service);
+    // The zygote forks the apps from an intermediate process, so they are orphans.
+    reaper->setReapOrphans(true);
+    std::shared_ptr<Zygote> zygote = std::make_shared<Zygote>(io_service);
+    BOOST_REQUIRE(zygote->start({}));
+
+    App app(directory.path + "/", getuid(), nullptr, reaper, zygote);
+    app.loadFromPath(directory.path + "/crasher", false);
+    BOOST_REQUIRE(app.isInstalled());
+
+    app.start();
+    BOOST_CHECK(app.isStarting());
+    BOOST_CHECK(runUntil(*io_service, [&app]() { return app.isRestartTripped(); }, std::chrono::milliseconds(5000)));
+
+    // Every restart waited for its zygote start instead of scheduling another one, so
+    // each of them started the app once before the limit was reached.
+    BOOST_CHECK_EQUAL(app.getLaunchStatistics(true).launches, 4u);
+    BOOST_CHECK_EQUAL(app.getLaunchStatistics(false).launches, 0u);
+    BOOST_CHECK(!app.isRunning());
+    BOOST_CHECK(!app.isStarting());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,145 @@
+#include <piga/daemon/ChildReaper.hpp>
+#include <boost/test/unit_test.hpp>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "TestHelpers.hpp"
+
+using namespace piga::daemon;
+using std::chrono::milliseconds;
+
+namespace
+{
+pid_t startChild(int exitCode, bool wait)
+{
+    pid_t pid = fork();
+    if(pid == 0) {
+        if(wait)
+            pause();
+        _exit(exitCode);
+    }
+    return pid;
+}
+/**
+ * @brief Waits until the child is a zombie without reaping it.
+ */
+void waitForExit(pid_t pid)
+{
+    siginfo_t info;
+    waitid(P_PID, pid, &info, WEXITED | WNOWAIT);
+}
+}
+
+BOOST_AUTO_TEST_SUITE(ChildReaperTest)
+
+BOOST_AUTO_TEST_CASE(ReportsTheExitStatus)
+{
+    std::shared_ptr<boost::asio::io_service> io_service = std::make_shared<boost::asio::io_service>();
+    ChildReaper reaper(io_service);
+
+    pid_t pid = startChild(3, false);
+    BOOST_REQUIRE_GT(pid, 0);
+    int status = 0;
+    bool reported = false;
+    reaper.watch(pid, [&](int s) {
+        status = s;
+        reported = true;
+        io_service->stop();
+    });
+
+    tests::runFor(*io_service, milliseconds(5000));
+    BOOST_REQUIRE(reported);
+    BOOST_CHECK(WIFEXITED(status));
+    BOOST_CHECK_EQUAL(WEXITSTATUS(status), 3);
+    // The child was reaped before the handler was called.
+    BOOST_CHECK_EQUAL(waitpid(pid, nullptr, WNOHANG), -1);
+}
+
+BOOST_AUTO_TEST_CASE(ReportsSignals)
+{
+    std::shared_ptr<boost::asio::io_service> io_service = std::make_shared<boost::asio::io_service>();
+    ChildReaper reaper(io_service);
+
+    pid_t pid = startChild(0, true);
+    BOOST_REQUIRE_GT(pid, 0);
+    int status = 0;
+    reaper.watch(pid, [&](int s) {
+        status = s;
+        io_service->stop();
+    });
+    kill(pid, SIGKILL);
+
+    tests::runFor(*io_service, milliseconds(5000));
+    BOOST_CHECK(WIFSIGNALED(status));
+    BOOST_CHECK_EQUAL(WTERMSIG(status), SIGKILL);
+}
+
+BOOST_AUTO_TEST_CASE(ReportsChildrenWhichExitedBeforeTheyWereWatched)
+{
+    std::shared_ptr<boost::asio::io_service> io_service = std::make_shared<boost::asio::io_service>();
+    ChildReaper reaper(io_service);
+
+    pid_t pid = startChild(7, false);
+    BOOST_REQUIRE_GT(pid, 0);
+    waitForExit(pid);
+
+    int status = 0;
+    reaper.watch(pid, [&](int s) {
+        status = s;
+        io_service->stop();
+    });
+
+    tests::runFor(*io_service, milliseconds(5000));
+    BOOST_CHECK(WIFEXITED(status));
+    BOOST_CHECK_EQUAL(WEXITSTATUS(status), 7);
+}
+
+BOOST_AUTO_TEST_CASE(UnwatchedChildrenAreNotReported)
+{
+    std::shared_ptr<boost::asio::io_service> io_service = std::make_shared<boost::asio::io_service>();
+    ChildReaper reaper(io_service);
+
+    pid_t pid = startChild(0, true);
+    BOOST_REQUIRE_GT(pid, 0);
+    bool reported = false;
+    reaper.watch(pid, [&](int) {
+        reported = true;
+    });
+    reaper.unwatch(pid);
+    kill(pid, SIGKILL);
+    waitForExit(pid);
+
+    tests::runFor(*io_service, milliseconds(100));
+    BOOST_CHECK(!reported);
+    // The child is left for its owner to reap.
+    BOOST_CHECK_EQUAL(waitpid(pid, nullptr, WNOHANG), pid);
+}
+
+BOOST_AUTO_TEST_CASE(KeepsTheStatusOfOrphansUntilTheyAreWatched)
+{
+    std::shared_ptr<boost::asio::io_service> io_service = std::make_shared<boost::asio::io_service>();
+    ChildReaper reaper(io_service);
+    reaper.setReapOrphans(true);
+
+    // Like a zygote app, which exits before its pid arrived.
+    pid_t pid = startChild(5, false);
+    BOOST_REQUIRE_GT(pid, 0);
+    waitForExit(pid);
+    tests::runFor(*io_service, milliseconds(200));
+    BOOST_REQUIRE_EQUAL(waitpid(pid, nullptr, WNOHANG), -1);
+    BOOST_CHECK_EQUAL(errno, ECHILD);
+
+    int status = 0;
+    reaper.watch(pid, [&](int s) {
+        status = s;
+        io_service->stop();
+    });
+
+    tests::runFor(*io_service, milliseconds(5000));
+    BOOST_CHECK(WIFEXITED(status));
+    BOOST_CHECK_EQUAL(WEXITSTATUS(status), 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+#include <piga/daemon/InputAccumulator.hpp>
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+using namespace piga::daemon;
+
+namespace
+{
+/**
+ * @brief An accumulator without a global host, the flushed batches are collected.
+ */
+struct Fixture {
+    Fixture()
+        : io_service(std::make_shared<boost::asio::io_service>())
+    {
+
+    }
+    void create(InputAccumulator::Policy policy)
+    {
+        accumulator.reset(new InputAccumulator(io_service, nullptr, 2, policy));
+        accumulator->setBatchHandler([this](const std::vector<InputEvent> &batch) {
+            submitted.insert(submitted.end(), batch.begin(), batch.end());
+        });
+    }
+    std::vector<InputEvent> flush()
+    {
+        io_service->poll();
+        io_service->reset();
+        std::vector<InputEvent> events;
+        events.swap(submitted);
+        return events;
+    }
+
+    std::shared_ptr<boost::asio::io_service> io_service;
+    std::vector<InputEvent> submitted;
+    std::unique_ptr<InputAccumulator> accumulator;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(InputAccumulatorTest, Fixture)
+
+BOOST_AUTO_TEST_CASE(ParsesPolicyNames)
+{
+    for(int i = InputAccumulator::KeepAll; i <= InputAccumulator::LatestOnly; ++i) {
+        InputAccumulator::Policy policy = InputAccumulator::KeepAll;
+        BOOST_CHECK(InputAccumulator::getPolicyFromStr(InputAccumulator::getStrFromPolicy(static_cast<InputAccumulator::Policy>(i)), policy));
+        BOOST_CHECK_EQUAL(policy, i);
+    }
+
+    InputAccumulator::Policy policy = InputAccumulator::LatestOnly;
+    BOOST_CHECK(!InputAccumulator::getPolicyFromStr("keepall", policy));
+    BOOST_CHECK_EQUAL(policy, InputAccumulator::LatestOnly);
+}
+
+BOOST_AUTO_TEST_CASE(KeepAllSubmitsEveryWrite)
+{
+    create(InputAccumulator::KeepAll);
+    accumulator->record(0, 1, 1);
+    accumulator->record(0, 1, 0);
+    accumulator->record(0, 1, 1);
+
+    std::vector<InputEvent> events = flush();
+    BOOST_REQUIRE_EQUAL(events.size(), 3u);
+    BOOST_CHECK_EQUAL(events[0].value, 1);
+    BOOST_CHECK_EQUAL(events[1].value, 0);
+    BOOST_CHECK_EQUAL(events[2].value, 1);
+    BOOST_CHECK_EQUAL(accumulator->getStatistics().flushes, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(KeepDigitalEdgesCoalescesAnalogChanges)
+{
+    create(InputAccumulator::KeepDigitalEdges);
+    accumulator->record(0, 1, 10, 100);
+    accumulator->record(0, 1, 20, 200);
+    accumulator->record(0, 1, 0);
+    accumulator->record(0, 1, 0);
+    accumulator->record(0, 1, 5);
+
+    std::vector<InputEvent> events = flush();
+    BOOST_REQUIRE_EQUAL(events.size(), 3u);
+    BOOST_CHECK_EQUAL(events[0].value, 20);
+    BOOST_CHECK_EQUAL(events[0].timestamp, 200u);
+    BOOST_CHECK_EQUAL(events[1].value, 0);
+    BOOST_CHECK_EQUAL(events[2].value, 5);
+
+    InputAccumulator::Statistics statistics = accumulator->getStatistics();
+    BOOST_CHECK_EQUAL(statistics.recorded, 5u);
+    BOOST_CHECK_EQUAL(statistics.submitted, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(LatestOnlyKeepsTheLastValue)
+{
+    create(InputAccumulator::LatestOnly);
+    accumulator->record(0, 1, 1);
+    accumulator->record(0, 1, 0);
+    accumulator->record(0, 1, 1);
+    accumulator->record(0, 1, 0);
+
+    std::vector<InputEvent> events = flush();
+    BOOST_REQUIRE_EQUAL(events.size(), 1u);
+    BOOST_CHECK_EQUAL(events[0].value, 0);
+}
+
+BOOST_AUTO_TEST_CASE(CoalescesOnlyTheSameInput)
+{
+    create(InputAccumulator::LatestOnly);
+    accumulator->record(0, 1, 1);
+    accumulator->record(1, 1, 2);
+    accumulator->record(0, 2, 3);
+    accumulator->record(1, 1, 4);
+    // Players out of range have no slot and are never coalesced.
+    accumulator->record(5, 1, 5);
+    accumulator->record(5, 1, 6);
+
+    std::vector<InputEvent> events = flush();
+    BOOST_REQUIRE_EQUAL(events.size(), 5u);
+    BOOST_CHECK_EQUAL(events[0].player, 0);
+    BOOST_CHECK_EQUAL(events[0].value, 1);
+    BOOST_CHECK_EQUAL(events[1].player, 1);
+    BOOST_CHECK_EQUAL(events[1].value, 4);
+    BOOST_CHECK_EQUAL(events[2].input, 2);
+    BOOST_CHECK_EQUAL(events[3].value, 5);
+    BOOST_CHECK_EQUAL(events[4].value, 6);
+}
+
+BOOST_AUTO_TEST_CASE(StartsANewBatchAfterAFlush)
+{
+    create(InputAccumulator::LatestOnly);
+    accumulator->record(0, 1, 1);
+    BOOST_CHECK_EQUAL(flush().size(), 1u);
+
+    // The input was submitted, so the next write is not coalesced into it.
+    accumulator->record(0, 1, 2);
+    std::vector<InputEvent> events = flush();
+    BOOST_REQUIRE_EQUAL(events.size(), 1u);
+    BOOST_CHECK_EQUAL(events[0].value, 2);
+    BOOST_CHECK_EQUAL(accumulator->getStatistics().flushes, 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
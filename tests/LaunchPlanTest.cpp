@@ -0,0 +1,166 @@
+#include <piga/daemon/LaunchPlan.hpp>
+#include <boost/test/unit_test.hpp>
+#include <sys/wait.h>
+#include <errno.h>
+
+#include "TestHelpers.hpp"
+
+using namespace piga::daemon;
+using namespace piga::daemon::tests;
+
+namespace
+{
+/**
+ * @brief Runs sh -c with the script, its further arguments are $1, $2, ...
+ */
+LaunchPlan shellPlan(const std::string &script, const std::vector<std::string> &arguments = {})
+{
+    LaunchPlan plan;
+    plan.setExecutable("/bin/sh");
+    plan.addArgument("sh");
+    plan.addArgument("-c");
+    plan.addArgument(script);
+    plan.addArgument("sh");
+    for(const std::string &argument : arguments)
+        plan.addArgument(argument);
+    return plan;
+}
+/**
+ * @brief Waits for the started process and returns its exit code, -1 if it did not exit.
+ */
+int exitCode(pid_t pid)
+{
+    int status;
+    if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+        return -1;
+    return WEXITSTATUS(status);
+}
+}
+
+BOOST_AUTO_TEST_SUITE(LaunchPlanTest)
+
+BOOST_AUTO_TEST_CASE(ParsesCpuLists)
+{
+    cpu_set_t cpus;
+    BOOST_REQUIRE(LaunchPlan::parseCpuList("0-2,5,7-8", cpus));
+    BOOST_CHECK_EQUAL(CPU_COUNT(&cpus), 6);
+    for(int cpu : {0, 1, 2, 5, 7, 8}) {
+        BOOST_CHECK(CPU_ISSET(cpu, &cpus));
+    }
+    BOOST_CHECK(!CPU_ISSET(3, &cpus));
+
+    BOOST_REQUIRE(LaunchPlan::parseCpuList("3", cpus));
+    BOOST_CHECK_EQUAL(CPU_COUNT(&cpus), 1);
+    BOOST_CHECK(CPU_ISSET(3, &cpus));
+}
+
+BOOST_AUTO_TEST_CASE(RejectsInvalidCpuLists)
+{
+    cpu_set_t cpus;
+    BOOST_CHECK(!LaunchPlan::parseCpuList("", cpus));
+    BOOST_CHECK(!LaunchPlan::parseCpuList("a", cpus));
+    BOOST_CHECK(!LaunchPlan::parseCpuList("1-", cpus));
+    BOOST_CHECK(!LaunchPlan::parseCpuList("3-1", cpus));
+    BOOST_CHECK(!LaunchPlan::parseCpuList("-1", cpus));
+    BOOST_CHECK(!LaunchPlan::parseCpuList("0,,1", cpus));
+    BOOST_CHECK(!LaunchPlan::parseCpuList(std::to_string(CPU_SETSIZE), cpus));
+    BOOST_CHECK(!LaunchPlan::parseCpuList("99999999999", cpus));
+}
+
+BOOST_AUTO_TEST_CASE(FormatsCpuLists)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    BOOST_CHECK_EQUAL(LaunchPlan::formatCpuList(cpus), "");
+
+    CPU_SET(0, &cpus);
+    CPU_SET(1, &cpus);
+    CPU_SET(2, &cpus);
+    CPU_SET(4, &cpus);
+    CPU_SET(CPU_SETSIZE - 1, &cpus);
+    BOOST_CHECK_EQUAL(LaunchPlan::formatCpuList(cpus), "0-2,4," + std::to_string(CPU_SETSIZE - 1));
+
+    cpu_set_t parsed;
+    BOOST_REQUIRE(LaunchPlan::parseCpuList(LaunchPlan::formatCpuList(cpus), parsed));
+    BOOST_CHECK(CPU_EQUAL(&cpus, &parsed));
+}
+
+BOOST_AUTO_TEST_CASE(SpawnsWithArgumentsAndEnvironment)
+{
+    LaunchPlan plan = shellPlan("test \"$1\" = \"first argument\" && test \"$2\" = \"\" && test \"$PIGA_TEST\" = \"a=b\"",
+                                {"first argument", ""});
+    plan.addEnvironment("PIGA_TEST=a=b");
+    plan.finalize();
+    BOOST_REQUIRE(plan.isValid());
+
+    int error = 0;
+    pid_t pid = plan.spawn(error);
+    BOOST_REQUIRE_GT(pid, 0);
+    BOOST_CHECK_EQUAL(error, 0);
+    BOOST_CHECK_EQUAL(exitCode(pid), 0);
+
+    // The arena is reused, so a second start sees the same arguments.
+    pid = plan.spawn(error);
+    BOOST_REQUIRE_GT(pid, 0);
+    BOOST_CHECK_EQUAL(exitCode(pid), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ResolvesExecutablesInPath)
+{
+    LaunchPlan plan;
+    plan.setExecutable("sh");
+    BOOST_CHECK_EQUAL(plan.getExecutable()[0], '/');
+    BOOST_CHECK_EQUAL(plan.getExecutable().substr(plan.getExecutable().size() - 3), "/sh");
+    plan.addArgument("sh");
+    plan.addArgument("-c");
+    plan.addArgument("exit 3");
+    plan.finalize();
+
+    int error = 0;
+    pid_t pid = plan.spawn(error);
+    BOOST_REQUIRE_GT(pid, 0);
+    BOOST_CHECK_EQUAL(error, 0);
+    BOOST_CHECK_EQUAL(exitCode(pid), 3);
+}
+
+BOOST_AUTO_TEST_CASE(UsesTheWorkingDirectory)
+{
+    TemporaryDirectory directory;
+    std::string path = boost::filesystem::canonical(directory.path).string();
+    LaunchPlan plan = shellPlan("test \"$(pwd -P)\" = \"$1\"", {path});
+    plan.setWorkingDirectory(directory.path);
+    plan.finalize();
+
+    int error = 0;
+    pid_t pid = plan.spawn(error);
+    BOOST_REQUIRE_GT(pid, 0);
+    BOOST_CHECK_EQUAL(error, 0);
+    BOOST_CHECK_EQUAL(exitCode(pid), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ReportsMissingExecutables)
+{
+    LaunchPlan plan;
+    plan.setExecutable("/nonexistent/executable");
+    plan.addArgument("executable");
+    plan.finalize();
+
+    int error = 0;
+    BOOST_CHECK_EQUAL(plan.spawn(error), -1);
+    BOOST_CHECK_EQUAL(error, ENOENT);
+}
+
+BOOST_AUTO_TEST_CASE(ReportsInvalidWorkingDirectories)
+{
+    LaunchPlan plan;
+    plan.setExecutable("/bin/true");
+    plan.addArgument("true");
+    plan.setWorkingDirectory("/nonexistent/directory");
+    plan.finalize();
+
+    int error = 0;
+    BOOST_CHECK_EQUAL(plan.spawn(error), -1);
+    BOOST_CHECK_EQUAL(error, ENOENT);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+#include <piga/daemon/Scheduler.hpp>
+#include <boost/test/unit_test.hpp>
+#include <thread>
+
+#include "TestHelpers.hpp"
+
+using namespace piga::daemon;
+using std::chrono::milliseconds;
+
+BOOST_AUTO_TEST_SUITE(SchedulerTest)
+
+BOOST_AUTO_TEST_CASE(RunsPeriodicTasks)
+{
+    std::shared_ptr<boost::asio::io_service> io_service = std::make_shared<boost::asio::io_service>();
+    Scheduler scheduler(io_service);
+
+    int runs = 0;
+    Scheduler::Handle handle = scheduler.add("periodic", milliseconds(2), [&]() {
+        if(++runs == 5)
+            io_service->stop();
+    });
+    BOOST_CHECK_NE(handle, 0u);
+
+    tests::runFor(*io_service, milliseconds(2000));
+    BOOST_CHECK_EQUAL(runs, 5);
+    BOOST_CHECK_EQUAL(scheduler.getStatistics(handle).runs, 5u);
+}
+
+BOOST_AUTO_TEST_CASE(RemovedTasksDoNotRunAgain)
+{
+    std::shared_ptr<boost::asio::io_service> io_service = std::make_shared<boost::asio::io_service>();
+    Scheduler scheduler(io_service);
+
+    int runs = 0;
+    Scheduler::Handle handle = 0;
+    handle = scheduler.add("once", milliseconds(2), [&]() {
+        ++runs;
+        scheduler.remove(handle);
+    });
+    scheduler.add("stop", milliseconds(50), [&]() {
+        io_service->stop();
+    });
+
+    tests::runFor(*io_service, milliseconds(2000));
+    BOOST_CHECK_EQUAL(runs, 1);
+    BOOST_CHECK_EQUAL(scheduler.getStatistics(handle).runs, 0u);
+    BOOST_CHECK_EQUAL(scheduler.getAllStatistics().size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(RescheduleChangesThePeriod)
+{
+    std::shared_ptr<boost::asio::io_service> io_service = std::make_shared<boost::asio::io_service>();
+    Scheduler scheduler(io_service);
+
+    // Moved from far away to a short period right after adding it.
+    int fastRuns = 0;
+    Scheduler::Handle fast = scheduler.add("fast", milliseconds(10000), [&]() {
+        ++fastRuns;
+    });
+    scheduler.reschedule(fast, milliseconds(2));
+
+    // Pushes itself far away from inside of its first run.
+    int slowRuns = 0;
+    Scheduler::Handle slow = 0;
+    slow = scheduler.add("slow", milliseconds(2), [&]() {
+        ++slowRuns;
+        scheduler.reschedule(slow, milliseconds(10000));
+    });
+
+    scheduler.add("stop", milliseconds(100), [&]() {
+        io_service->stop();
+    });
+
+    tests::runFor(*io_service, milliseconds(2000));
+    BOOST_CHECK_GE(fastRuns, 3);
+    BOOST_CHECK_EQUAL(slowRuns, 1);
+}
+
+BOOST_AUTO_TEST_CASE(SkipsMissedDeadlines)
+{
+    std::shared_ptr<boost::asio::io_service> io_service = std::make_shared<boost::asio::io_service>();
+    Scheduler scheduler(io_service);
+
+    // Every run takes more than two periods, so at least two runs are skipped each time.
+    int runs = 0;
+    Scheduler::Handle handle = scheduler.add("slow", milliseconds(5), [&]() {
+        std::this_thread::sleep_for(milliseconds(12));
+        if(++runs == 3)
+            io_service->stop();
+    });
+
+    tests::runFor(*io_service, milliseconds(2000));
+    Scheduler::Statistics statistics = scheduler.getStatistics(handle);
+    BOOST_CHECK_EQUAL(runs, 3);
+    BOOST_CHECK_EQUAL(statistics.runs, 3u);
+    BOOST_CHECK_EQUAL(statistics.overruns, 3u);
+    BOOST_CHECK_GE(statistics.missedDeadlines, 6u);
+    BOOST_CHECK_GE(statistics.maxRuntime.count(), 12000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,122 @@
+#ifndef PIGA_DAEMON_TESTS_TESTHELPERS_HPP_INCLUDED
+#define PIGA_DAEMON_TESTS_TESTHELPERS_HPP_INCLUDED
+
+#include <map>
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <boost/filesystem.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+namespace piga
+{
+namespace daemon
+{
+namespace tests
+{
+/**
+ * @brief A new directory below the temporary directory, removed with its content.
+ */
+struct TemporaryDirectory {
+    TemporaryDirectory()
+        : path((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("piga-daemon-test-%%%%-%%%%")).string())
+    {
+        boost::filesystem::create_directories(path);
+    }
+    ~TemporaryDirectory()
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(path, ec);
+    }
+
+    std::string path;
+};
+
+/**
+ * @brief Settings of an app config, the values are written as they are.
+ *
+ * Strings need their quotes, lists and groups their brackets.
+ */
+typedef std::map<std::string, std::string> ConfigValues;
+
+/**
+ * @brief Creates the app directory and writes its app_config.cfg.
+ *
+ * The defaults describe an app named after its directory, which runs as the test user
+ * and only sleeps. The given values replace them.
+ */
+inline void writeAppConfig(const std::string &appPath, const ConfigValues &values, const ConfigValues &execution = ConfigValues())
+{
+    ConfigValues root = {
+        {"name", "\"" + boost::filesystem::path(appPath).filename().string() + "\""},
+        {"autostart", "false"},
+        {"run_as_root", "true"},
+        {"wait_for_signal", "false"},
+        {"restart_on_crash", "false"},
+        {"restart_on_exit", "false"},
+        {"takes_foreground", "false"},
+    };
+    ConfigValues executionGroup = {
+        {"executable", "\"/bin/sleep\""},
+        {"arguments", "[\"30\"]"},
+        {"working_directory", "\"/\""},
+    };
+    for(const auto &value : values)
+        root[value.first] = value.second;
+    for(const auto &value : execution)
+        executionGroup[value.first] = value.second;
+
+    boost::filesystem::create_directories(appPath);
+    std::ofstream config(appPath + "/app_config.cfg", std::ios::trunc);
+    for(const auto &value : root)
+        config << value.first << " = " << value.second << ";\n";
+    config << "execution = {\n";
+    for(const auto &value : executionGroup)
+        config << "    " << value.first << " = " << value.second << ";\n";
+    config << "};\n";
+}
+
+/**
+ * @brief Runs the io_service until a handler stops it or the timeout expires.
+ *
+ * A broken test fails on its checks instead of hanging.
+ */
+inline void runFor(boost::asio::io_service &io_service, std::chrono::milliseconds timeout)
+{
+    boost::asio::steady_timer timer(io_service);
+    timer.expires_from_now(timeout);
+    timer.async_wait([&io_service](const boost::system::error_code &error) {
+        if(!error)
+            io_service.stop();
+    });
+    io_service.run();
+    io_service.reset();
+    boost::system::error_code ec;
+    timer.cancel(ec);
+    // Lets the cancelled wait finish, so it does not outlive the timer.
+    io_service.poll();
+    io_service.reset();
+}
+/**
+ * @brief Runs the io_service until the condition holds or the timeout expires.
+ *
+ * @return The condition after the last handler ran.
+ */
+inline bool runUntil(boost::asio::io_service &io_service, std::function<bool()> condition, std::chrono::milliseconds timeout)
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+    while(!condition() && std::chrono::steady_clock::now() < deadline) {
+        io_service.run_one_for(std::chrono::milliseconds(10));
+        // The io_service stops whenever it runs out of work.
+        if(io_service.stopped())
+            io_service.reset();
+    }
+    return condition();
+}
+}
+}
+}
+
+#endif
@@ -0,0 +1,9 @@
+#include <cstdlib>
+
+/**
+ * App library for the zygote tests, which crashes right away.
+ */
+extern "C" int piga_app_main(int argc, char **argv)
+{
+    return EXIT_FAILURE;
+}
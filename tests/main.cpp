@@ -0,0 +1,20 @@
+#define BOOST_TEST_MODULE piga-daemon
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/unit_test.hpp>
+#include <piga/daemon/Zygote.hpp>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char *argv[])
+{
+    // Zygote::start() runs the current executable with --zygote, which is this one in the tests.
+    if(argc >= 3 && std::strcmp(argv[1], "--zygote") == 0) {
+        std::vector<std::string> preload;
+        for(int i = 3; i + 1 < argc; i += 2) {
+            if(std::strcmp(argv[i], "--preload") == 0)
+                preload.push_back(argv[i + 1]);
+        }
+        return piga::daemon::Zygote::run(std::atoi(argv[2]), preload);
+    }
+    return boost::unit_test::unit_test_main(&init_unit_test, argc, argv);
+}